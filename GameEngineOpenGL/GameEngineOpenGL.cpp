@@ -9,12 +9,15 @@
 #include <iostream>
 #include <windows.h>
 #include <sstream>
+#include <fstream>
+#include <shellapi.h>
 #include <ostream>
 
 #pragma comment(lib, "opengl32.lib")
 #pragma comment(lib, "glu32.lib") 
 
 #define MAX_LOADSTRING 100
+#define WM_RUN_MAIN_THREAD_TASKS (WM_APP + 1) // Job system has tasks for the UI thread
 
 // Global Variables:
 HINSTANCE hInst;                                // current instance
@@ -27,9 +30,10 @@ View view(&model);
 Controller controller(&model, &view);
 
 // To track the selected mesh and position from context menu
-int g_selectedMeshIdx = -1;
+MeshHandle g_selectedMesh;
 int g_selectedFaceIdx = -1;
 POINT g_clickPoint;
+bool g_trackingMouseLeave = false; // WM_MOUSELEAVE requested for the view, ends the hover highlight
 
 // Forward declarations of functions included in this code module:
 ATOM                MyRegisterClass(HINSTANCE hInstance);
@@ -40,6 +44,13 @@ INT_PTR CALLBACK    About(HWND, UINT, WPARAM, LPARAM);
 INT_PTR CALLBACK    ObjectDialogProc(HWND, UINT, WPARAM, LPARAM);
 INT_PTR CALLBACK    PropertiesDialogProc(HWND, UINT, WPARAM, LPARAM);
 
+// Core library diagnostics go to the debugger output
+void DebugOutputLogHandler(LogLevel level, const std::string& message)
+{
+    std::string line = std::string("[") + logLevelName(level) + "] " + message + "\n";
+    OutputDebugStringA(line.c_str());
+}
+
 
 int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
                      _In_opt_ HINSTANCE hPrevInstance,
@@ -49,6 +60,43 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     UNREFERENCED_PARAMETER(hPrevInstance);
     UNREFERENCED_PARAMETER(lpCmdLine);
 
+    setLogHandler(DebugOutputLogHandler);
+
+    // Command line options:
+    //   --record <file>   write a session trace for replay with the tracereplay tool
+    //   --profile <file>  write the timing statistics as CSV on exit
+    //   --trace <file>    capture a timeline of every thread, written as Chrome trace JSON on exit
+    //   --accelerator <a> auto, bvh, kdtree or lbvh; also in View > Accelerator
+    std::string profilePath;
+    std::string tracePath;
+    int argumentCount = 0;
+    LPWSTR* arguments = CommandLineToArgvW(GetCommandLineW(), &argumentCount);
+    for (int i = 1; arguments && i + 1 < argumentCount; ++i) {
+        std::wstring option(arguments[i]);
+        std::wstring value(arguments[++i]);
+        if (option == L"--record") {
+            model.recorder.start(std::string(value.begin(), value.end()));
+        }
+        else if (option == L"--profile") {
+            profilePath.assign(value.begin(), value.end());
+        }
+        else if (option == L"--trace") {
+            tracePath.assign(value.begin(), value.end());
+        }
+        else if (option == L"--accelerator") {
+            AcceleratorType type;
+            if (parseAcceleratorType(std::string(value.begin(), value.end()), type)) {
+                model.setAcceleratorType(type);
+            }
+        }
+    }
+    LocalFree(arguments);
+
+    TRACE_THREAD_NAME("UI");
+    if (!tracePath.empty()) {
+        TraceRecorder::instance().start();
+    }
+
     // Initialize global strings
     LoadStringW(hInstance, IDS_APP_TITLE, szTitle, MAX_LOADSTRING);
     LoadStringW(hInstance, IDC_GAMEENGINEOPENGL, szWindowClass, MAX_LOADSTRING);
@@ -73,6 +121,16 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
             DispatchMessage(&msg);
         }
     }
+
+    if (!profilePath.empty()) {
+        std::ofstream profile(profilePath);
+        Profiler::instance().writeCSV(profile);
+    }
+    if (!tracePath.empty()) {
+        TraceRecorder::instance().stop();
+        std::ofstream trace(tracePath);
+        TraceRecorder::instance().writeChromeJSON(trace);
+    }
     return (int) msg.wParam;
 }
 
@@ -179,6 +237,11 @@ BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
 		return FALSE;
 	}
 
+   // Jobs hand their results back to the UI thread through the main window's message queue
+   JobSystem::instance().setMainThreadWakeup([hWnd]() {
+       PostMessage(hWnd, WM_RUN_MAIN_THREAD_TASKS, 0, 0);
+   });
+
    // Initialize the Controller with NULL for sidebar (we don't use it anymore)
    if (controller.create(hChildWnd, hWnd, NULL)) {
        MessageBox(NULL, L"Failed to set opengl thread", L"Error", MB_OK);
@@ -203,14 +266,16 @@ BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
 //
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
-    LARGE_INTEGER currentTime;
-    QueryPerformanceCounter(&currentTime);  // Get the current timestamp
+    PROFILE_SCOPE("ui.message");
 
     switch (message)
     {
     case WM_KEYDOWN:
 		controller.handleKeyboardInput(wParam);
 	break;
+    case WM_RUN_MAIN_THREAD_TASKS:
+        JobSystem::instance().runMainThreadTasks();
+        break;
     case WM_COMMAND:
         {
             int wmId = LOWORD(wParam);
@@ -233,6 +298,18 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
                 model.camera.setCameraMode(PERSPECTIVE_MODE);
                 model.updateProjection(view.getWindowWidth(), view.getWindowHeight());
                 break;
+            case IDM_ACCEL_AUTO:
+                model.setAcceleratorType(ACCELERATOR_AUTO);
+                break;
+            case IDM_ACCEL_BVH:
+                model.setAcceleratorType(ACCELERATOR_BVH);
+                break;
+            case IDM_ACCEL_KDTREE:
+                model.setAcceleratorType(ACCELERATOR_KDTREE);
+                break;
+            case IDM_ACCEL_LBVH:
+                model.setAcceleratorType(ACCELERATOR_LBVH);
+                break;
 
             case IDM_OBJECT:
             {
@@ -245,43 +322,43 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 				break;
             // Context menu commands
             case IDM_CONTEXT_BOUNDINGBOX:
-                if (g_selectedMeshIdx >= 0 && g_selectedMeshIdx < (int)model.meshes.size()) {
-                    model.meshes[g_selectedMeshIdx].toggleBoundingBox();
+                if (Mesh* mesh = model.meshes.get(g_selectedMesh)) {
+                    mesh->toggleBoundingBox();
                 }
                 break;
             case IDM_CONTEXT_VERTICES:
-                if (g_selectedMeshIdx >= 0 && g_selectedMeshIdx < (int)model.meshes.size()) {
-                    model.meshes[g_selectedMeshIdx].toggleVertices();
+                if (Mesh* mesh = model.meshes.get(g_selectedMesh)) {
+                    mesh->toggleVertices();
                 }
                 break;
             case IDM_CONTEXT_DELETE:
-                if (g_selectedMeshIdx >= 0 && g_selectedMeshIdx < (int)model.meshes.size()) {
-                    model.deleteMesh(g_selectedMeshIdx);
+                if (model.meshes.get(g_selectedMesh)) {
+                    model.deleteMesh(g_selectedMesh);
                     controller.clearAllSelections();
-                    g_selectedMeshIdx = -1;
+                    g_selectedMesh = MeshHandle();
                     g_selectedFaceIdx = -1;
                 }
                 break;
             case IDM_CONTEXT_ORBIT:
-                if (g_selectedMeshIdx >= 0 && g_selectedMeshIdx < (int)model.meshes.size()) {
+                if (Mesh* mesh = model.meshes.get(g_selectedMesh)) {
                     if (model.camera.isOrbitMode()) {
                         model.camera.setOrbitMode(false);
                     } else {
-                        model.camera.setOrbitMode(true, model.meshes[g_selectedMeshIdx].getCenter(), 10.0f);
+                        model.camera.setOrbitMode(true, mesh->getCenter(), 10.0f);
                     }
                 }
                 break;
             case IDM_CONTEXT_FIT_TO_VIEW:
-                if (g_selectedMeshIdx >= 0 && g_selectedMeshIdx < (int)model.meshes.size()) {
+                if (Mesh* mesh = model.meshes.get(g_selectedMesh)) {
                     model.camera.zoomToBoundingBox(
-                        model.meshes[g_selectedMeshIdx].getCenter(),
-                        model.meshes[g_selectedMeshIdx].getSize(),
+                        mesh->getCenter(),
+                        mesh->getSize(),
                         view.getAspectRatio()
                     );
                 }
                 break;
             case IDM_CONTEXT_EDIT_PROPERTIES:
-                if (g_selectedMeshIdx >= 0 && g_selectedMeshIdx < (int)model.meshes.size()) {
+                if (model.meshes.get(g_selectedMesh)) {
                     DialogBox(hInst, MAKEINTRESOURCE(IDD_PROPERTIES_DIALOG), hWnd, PropertiesDialogProc);
                 }
                 break;
@@ -317,11 +394,13 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     default:
         return DefWindowProc(hWnd, message, wParam, lParam);
     }
+    // Hand this message's edits (including any made by dialogs it opened) to the render thread
+    model.publishChanges();
     return 0;
 }
 
-// Test ray intersection and return the index of the selected mesh
-void GetSelectedIndices(int x, int y, int& outMeshIndex, int& outFaceIndex) {
+// Test ray intersection and return the handle of the selected mesh
+void GetSelectedIndices(int x, int y, MeshHandle& outMesh, int& outFaceIndex) {
     // Get camera matrices and window size
     glm::mat4 viewMatrix = model.camera.getViewMatrix();
     glm::mat4 projMatrix = model.getProjectionMatrix();
@@ -345,28 +424,40 @@ void GetSelectedIndices(int x, int y, int& outMeshIndex, int& outFaceIndex) {
     // Create ray with proper parameters
     Ray ray(rayOrigin, rayDir, tMin, tMax);
     
-    // Debug output
+#if PICK_DEBUG_OUTPUT
     std::wstringstream ss;
     ss << L"[GetSelectedIndices] Ray: Origin (" << rayOrigin.x << ", " << rayOrigin.y << ", " << rayOrigin.z 
        << ") Dir (" << rayDir.x << ", " << rayDir.y << ", " << rayDir.z 
        << ") tMin: " << tMin << " tMax: " << tMax << "\n";
     OutputDebugString(ss.str().c_str());
+#endif
     
-    controller.findRayIntersection(ray, outMeshIndex, outFaceIndex);
+    controller.findRayIntersection(ray, outMesh, outFaceIndex);
+}
+
+// Update global selection state to match controller's state, after clicks and rectangle selections
+void CopyControllerSelection() {
+    g_selectedMesh = controller.selectedMesh;
+    g_selectedFaceIdx = controller.selectedFaceIndex;
 }
 
 LRESULT CALLBACK ChildWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
     switch (message) {
     case WM_LBUTTONDOWN: {
         controller.handleMouseDown(wParam, LOWORD(lParam), HIWORD(lParam));
-        
-        // Update global selection state to match controller's state
-        g_selectedMeshIdx = controller.selectedMeshIndex;
-        g_selectedFaceIdx = controller.selectedFaceIndex;
+        CopyControllerSelection();
         
         SetFocus(GetParent(hWnd)); // Give focus to the parent window
     }
         break;
+    case WM_LBUTTONUP:
+        // Ends a rectangle selection, signed coordinates since the captured mouse may be outside
+        controller.handleMouseUp(static_cast<short>(LOWORD(lParam)), static_cast<short>(HIWORD(lParam)));
+        CopyControllerSelection();
+        break;
+    case WM_CAPTURECHANGED:
+        controller.endRectangleSelection();
+        break;
     case WM_RBUTTONDOWN: {
         // Store click position for the context menu
         g_clickPoint.x = LOWORD(lParam);
@@ -375,17 +466,17 @@ LRESULT CALLBACK ChildWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPa
         OutputDebugString(L"WM_RBUTTONDOWN event received\n");
         
         // Determine which mesh (if any) is at the click position
-        GetSelectedIndices(g_clickPoint.x, g_clickPoint.y, g_selectedMeshIdx, g_selectedFaceIdx);
+        GetSelectedIndices(g_clickPoint.x, g_clickPoint.y, g_selectedMesh, g_selectedFaceIdx);
         
         // Debug output
         std::wstringstream ss;
         ss << L"Right-click detected at (" << g_clickPoint.x << ", " << g_clickPoint.y 
-           << "), selected mesh index: " << g_selectedMeshIdx 
+           << "), selected mesh slot: " << (g_selectedMesh.isNull() ? -1 : (int)g_selectedMesh.index) 
            << ", selected face index: " << g_selectedFaceIdx << "\n";
         OutputDebugString(ss.str().c_str());
         
         // Only show context menu if an object was clicked
-        if (g_selectedMeshIdx >= 0) {
+        if (!g_selectedMesh.isNull()) {
             // Convert to screen coordinates
             POINT pt = g_clickPoint;
             ClientToScreen(hWnd, &pt);
@@ -406,7 +497,25 @@ LRESULT CALLBACK ChildWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPa
     }
         break;
     case WM_MOUSEMOVE:
+        if (!g_trackingMouseLeave) {
+            TRACKMOUSEEVENT track = { sizeof(TRACKMOUSEEVENT), TME_LEAVE, hWnd, 0 };
+            g_trackingMouseLeave = TrackMouseEvent(&track) != FALSE;
+        }
         controller.handleMouseInput(wParam, LOWORD(lParam), HIWORD(lParam));
+        controller.handleRectangleDrag(static_cast<short>(LOWORD(lParam)), static_cast<short>(HIWORD(lParam)));
+        controller.handleMouseHover(wParam, LOWORD(lParam), HIWORD(lParam));
+        break;
+    case WM_MOUSELEAVE:
+        g_trackingMouseLeave = false;
+        controller.handleMouseLeave();
+        break;
+    case WM_PAINT: {
+        // Validate the region and let the render thread redraw it
+        PAINTSTRUCT ps;
+        BeginPaint(hWnd, &ps);
+        EndPaint(hWnd, &ps);
+        controller.requestRedraw();
+    }
         break;
     case WM_MOUSEWHEEL: {
         short delta = GET_WHEEL_DELTA_WPARAM(wParam);
@@ -421,6 +530,7 @@ LRESULT CALLBACK ChildWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPa
     default:
         return DefWindowProc(hWnd, message, wParam, lParam);
     }
+    model.publishChanges();
     return 0;
 }
 
@@ -502,9 +612,9 @@ INT_PTR CALLBACK PropertiesDialogProc(HWND hDlg, UINT message, WPARAM wParam, LP
     switch (message)
     {
     case WM_INITDIALOG:
-        if (g_selectedMeshIdx >= 0 && g_selectedMeshIdx < (int)model.meshes.size())
+        if (const Mesh* selected = model.meshes.get(g_selectedMesh))
         {
-            const Mesh& mesh = model.meshes[g_selectedMeshIdx];
+            const Mesh& mesh = *selected;
             
             // Initialize dialog with mesh values
             wchar_t buffer[64];
@@ -574,7 +684,7 @@ INT_PTR CALLBACK PropertiesDialogProc(HWND hDlg, UINT message, WPARAM wParam, LP
     case WM_COMMAND:
         if (LOWORD(wParam) == IDOK)
         {
-            if (g_selectedMeshIdx >= 0 && g_selectedMeshIdx < (int)model.meshes.size())
+            if (model.meshes.get(g_selectedMesh))
             {
                 // Get values from dialog
                 wchar_t buffer[64];
@@ -635,12 +745,12 @@ INT_PTR CALLBACK PropertiesDialogProc(HWND hDlg, UINT message, WPARAM wParam, LP
                 bool visible = (IsDlgButtonChecked(hDlg, IDC_PROP_VISIBILITY) == BST_CHECKED);
                 
                 // Update the mesh properties
-                Mesh& mesh = model.meshes[g_selectedMeshIdx];
+                Mesh& mesh = *model.meshes.get(g_selectedMesh);
                 mesh.objectName = objectName;
                 
                 // Update all mesh properties using the enhanced Model method
                 model.updateMeshAllProperties(
-                    g_selectedMeshIdx,
+                    g_selectedMesh,
                     rotX, rotY, rotZ,
                     posX, posY, posZ,
                     scaleX, scaleY, scaleZ,
@@ -1,15 +1,20 @@
 #pragma once
 
-#include <GL/gl.h>
-#include <GL/glu.h>
 #include <vector>
 #include <sstream>
 #include <fstream>
 #include <string>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <glm/glm.hpp>
-#include <windows.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <stdexcept>
+#include "log.h"
+#include "profiler.h"
+#include "slotmap.h"
+#include "vertextransform.h"
 
 // Axis-Aligned Bounding Box
 class AABB {
@@ -57,6 +62,22 @@ public:
         return min.x <= max.x && min.y <= max.y && min.z <= max.z;
     }
 
+    // Bounds of this box after an affine transform (Arvo's method).
+    // Each world axis takes the smaller/larger contribution of every object axis, no corners needed.
+    AABB transformed(const glm::mat4& matrix) const {
+        glm::vec3 translation(matrix[3]);
+        AABB result(translation, translation);
+        for (int col = 0; col < 3; ++col) {
+            for (int row = 0; row < 3; ++row) {
+                float a = matrix[col][row] * min[col];
+                float b = matrix[col][row] * max[col];
+                result.min[row] += std::min(a, b);
+                result.max[row] += std::max(a, b);
+            }
+        }
+        return result;
+    }
+
     // Ray-AABB intersection test
     bool isIntersectingRay(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float tMin, float tMax) const {
         // Handle zero components in ray direction to avoid division by zero
@@ -96,13 +117,13 @@ public:
     unsigned int v0, v1, v2;          // Indices of vertices in the mesh
     AABB boundingBox;                  // AABB for fast intersection rejection
     glm::vec3 centroid;                // Center point of the face (for BVH construction)
-    std::vector<glm::vec3> vertices;   // Cached vertices for this face
+    glm::vec3 vertices[3];             // Cached vertices for this face (inline, no per-face allocation)
     
     // Default constructor
     Face() : v0(0), v1(0), v2(0), centroid(0.0f) {}
     
     // Construct from vertex indices and source vertices
-    Face(unsigned int v0, unsigned int v1, unsigned int v2, std::vector<GLfloat>* sourceVertices)
+    Face(unsigned int v0, unsigned int v1, unsigned int v2, std::vector<float>* sourceVertices)
         : v0(v0), v1(v1), v2(v2)
     {
         // Check if indices are valid
@@ -111,21 +132,20 @@ public:
         }
 
         // Cache the vertex positions for this face
-        vertices.reserve(3);
-        vertices.push_back(glm::vec3(
+        vertices[0] = glm::vec3(
             (*sourceVertices)[v0 * 3],
             (*sourceVertices)[v0 * 3 + 1],
-            (*sourceVertices)[v0 * 3 + 2]));
+            (*sourceVertices)[v0 * 3 + 2]);
 
-        vertices.push_back(glm::vec3(
+        vertices[1] = glm::vec3(
             (*sourceVertices)[v1 * 3],
             (*sourceVertices)[v1 * 3 + 1],
-            (*sourceVertices)[v1 * 3 + 2]));
+            (*sourceVertices)[v1 * 3 + 2]);
 
-        vertices.push_back(glm::vec3(
+        vertices[2] = glm::vec3(
             (*sourceVertices)[v2 * 3],
             (*sourceVertices)[v2 * 3 + 1],
-            (*sourceVertices)[v2 * 3 + 2]));
+            (*sourceVertices)[v2 * 3 + 2]);
 
         // Calculate AABB and centroid
         boundingBox.min = glm::min(glm::min(vertices[0], vertices[1]), vertices[2]);
@@ -145,9 +165,12 @@ public:
     
     // Ray-Triangle intersection test using Mller-Trumbore algorithm
     bool isIntersectingRay(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float tMin, float tMax) const {
-        // Early exit if we don't have exactly 3 vertices
-        if (vertices.size() != 3) return false;
-        
+        float t;
+        return intersectRay(rayOrigin, rayDirection, tMin, tMax, t);
+    }
+
+    // The same test, also giving the distance along the ray of the hit
+    bool intersectRay(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float tMin, float tMax, float& t) const {
         // First do a quick AABB test to reject most non-intersecting rays
         if (!boundingBox.isIntersectingRay(rayOrigin, rayDirection, tMin, tMax)) {
             return false;
@@ -177,40 +200,132 @@ public:
         if (v < 0.0f || u + v > 1.0f) return false; // Outside triangle bounds
 
         // Calculate intersection distance t
-        float t = glm::dot(edge2, q) * invDet;
+        t = glm::dot(edge2, q) * invDet;
 
         // Check if intersection is within the valid range
         return t >= tMin && t <= tMax;
     }
 };
 
-// Mesh class representing a 3D object
+class SpatialAccelerator;
+
+// Object-space geometry of a mesh.
+// Shared between every mesh created from the same source (all default spheres, every copy of an
+// imported part), so repeated objects cost one set of buffers, faces and accelerator.
+// Treat it as read-only once a mesh references it; Mesh copies it before editing. The accelerator is
+// the exception: the Model sets and clears it with std::atomic_store, the render thread reads it with
+// std::atomic_load (hover picking).
+class MeshGeometry {
+public:
+    std::vector<float> vertices;               // Object-space vertices (x0, y0, z0, x1, y1, z1...)
+    std::vector<float> colors;                 // Default per-vertex colors
+    std::vector<unsigned int> indices;         // Triangle indices (groups of 3)
+    std::vector<Face> faces;                   // Object-space triangle faces with cached data
+    AABB bounds;                               // Object-space bounds
+    std::shared_ptr<SpatialAccelerator> accelerator; // Accelerator over faces, built by the Model
+
+    // Take ownership of the buffers and derive faces and bounds from them
+    static std::shared_ptr<MeshGeometry> create(std::vector<float>&& vertices, std::vector<float>&& colors,
+                                                std::vector<unsigned int>&& indices) {
+        if (vertices.size() % 3 != 0) {
+            throw std::invalid_argument("Vertices size must be a multiple of 3 (x, y, z components).");
+        }
+
+        std::shared_ptr<MeshGeometry> geometry = std::make_shared<MeshGeometry>();
+        geometry->vertices = std::move(vertices);
+        geometry->colors = std::move(colors);
+        geometry->indices = std::move(indices);
+        geometry->rebuild();
+        return geometry;
+    }
+
+    // Recompute bounds and faces after the buffers changed
+    void rebuild() {
+        // Ensure indices size is a multiple of 3
+        if (indices.size() % 3 != 0) {
+            size_t properSize = (indices.size() / 3) * 3;
+            indices.resize(properSize);
+        }
+
+        VertexTransform::computeBounds(vertices.data(), vertices.size() / 3, bounds.min, bounds.max);
+        constructFaces();
+
+        // Faces moved, the old accelerator points at freed memory
+        accelerator.reset();
+    }
+
+    bool empty() const {
+        return vertices.empty();
+    }
+
+private:
+    // Build face objects from indices and object-space vertices
+    void constructFaces() {
+        faces.clear();
+
+        // Safety check - ensure valid data
+        if (indices.empty() || indices.size() % 3 != 0 || vertices.empty()) {
+            return;
+        }
+
+        // Create faces for each triangle (group of 3 indices), one allocation for the whole array
+        faces.reserve(indices.size() / 3);
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            try {
+                faces.emplace_back(indices[i], indices[i + 1], indices[i + 2], &vertices);
+            }
+            catch (const std::out_of_range&) {
+                // Stop if indices reference invalid vertices
+                logMessage(LOG_ERROR, "constructFaces(): face vertex index out of bounds");
+                break;
+            }
+        }
+    }
+};
+
+// Faces of a mesh picked by a rectangle selection. Immutable once made, so a mesh and the copies
+// published to the render thread share one instance however many faces it holds.
+struct FaceSelection {
+    std::vector<int> faces;                    // Sorted face indices
+    std::vector<unsigned int> indices;         // Vertex indices of those faces, ready to draw
+
+    FaceSelection(std::vector<int>&& selectedFaces, const std::vector<unsigned int>& meshIndices)
+        : faces(std::move(selectedFaces)) {
+        indices.reserve(faces.size() * 3);
+        for (int face : faces) {
+            indices.insert(indices.end(), meshIndices.begin() + face * 3, meshIndices.begin() + face * 3 + 3);
+        }
+    }
+};
+
+// Handle to a mesh in a model's MeshStore
+typedef SlotHandle MeshHandle;
+
+// Mesh class representing a 3D object: shared geometry placed in the world by its own transform
 class Mesh {
 public:
     // *** Data members ***
     
     // Geometry data
-    std::vector<GLfloat> vertices;             // Original vertices in 3D space (x0, y0, z0, x1, y1, z1...)
-    std::vector<GLfloat> transformedVertices;  // Transformed vertices after applying model matrix
-    std::vector<GLfloat> colors;               // Per-vertex colors
-    std::vector<unsigned int> indices;         // Triangle indices (groups of 3)
-    std::vector<Face> faces;                   // Triangle faces with cached data
+    std::shared_ptr<MeshGeometry> geometry;    // Object-space data, possibly shared with other meshes
     
     // Bounding volumes
     AABB aabb;                                 // Axis-aligned bounding box (AABB)
     glm::vec4 obbCorners[8];                   // Oriented bounding box (OBB) corners
     
     // Transform properties
-    GLfloat centerX = 0.0f, centerY = 0.0f, centerZ = 0.0f;  // Center position in world space
-    GLfloat sizeX = 0.0f, sizeY = 0.0f, sizeZ = 0.0f;        // Size of the AABB in world space
-    GLfloat rotationX = 0.0f, rotationY = 0.0f, rotationZ = 0.0f;  // Rotation angles in degrees
-    GLfloat scaleX = 1.0f, scaleY = 1.0f, scaleZ = 1.0f;     // Scale factors
+    float centerX = 0.0f, centerY = 0.0f, centerZ = 0.0f;    // Center position in world space
+    float sizeX = 0.0f, sizeY = 0.0f, sizeZ = 0.0f;          // Size of the AABB in world space
+    float rotationX = 0.0f, rotationY = 0.0f, rotationZ = 0.0f;    // Rotation angles in degrees
+    float scaleX = 1.0f, scaleY = 1.0f, scaleZ = 1.0f;       // Scale factors
     glm::mat4 modelMatrix = glm::mat4(1.0f);   // Model matrix for transformations
+    glm::mat4 inverseModelMatrix = glm::mat4(1.0f); // World to object space, used to pick against shared geometry
     
     // Appearance properties
-    GLfloat colorR = 1.0f, colorG = 1.0f, colorB = 1.0f;  // Base color
-    GLfloat transparency = 0.0f;               // 0.0 = opaque, 1.0 = transparent
-    GLfloat shininess = 0.0f;                  // Material shininess (0.0 - 1.0)
+    float colorR = 1.0f, colorG = 1.0f, colorB = 1.0f;    // Base color
+    bool useBaseColor = false;                 // Draw with the base color instead of the geometry's vertex colors
+    float transparency = 0.0f;                 // 0.0 = opaque, 1.0 = transparent
+    float shininess = 0.0f;                    // Material shininess (0.0 - 1.0)
     int materialType = 0;                      // Material type (0 = default, 1 = plastic, etc.)
     bool isTransparent = false;                // Whether transparency is enabled
     
@@ -225,62 +340,51 @@ public:
     bool showVertices = false;                 // Whether to show vertex points
     bool isSelected = false;                   // Whether the mesh is selected
     int selectedFaceIndex = -1;                // Index of the selected face (-1 if none)
+    std::shared_ptr<const FaceSelection> faceSelection; // Faces of a rectangle selection, null if none
+
+    // Change tracking for the render thread
+    uint64_t revision = 1;                     // Bumped by markChanged(), the mutators below call it
+    uint64_t publishedRevision = 0;            // Revision last handed to the render thread
+    MeshHandle handle;                         // Own handle in the model's store, null outside a model
+    std::vector<MeshHandle>* changedMeshes = nullptr; // Model's publish list, markChanged() adds the handle
 
     // *** Constructors/Destructor ***
     
-    // Default constructor
-    Mesh() {}
-    
-    // Destructor - clean up any resources
-    ~Mesh() {
-        vertices.clear();
-        transformedVertices.clear();
-        indices.clear();
-        colors.clear();
-        faces.clear();
-    }
+    // Default constructor - empty geometry
+    Mesh() : geometry(std::make_shared<MeshGeometry>()) {}
     
+    // Meshes are moved when the scene storage compacts itself.
+    // Geometry is held by pointer, so moving or copying a mesh never touches vertex data.
+    Mesh(Mesh&&) = default;
+    Mesh& operator=(Mesh&&) = default;
+    Mesh(const Mesh&) = default;
+    Mesh& operator=(const Mesh&) = default;
+    
+    // Flag the mesh for the next scene publish. Code assigning data members directly must call this.
+    // The first change since the last publish adds the mesh to its model's publish list.
+    void markChanged() {
+        if (revision++ == publishedRevision && changedMeshes) changedMeshes->push_back(handle);
+    }
+
     // *** Bounding Box Methods ***
     
     // Calculate object-space dimensions (before transformations)
     glm::vec3 getObjectSpaceDimensions() const {
-        if (vertices.empty()) return glm::vec3(0.0f);
-        
-        float minX = vertices[0], maxX = vertices[0];
-        float minY = vertices[1], maxY = vertices[1];
-        float minZ = vertices[2], maxZ = vertices[2];
-
-        for (size_t i = 3; i < vertices.size(); i += 3) {
-            minX = std::min(minX, vertices[i]);
-            maxX = std::max(maxX, vertices[i]);
-            minY = std::min(minY, vertices[i + 1]);
-            maxY = std::max(maxY, vertices[i + 1]);
-            minZ = std::min(minZ, vertices[i + 2]);
-            maxZ = std::max(maxZ, vertices[i + 2]);
-        }
-        
-        return glm::vec3(maxX - minX, maxY - minY, maxZ - minZ);
+        if (!geometry->bounds.isValid()) return glm::vec3(0.0f);
+        return geometry->bounds.getSize();
     }
     
-    // Calculate Axis-Aligned Bounding Box (AABB) from transformed vertices
+    // Calculate Axis-Aligned Bounding Box (AABB) from the object bounds and model matrix.
+    // Constant time, the vertices are not visited.
     void calculateAABB() {
-        if (transformedVertices.empty()) return;
-        
-        // Start with the first vertex
-        glm::vec3 aabbMin(transformedVertices[0], transformedVertices[1], transformedVertices[2]);
-        glm::vec3 aabbMax(transformedVertices[0], transformedVertices[1], transformedVertices[2]);
-
-        // Find the minimum and maximum coordinates
-        for (size_t i = 3; i < transformedVertices.size(); i += 3) {
-            aabbMin.x = std::min(aabbMin.x, transformedVertices[i]);
-            aabbMax.x = std::max(aabbMax.x, transformedVertices[i]);
-            aabbMin.y = std::min(aabbMin.y, transformedVertices[i + 1]);
-            aabbMax.y = std::max(aabbMax.y, transformedVertices[i + 1]);
-            aabbMin.z = std::min(aabbMin.z, transformedVertices[i + 2]);
-            aabbMax.z = std::max(aabbMax.z, transformedVertices[i + 2]);
-        }
+        if (!geometry->bounds.isValid()) return;
 
-        // Update the AABB and center/size values
+        AABB worldBounds = geometry->bounds.transformed(modelMatrix);
+        setAABB(worldBounds.min, worldBounds.max);
+    }
+
+    // Store world-space bounds and update center/size values
+    void setAABB(const glm::vec3& aabbMin, const glm::vec3& aabbMax) {
         aabb.min = aabbMin;
         aabb.max = aabbMax;
         
@@ -314,31 +418,17 @@ public:
             {-halfExtents.x,  halfExtents.y,  halfExtents.z, 1.0f}  // 7: left-top-front
         };
         
-        // Apply the model matrix to transform the corners to world space
+        // Move the corners onto the object-space center, then transform them to world space
+        glm::vec4 objectCenter(computeOriginalCenter(), 0.0f);
         for (int i = 0; i < 8; ++i) {
-            obbCorners[i] = modelMatrix * corners[i];
+            obbCorners[i] = modelMatrix * (corners[i] + objectCenter);
         }
     }
     
     // Get the center of the original (untransformed) mesh
-    glm::vec3 computeOriginalCenter() {
-        if (vertices.empty()) return glm::vec3(0.0f);
-        
-        float minX = vertices[0], maxX = vertices[0];
-        float minY = vertices[1], maxY = vertices[1];
-        float minZ = vertices[2], maxZ = vertices[2];
-
-        for (size_t i = 0; i < vertices.size(); i += 3) {
-            float x = vertices[i];
-            float y = vertices[i + 1];
-            float z = vertices[i + 2];
-
-            minX = std::min(minX, x); maxX = std::max(maxX, x);
-            minY = std::min(minY, y); maxY = std::max(maxY, y);
-            minZ = std::min(minZ, z); maxZ = std::max(maxZ, z);
-        }
-
-        return glm::vec3((minX + maxX) * 0.5f, (minY + maxY) * 0.5f, (minZ + maxZ) * 0.5f);
+    glm::vec3 computeOriginalCenter() const {
+        if (!geometry->bounds.isValid()) return glm::vec3(0.0f);
+        return geometry->bounds.getCenter();
     }
     
     // *** Size and Dimensions Methods ***
@@ -392,22 +482,31 @@ public:
     
     // *** Mesh Construction/Initialization ***
     
-    // Initialize mesh with vertices, colors, and indices
-    void init(const std::vector<GLfloat>& vertices, const std::vector<GLfloat>& colors, const std::vector<unsigned int>& indices) {
-        if (vertices.size() % 3 != 0) {
-            throw std::invalid_argument("Vertices size must be a multiple of 3 (x, y, z components).");
-        }
-        
-        this->vertices = vertices;
-        this->transformedVertices = vertices; // Initialize transformed vertices with original vertices
-        this->colors = colors;
-        this->indices = indices;
+    // Initialize mesh with vertices, colors, and indices.
+    // The buffers are moved into a new geometry; pass std::move(...) from builders so nothing is copied.
+    void init(std::vector<float>&& vertices, std::vector<float>&& colors, std::vector<unsigned int>&& indices) {
+        setGeometry(MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices)));
+    }
 
-        // Ensure indices size is a multiple of 3
-        if (this->indices.size() % 3 != 0) {
-            size_t properSize = (this->indices.size() / 3) * 3;
-            this->indices.resize(properSize);
-        }
+    // Initialize mesh from buffers owned by the caller (copies each buffer exactly once)
+    void init(const std::vector<float>& vertices, const std::vector<float>& colors, const std::vector<unsigned int>& indices) {
+        init(std::vector<float>(vertices), std::vector<float>(colors), std::vector<unsigned int>(indices));
+    }
+
+    // Initialize mesh from raw arrays (e.g. a memory-mapped or streamed buffer)
+    void init(const float* vertexData, size_t vertexFloatCount,
+              const float* colorData, size_t colorFloatCount,
+              const unsigned int* indexData, size_t indexCount) {
+        init(std::vector<float>(vertexData, vertexData + vertexFloatCount),
+             std::vector<float>(colorData, colorData + colorFloatCount),
+             std::vector<unsigned int>(indexData, indexData + indexCount));
+    }
+
+    // Reference existing geometry, with its object-space origin placed at the given world position
+    // (by default the mesh is where the geometry's vertices are).
+    void setGeometry(const std::shared_ptr<MeshGeometry>& sharedGeometry, const glm::vec3& origin = glm::vec3(0.0f)) {
+        geometry = sharedGeometry;
+        markChanged();
 
         // Reset rotation angles
         rotationX = 0.0f;
@@ -417,92 +516,88 @@ public:
         // Reset selection state
         isSelected = false;
         selectedFaceIndex = -1;
-        
-        // Calculate bounding boxes
-        calculateAABB();
-        calculateOBB();
+        faceSelection.reset();
 
-        // Build faces from indices
-        synchronizeFacesAndIndices();
+        placeAt(origin);
     }
 
-    // Set vertex data
-    void setVertices(const std::vector<GLfloat>& vertices) {
-        this->vertices = vertices;
-        this->transformedVertices = vertices;
+    // Move the mesh so its object-space origin lands on the given world position
+    void placeAt(const glm::vec3& origin) {
+        glm::vec3 center = origin + computeOriginalCenter();
+        centerX = center.x;
+        centerY = center.y;
+        centerZ = center.z;
+        updateMesh();
     }
 
-    // Set color data
-    void setColors(const std::vector<GLfloat>& colors) {
-        this->colors = colors;
+    // Set vertex data. Meshes in a Model are edited through Model::setMeshVertices() and the like,
+    // which also give the new faces an accelerator.
+    void setVertices(const std::vector<float>& vertices) {
+        setVertices(std::vector<float>(vertices));
     }
 
-    // Set index data
-    void setIndices(const std::vector<unsigned int>& indices) {
-        this->indices = indices;
+    void setVertices(std::vector<float>&& vertices) {
+        MeshGeometry& editable = editGeometry();
+        editable.vertices = std::move(vertices);
+        editable.rebuild();
     }
-    
-    // *** Face/Triangle Management ***
-    
-    // Ensure faces match indices (rebuild after changes)
-    void synchronizeFacesAndIndices() {
-        // Ensure indices size is a multiple of 3
-        if (indices.size() % 3 != 0) {
-            size_t properSize = (indices.size() / 3) * 3;
-            indices.resize(properSize);
-        }
 
-        // Rebuild faces from indices
-        constructFaces();
+    // Set color data. Faces are untouched, the accelerator of unshared geometry stays valid.
+    void setColors(const std::vector<float>& colors) {
+        setColors(std::vector<float>(colors));
+    }
 
-        // Verify consistency
-        size_t expectedFaces = indices.size() / 3;
-        if (faces.size() != expectedFaces) {
-            faces.resize(expectedFaces);
+    void setColors(std::vector<float>&& colors) {
+        editGeometry().colors = std::move(colors);
+    }
 
-            // Reset selection if now invalid
-            if (selectedFaceIndex >= static_cast<int>(faces.size())) {
-                selectedFaceIndex = -1;
-            }
-        }
+    // Set index data
+    void setIndices(const std::vector<unsigned int>& indices) {
+        setIndices(std::vector<unsigned int>(indices));
     }
 
-    // Build face objects from indices and transformed vertices
-    void constructFaces() {
-        faces.clear();
+    void setIndices(std::vector<unsigned int>&& indices) {
+        MeshGeometry& editable = editGeometry();
+        editable.indices = std::move(indices);
+        editable.rebuild();
 
-        // Safety check - ensure valid data
-        if (indices.empty() || indices.size() % 3 != 0 || transformedVertices.empty()) {
-            return;
+        // Reset selection if now invalid
+        if (selectedFaceIndex >= static_cast<int>(editable.faces.size())) {
+            selectedFaceIndex = -1;
         }
+        faceSelection.reset();
+    }
 
-        // Create faces for each triangle (group of 3 indices)
-        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
-            try {
-                faces.emplace_back(indices[i], indices[i + 1], indices[i + 2], &transformedVertices);
-            }
-            catch (const std::out_of_range&) {
-                // Stop if indices reference invalid vertices
-                OutputDebugString(L"Error in constructFaces(): Face vertex index out of bounds\n");
-                break;
-            }
+    // Geometry that only this mesh references, copied first if it is shared (copy-on-write).
+    // Once published the render thread's copy shares it, so an edit after a publish always copies.
+    MeshGeometry& editGeometry() {
+        markChanged();
+        if (geometry.use_count() != 1) {
+            geometry = std::make_shared<MeshGeometry>(*geometry);
+            geometry->accelerator.reset(); // The copied accelerator points at the original's faces
         }
+        return *geometry;
+    }
+
+    // Flatten the mesh into world-space vertices (export, exact world bounds)
+    AABB getWorldVertices(std::vector<float>& worldVertices) const {
+        AABB worldBounds;
+        worldVertices.resize(geometry->vertices.size());
+        VertexTransform::transform(geometry->vertices.data(), worldVertices.data(), geometry->vertices.size() / 3,
+                                   modelMatrix, worldBounds.min, worldBounds.max);
+        return worldBounds;
     }
     
     // *** Appearance and Material Methods ***
     
-    // Update color for the entire mesh
+    // Update color for the entire mesh.
+    // Vertex colors belong to the shared geometry, so the color is applied per mesh at draw time.
     void updateColors(float r, float g, float b) {
         colorR = r;
         colorG = g;
         colorB = b;
-        
-        // Update per-vertex colors
-        for (size_t i = 0; i < colors.size(); i += 3) {
-            colors[i] = r;
-            colors[i + 1] = g;
-            colors[i + 2] = b;
-        }
+        useBaseColor = true;
+        markChanged();
     }
 
     // Apply scale factors to the mesh
@@ -510,6 +605,7 @@ public:
         scaleX = newScaleX;
         scaleY = newScaleY;
         scaleZ = newScaleZ;
+        markChanged();
     }
     
     // Set material properties
@@ -518,13 +614,16 @@ public:
         transparency = alpha;
         materialType = material;
         isTransparent = (alpha > 0.01f);
+        markChanged();
     }
 
     // *** Mesh Update and Transformation ***
 
     // Update mesh transformations and recalculate bounds
     void updateMesh() {
-        if (vertices.empty()) return;
+        PROFILE_SCOPE("mesh.update");
+        markChanged();
+        if (geometry->empty()) return;
 
         // Convert rotation angles to radians
         float rx = glm::radians(rotationX);
@@ -547,97 +646,59 @@ public:
         modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(centerX, centerY, centerZ)) *
             rotationMatrix * scaleMatrix *
             glm::translate(glm::mat4(1.0f), -origCenter);
+        inverseModelMatrix = glm::inverse(modelMatrix);
 
-        // Transform all vertices using the model matrix
-        transformedVertices.resize(vertices.size());
-        for (size_t i = 0; i < vertices.size(); i += 3) {
-            glm::vec4 vertex(vertices[i], vertices[i + 1], vertices[i + 2], 1.0f);
-            glm::vec4 transformed = modelMatrix * vertex;
-
-            transformedVertices[i] = transformed.x;
-            transformedVertices[i + 1] = transformed.y;
-            transformedVertices[i + 2] = transformed.z;
-        }
-
-        // Update both bounding volumes
+        // Update both bounding volumes. Only the transform changed, the shared vertices are untouched.
         calculateOBB();   // OBB updates first using the model matrix
-        calculateAABB();  // AABB updates from transformed vertices
-
-        // Rebuild faces with new transformed vertices
-        synchronizeFacesAndIndices();
+        calculateAABB();  // AABB from the transformed object bounds
     }
     
     // *** File Loading ***
-    
-    // Load mesh from STL file (binary or ASCII)
-    bool loadFromSTL(const std::string& filePath) {
-        std::ifstream file(filePath, std::ios::binary);
+
+    // Read a whole file into memory
+    static bool readFile(const std::string& filePath, std::vector<char>& bytes) {
+        PROFILE_SCOPE("import.read");
+        std::ifstream file(filePath, std::ios::binary | std::ios::ate);
         if (!file.is_open()) {
-            std::cerr << "Failed to open STL file: " << filePath << std::endl;
+            logMessage(LOG_ERROR, "Failed to open STL file: " + filePath);
             return false;
         }
 
-        // Extract filename for object naming
-        size_t lastSlash = filePath.find_last_of("/\\");
-        size_t lastDot = filePath.find_last_of(".");
-        if (lastSlash == std::string::npos) lastSlash = 0;
-        else lastSlash++; // Skip the slash
-        
-        if (lastDot > lastSlash) {
-            objectName = filePath.substr(lastSlash, lastDot - lastSlash);
-        } else {
-            objectName = filePath.substr(lastSlash);
+        std::streamsize fileSize = file.tellg();
+        file.seekg(0, std::ios::beg);
+        bytes.resize(static_cast<size_t>(fileSize));
+        return fileSize == 0 || static_cast<bool>(file.read(bytes.data(), fileSize));
+    }
+
+    // Parse an STL file (binary or ASCII) held in memory. Every vertex gets the given color.
+    static bool parseSTL(const std::vector<char>& bytes, const glm::vec3& color,
+                         std::vector<float>& vertices, std::vector<float>& colors, std::vector<unsigned int>& indices) {
+        PROFILE_SCOPE("import.parse");
+        // Read triangle count after the 80 byte header
+        uint32_t numTriangles = 0;
+        if (bytes.size() >= 80 + sizeof(numTriangles)) {
+            std::memcpy(&numTriangles, bytes.data() + 80, sizeof(numTriangles));
         }
-        objectType = "ImportedSTL";
-        
-        // Default color for imported STL (light gray)
-        colorR = 0.8f;
-        colorG = 0.8f;
-        colorB = 0.8f;
-
-        // Read STL header to determine format
-        char header[80];
-        file.read(header, 80);
-
-        // Read triangle count
-        uint32_t numTriangles;
-        file.read(reinterpret_cast<char*>(&numTriangles), sizeof(numTriangles));
 
         // Check if file is binary STL by size
-        file.seekg(0, std::ios::end);
-        std::streamsize fileSize = file.tellg();
-        file.seekg(80 + sizeof(numTriangles), std::ios::beg);
+        const size_t triangleSize = sizeof(float) * 12 + sizeof(uint16_t);
+        size_t expectedSize = 80 + sizeof(numTriangles) + static_cast<size_t>(numTriangles) * triangleSize;
 
-        std::streamsize expectedSize = 80 + sizeof(numTriangles) + numTriangles * (sizeof(float) * 12 + sizeof(uint16_t));
-        
-        // Clear existing data
-        vertices.clear();
-        indices.clear();
-        colors.clear();
-        
-        if (fileSize == expectedSize) {
-            // Process binary STL
-            for (uint32_t i = 0; i < numTriangles; ++i) {
-                float normal[3];
-                float vertex1[3], vertex2[3], vertex3[3];
-                uint16_t attributeByteCount;
+        if (bytes.size() == expectedSize) {
+            // Process binary STL, the triangle count is known so size the buffers up front
+            vertices.reserve(static_cast<size_t>(numTriangles) * 9);
+            colors.reserve(static_cast<size_t>(numTriangles) * 9);
+            indices.reserve(static_cast<size_t>(numTriangles) * 3);
 
-                // Read normal vector (skip for now)
-                file.read(reinterpret_cast<char*>(normal), sizeof(normal));
-
-                // Read triangle vertices
-                file.read(reinterpret_cast<char*>(vertex1), sizeof(vertex1));
-                file.read(reinterpret_cast<char*>(vertex2), sizeof(vertex2));
-                file.read(reinterpret_cast<char*>(vertex3), sizeof(vertex3));
-
-                // Read attribute byte count (skip for now)
-                file.read(reinterpret_cast<char*>(&attributeByteCount), sizeof(attributeByteCount));
+            const char* cursor = bytes.data() + 80 + sizeof(numTriangles);
+            for (uint32_t i = 0; i < numTriangles; ++i, cursor += triangleSize) {
+                // Skip the normal, read the three vertices, ignore the attribute byte count
+                float triangle[9];
+                std::memcpy(triangle, cursor + sizeof(float) * 3, sizeof(triangle));
 
                 // Add vertices to the mesh
                 size_t baseIndex = vertices.size() / 3;
-                vertices.insert(vertices.end(), { vertex1[0], vertex1[1], vertex1[2] });
-                vertices.insert(vertices.end(), { vertex2[0], vertex2[1], vertex2[2] });
-                vertices.insert(vertices.end(), { vertex3[0], vertex3[1], vertex3[2] });
+                vertices.insert(vertices.end(), triangle, triangle + 9);
 
                 // Add indices
                 indices.insert(indices.end(), { 
@@ -647,20 +708,14 @@ public:
                 });
 
                 // Add colors
-                colors.insert(colors.end(), { colorR, colorG, colorB });
-                colors.insert(colors.end(), { colorR, colorG, colorB });
-                colors.insert(colors.end(), { colorR, colorG, colorB });
+                colors.insert(colors.end(), { color.x, color.y, color.z });
+                colors.insert(colors.end(), { color.x, color.y, color.z });
+                colors.insert(colors.end(), { color.x, color.y, color.z });
             }
         }
         else {
             // Process ASCII STL
-            file.close();
-            file.open(filePath, std::ios::in);
-            if (!file.is_open()) {
-                std::cerr << "Failed to reopen STL file in ASCII mode: " << filePath << std::endl;
-                return false;
-            }
-
+            std::istringstream file(std::string(bytes.begin(), bytes.end()));
             std::string line;
             size_t baseIndex = 0;
             while (std::getline(file, line)) {
@@ -671,7 +726,7 @@ public:
                     iss >> vertexKeyword >> x >> y >> z;
 
                     vertices.insert(vertices.end(), { x, y, z });
-                    colors.insert(colors.end(), { colorR, colorG, colorB });
+                    colors.insert(colors.end(), { color.x, color.y, color.z });
                 }
                 else if (line.find("endfacet") != std::string::npos) {
                     indices.insert(indices.end(), { 
@@ -683,205 +738,49 @@ public:
                 }
             }
         }
-
-        file.close();
-        
-        // Initialize the mesh with the loaded data
-        init(vertices, colors, indices);
         return true;
     }
-    
-    // *** Rendering Methods ***
-    
-    // Render the mesh
-    void draw() const {
-        // Skip rendering if not visible
-        if (!isVisible) return;
-
-        // Safety check for face highlighting
-        bool canHighlightFace = isSelected &&
-            selectedFaceIndex >= 0 &&
-            selectedFaceIndex < static_cast<int>(faces.size()) &&
-            selectedFaceIndex * 3 + 2 < indices.size();
 
-        // Enable vertex and color arrays
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glVertexPointer(3, GL_FLOAT, 0, transformedVertices.data());
+    // Name the mesh after the file (without directory and extension) and mark it as imported
+    void setImportedName(const std::string& filePath) {
+        size_t lastSlash = filePath.find_last_of("/\\");
+        size_t lastDot = filePath.find_last_of(".");
+        if (lastSlash == std::string::npos) lastSlash = 0;
+        else lastSlash++; // Skip the slash
         
-        glEnableClientState(GL_COLOR_ARRAY);
-        glColorPointer(3, GL_FLOAT, 0, colors.data());
-
-        // Setup transparency if enabled
-        if (isTransparent) {
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-            glColor4f(colorR, colorG, colorB, 1.0f - transparency);
-        }
-
-        // Enable wireframe mode if requested
-        if (wireframeMode) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        }
-
-        // Draw with appropriate highlight method
-        if (isSelected) {
-            // Highlight entire mesh if no specific face is selected
-            if (!canHighlightFace) {
-                // Draw mesh with normal colors
-                glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, indices.data());
-
-                // Draw wireframe highlight overlay
-                glDisableClientState(GL_COLOR_ARRAY);
-                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-                glLineWidth(2.0f);
-                glColor3f(1.0f, 1.0f, 0.0f); // Yellow highlight
-                glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, indices.data());
-                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-                glLineWidth(1.0f);
-            }
-            // Highlight specific triangle
-            else {
-                // Draw non-selected triangles normally
-                for (int i = 0; i < static_cast<int>(faces.size()); ++i) {
-                    if (i != selectedFaceIndex && i * 3 + 2 < indices.size()) {
-                        glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, &indices[i * 3]);
-                    }
-                }
-
-                // Draw the selected triangle with highlight
-                glDisableClientState(GL_COLOR_ARRAY);
-                
-                // Fill with semi-transparent highlight
-                glEnable(GL_BLEND);
-                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-                glColor4f(1.0f, 0.5f, 0.0f, 0.7f); // Orange highlight
-                glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, &indices[selectedFaceIndex * 3]);
-
-                // Draw outline
-                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-                glLineWidth(3.0f);
-                glColor3f(1.0f, 0.8f, 0.0f); // Yellow-orange outline
-                glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, &indices[selectedFaceIndex * 3]);
-                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-                glLineWidth(1.0f);
-                glDisable(GL_BLEND);
-            }
-        }
-        else {
-            // Draw normally without highlighting
-            glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, indices.data());
-        }
-
-        // Restore render states
-        if (isTransparent) {
-            glDisable(GL_BLEND);
-        }
-
-        if (wireframeMode) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        }
-
-        glDisableClientState(GL_VERTEX_ARRAY);
-        glDisableClientState(GL_COLOR_ARRAY);
-
-        // Draw additional visualizations if enabled
-        if (showBoundingBox) {
-            drawBoundingBox();
-        }
-
-        if (showVertices) {
-            drawVertices();
+        if (lastDot != std::string::npos && lastDot > lastSlash) {
+            objectName = filePath.substr(lastSlash, lastDot - lastSlash);
+        } else {
+            objectName = filePath.substr(lastSlash);
         }
-    }
-
-    // Draw local coordinate axes
-    void drawLocalAxis() const {
-        if (vertices.empty() || !isVisible) return;
+        objectType = "ImportedSTL";
         
-        // Draw the axes
-        glBegin(GL_LINES);
-
-        // X-axis (red)
-        glColor3f(1.0f, 0.0f, 0.0f);
-        glVertex3f(centerX, centerY, centerZ);
-        glVertex3f(centerX + 2.0f, centerY, centerZ);
-
-        // Y-axis (green)
-        glColor3f(0.0f, 1.0f, 0.0f);
-        glVertex3f(centerX, centerY, centerZ);
-        glVertex3f(centerX, centerY + 2.0f, centerZ);
-
-        // Z-axis (blue)
-        glColor3f(0.0f, 0.0f, 1.0f);
-        glVertex3f(centerX, centerY, centerZ);
-        glVertex3f(centerX, centerY, centerZ + 2.0f);
-
-        glEnd();
-    }
-    
-    // Draw the bounding box (using OBB corners)
-    void drawBoundingBox() const {
-        if (transformedVertices.empty() || !isVisible) return;
-
-        // Draw using the OBB corners for accurate visualization
-        glColor3f(1.0f, 1.0f, 0.0f); // Yellow color
-        glBegin(GL_LINES);
-
-        // Bottom face
-        glVertex3f(obbCorners[0].x, obbCorners[0].y, obbCorners[0].z);
-        glVertex3f(obbCorners[1].x, obbCorners[1].y, obbCorners[1].z);
-
-        glVertex3f(obbCorners[1].x, obbCorners[1].y, obbCorners[1].z);
-        glVertex3f(obbCorners[2].x, obbCorners[2].y, obbCorners[2].z);
-
-        glVertex3f(obbCorners[2].x, obbCorners[2].y, obbCorners[2].z);
-        glVertex3f(obbCorners[3].x, obbCorners[3].y, obbCorners[3].z);
-
-        glVertex3f(obbCorners[3].x, obbCorners[3].y, obbCorners[3].z);
-        glVertex3f(obbCorners[0].x, obbCorners[0].y, obbCorners[0].z);
-
-        // Top face
-        glVertex3f(obbCorners[4].x, obbCorners[4].y, obbCorners[4].z);
-        glVertex3f(obbCorners[5].x, obbCorners[5].y, obbCorners[5].z);
-
-        glVertex3f(obbCorners[5].x, obbCorners[5].y, obbCorners[5].z);
-        glVertex3f(obbCorners[6].x, obbCorners[6].y, obbCorners[6].z);
-
-        glVertex3f(obbCorners[6].x, obbCorners[6].y, obbCorners[6].z);
-        glVertex3f(obbCorners[7].x, obbCorners[7].y, obbCorners[7].z);
-
-        glVertex3f(obbCorners[7].x, obbCorners[7].y, obbCorners[7].z);
-        glVertex3f(obbCorners[4].x, obbCorners[4].y, obbCorners[4].z);
-
-        // Vertical edges
-        glVertex3f(obbCorners[0].x, obbCorners[0].y, obbCorners[0].z);
-        glVertex3f(obbCorners[4].x, obbCorners[4].y, obbCorners[4].z);
-
-        glVertex3f(obbCorners[1].x, obbCorners[1].y, obbCorners[1].z);
-        glVertex3f(obbCorners[5].x, obbCorners[5].y, obbCorners[5].z);
-
-        glVertex3f(obbCorners[2].x, obbCorners[2].y, obbCorners[2].z);
-        glVertex3f(obbCorners[6].x, obbCorners[6].y, obbCorners[6].z);
-
-        glVertex3f(obbCorners[3].x, obbCorners[3].y, obbCorners[3].z);
-        glVertex3f(obbCorners[7].x, obbCorners[7].y, obbCorners[7].z);
-
-        glEnd();
+        // Default color for imported STL (light gray)
+        colorR = 0.8f;
+        colorG = 0.8f;
+        colorB = 0.8f;
     }
     
-    // Draw points at each vertex
-    void drawVertices() const {
-        if (transformedVertices.empty() || !isVisible) return;
+    // Load mesh from STL file (binary or ASCII)
+    bool loadFromSTL(const std::string& filePath) {
+        std::vector<char> bytes;
+        if (!readFile(filePath, bytes)) {
+            return false;
+        }
 
-        glPointSize(5.0f);
-        glBegin(GL_POINTS);
-        glColor3f(0.0f, 0.0f, 0.0f); // Black dots
+        setImportedName(filePath);
 
-        for (size_t i = 0; i < transformedVertices.size(); i += 3) {
-            glVertex3f(transformedVertices[i], transformedVertices[i + 1], transformedVertices[i + 2]);
+        // Load into local buffers, they are moved into the mesh by init()
+        std::vector<float> vertices;
+        std::vector<float> colors;
+        std::vector<unsigned int> indices;
+        if (!parseSTL(bytes, glm::vec3(colorR, colorG, colorB), vertices, colors, indices)) {
+            return false;
         }
-
-        glEnd();
+        
+        // Initialize the mesh with the loaded data
+        init(std::move(vertices), std::move(colors), std::move(indices));
+        return true;
     }
     
     // *** Toggle Methods ***
@@ -889,46 +788,70 @@ public:
     // Toggle bounding box visibility
     void toggleBoundingBox() {
         showBoundingBox = !showBoundingBox;
+        markChanged();
     }
 
     // Toggle vertex points visibility
     void toggleVertices() {
         showVertices = !showVertices;
+        markChanged();
     }
     
     // Toggle wireframe rendering mode
     void toggleWireframe() {
         wireframeMode = !wireframeMode;
+        markChanged();
     }
     
     // Toggle mesh visibility
     void toggleVisibility() {
         isVisible = !isVisible;
+        markChanged();
     }
     
     // *** Selection Methods ***
     
     // Set or clear selection state
     void setSelected(bool selected) {
+        // Deselecting every mesh is common, only republish the ones that change
+        if (isSelected == selected && (selected || (selectedFaceIndex == -1 && !faceSelection))) return;
         isSelected = selected;
         if (!selected) {
             selectedFaceIndex = -1; // Clear face selection when deselecting
+            faceSelection.reset();
         }
+        markChanged();
     }
 
     // Select a specific face/triangle
     void selectFace(int faceIndex) {
-        if (faceIndex >= 0 && faceIndex < static_cast<int>(faces.size()) &&
-            faceIndex * 3 + 2 < indices.size()) {
+        if (faceIndex >= 0 && faceIndex < static_cast<int>(geometry->faces.size()) &&
+            static_cast<size_t>(faceIndex) * 3 + 2 < geometry->indices.size()) {
             selectedFaceIndex = faceIndex;
         }
         else {
             selectedFaceIndex = -1; // Invalid face index
         }
+        faceSelection.reset();
+        markChanged();
+    }
+
+    // Select the mesh and a set of its faces, e.g. those inside a selection rectangle
+    void selectFaces(std::vector<int>&& faceIndices) {
+        isSelected = true;
+        selectedFaceIndex = -1;
+        faceSelection.reset();
+        if (!faceIndices.empty()) {
+            faceSelection = std::make_shared<const FaceSelection>(std::move(faceIndices), geometry->indices);
+        }
+        markChanged();
     }
 
     // Check if a specific face is selected
     bool hasFaceSelected() const {
-        return isSelected && selectedFaceIndex >= 0;
+        return isSelected && (selectedFaceIndex >= 0 || faceSelection);
     }
 };
+
+// Scene storage for meshes
+typedef SlotMap<Mesh> MeshStore;
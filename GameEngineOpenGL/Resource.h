@@ -55,6 +55,10 @@
 #define IDM_CONTEXT_ORBIT               32783
 #define IDM_CONTEXT_FIT_TO_VIEW         32784
 #define IDM_CONTEXT_EDIT_PROPERTIES     32785
+#define IDM_ACCEL_AUTO                  32786
+#define IDM_ACCEL_BVH                   32787
+#define IDM_ACCEL_KDTREE                32788
+#define IDM_ACCEL_LBVH                  32789
 #define IDC_STATIC                      -1
 
 // Next default values for new objects
@@ -63,7 +67,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NO_MFC                     1
 #define _APS_NEXT_RESOURCE_VALUE        151
-#define _APS_NEXT_COMMAND_VALUE         32786
+#define _APS_NEXT_COMMAND_VALUE         32790
 #define _APS_NEXT_CONTROL_VALUE         1052
 #define _APS_NEXT_SYMED_VALUE           110
 #endif
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Mesh.h"
+#include "frustum.h"
+#include "ray.h"
+
+/*
+* Traversal core of the spatial accelerators, specialised at compile time.
+*
+* The walk is written once per kind of tree and templated over three policies:
+*   Layout       how nodes are stored (pointer tree, flat array); see BVH::Layout for the members
+*   Intersector  the primitive test, bool operator()(const Face&, const Ray&)
+*   HitHandler   called with each accepted Face*, e.g. collect into a vector or keep the closest
+* plus an optional Counting policy that fills TraversalCounters, or compiles to nothing.
+*
+* Every call is resolved at compile time, so an instantiation for one accelerator, intersector and
+* handler inlines into one loop without virtual calls. SpatialAccelerator::traverse() is a thin virtual
+* wrapper over these for callers that do not know the accelerator type. Code that does, or recovers
+* it once with visitAccelerator() (picking, batch ray queries, benchmarks), calls the accelerators'
+* forEachHit() templates directly.
+*
+* Frustum queries (rectangle selection) walk the same layouts with a Frustum instead of a ray, see
+* traverseBoxTreeInFrustum() and traverseSplitTreeInFrustum().
+*
+* The stacks are fixed arrays of TRAVERSAL_STACK_SIZE entries: a walk pushes at most two children per
+* node it pops, so the stack never holds more than the tree depth + 1 entries.
+*/
+
+#define TRAVERSAL_STACK_SIZE 64
+
+// Work done by traverse() calls given these counters. Divide by queries for per-ray figures.
+struct TraversalCounters {
+    uint64_t queries = 0;
+    uint64_t nodesVisited = 0;      // Nodes taken off the traversal stack
+    uint64_t trianglesTested = 0;
+};
+
+// Counting policy that counts nothing, every call inlines away
+struct NoTraversalCounting {
+    void query() {}
+    void node() {}
+    void triangles(size_t) {}
+};
+
+// Counting policy that adds to a TraversalCounters
+struct TraversalCounting {
+    TraversalCounters& counters;
+
+    explicit TraversalCounting(TraversalCounters& counters) : counters(counters) {}
+
+    void query() { counters.queries++; }
+    void node() { counters.nodesVisited++; }
+    void triangles(size_t count) { counters.trianglesTested += count; }
+};
+
+// The accelerators' default primitive test
+struct FaceRayIntersector {
+    bool operator()(const Face& face, const Ray& ray) const {
+        return face.isIntersectingRay(ray.origin, ray.direction, ray.tMin, ray.tMax);
+    }
+};
+
+// Hit handler appending to a vector, what SpatialAccelerator::traverse() returns
+struct FaceCollector {
+    std::vector<Face*>& hitFaces;
+
+    explicit FaceCollector(std::vector<Face*>& hitFaces) : hitFaces(hitFaces) {}
+
+    void operator()(Face* face) { hitFaces.push_back(face); }
+};
+
+// Walk a hierarchy of bounding boxes (BVH, LBVH). Every node has a box, inner nodes two children,
+// leaves a range of faces.
+template <typename Layout, typename Intersector, typename HitHandler, typename Counting>
+inline void traverseBoxTree(const Layout& layout, const Ray& ray, const Intersector& intersect, HitHandler& onHit, Counting& counting) {
+    static_assert(Layout::maxDepth + 2 <= TRAVERSAL_STACK_SIZE, "Tree deeper than the traversal stack");
+    typedef typename Layout::NodeRef NodeRef;
+
+    counting.query();
+    if (layout.empty()) return;
+
+    NodeRef stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = layout.root();
+    while (top > 0) {
+        NodeRef node = stack[--top];
+        counting.node();
+        if (!layout.box(node).isIntersectingRay(ray.origin, ray.direction, ray.tMin, ray.tMax)) continue;
+
+        if (layout.isLeaf(node)) {
+            Face* const* begin = layout.leafBegin(node);
+            Face* const* end = layout.leafEnd(node);
+            counting.triangles(end - begin);
+            for (Face* const* face = begin; face != end; ++face) {
+                if (intersect(**face, ray)) onHit(*face);
+            }
+            continue;
+        }
+
+        NodeRef first, second;
+        layout.children(node, first, second);
+        stack[top++] = second;
+        stack[top++] = first;
+    }
+}
+
+// Walk a space partitioning tree (KD-tree) front to back. Inner nodes split their box with an axis
+// aligned plane; the ray interval [tMin, tMax] is clipped at the plane so each child only sees the
+// part of the ray inside it. Leaves hold lists of faces, a face may be in several leaves.
+template <typename Layout, typename Intersector, typename HitHandler, typename Counting>
+inline void traverseSplitTree(const Layout& layout, const Ray& ray, const Intersector& intersect, HitHandler& onHit, Counting& counting) {
+    static_assert(Layout::maxDepth + 2 <= TRAVERSAL_STACK_SIZE, "Tree deeper than the traversal stack");
+    typedef typename Layout::NodeRef NodeRef;
+    struct StackEntry {
+        NodeRef node;
+        float tMin, tMax;
+    };
+
+    counting.query();
+    if (layout.empty()) return;
+
+    StackEntry stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = StackEntry{ layout.root(), ray.tMin, ray.tMax };
+    while (top > 0) {
+        StackEntry entry = stack[--top];
+        NodeRef node = entry.node;
+        float tMin = entry.tMin;
+        float tMax = entry.tMax;
+        counting.node();
+
+        // Skip nodes with an invalid bounding box, or that the ray misses
+        const AABB& box = layout.box(node);
+        if (glm::any(glm::isnan(box.min)) || glm::any(glm::isnan(box.max))) continue;
+        if (!box.isIntersectingRay(ray.origin, ray.direction, tMin, tMax)) continue;
+
+        // Faces are tested against the whole ray, they may reach outside this leaf
+        if (layout.isLeaf(node)) {
+            Face* const* begin = layout.leafBegin(node);
+            Face* const* end = layout.leafEnd(node);
+            counting.triangles(end - begin);
+            for (Face* const* face = begin; face != end; ++face) {
+                if (intersect(**face, ray)) onHit(*face);
+            }
+            continue;
+        }
+
+        int axis = layout.splitAxis(node);
+        if (axis < 0 || axis > 2) continue;
+        float splitPos = layout.splitPosition(node);
+        float tSplit = (splitPos - ray.origin[axis]) / ray.direction[axis];
+
+        // The child on the ray origin's side is visited first
+        NodeRef firstChild, secondChild;
+        if (ray.origin[axis] < splitPos || (ray.origin[axis] == splitPos && ray.direction[axis] <= 0)) {
+            firstChild = layout.left(node);
+            secondChild = layout.right(node);
+        }
+        else {
+            firstChild = layout.right(node);
+            secondChild = layout.left(node);
+        }
+
+        // Parallel to the plane, or the plane is outside [tMin, tMax]: one child only
+        if (std::abs(ray.direction[axis]) < std::numeric_limits<float>::epsilon() || tSplit >= tMax || tSplit <= 0) {
+            if (!layout.isNull(firstChild)) stack[top++] = StackEntry{ firstChild, tMin, tMax };
+        }
+        else if (tSplit <= tMin) {
+            if (!layout.isNull(secondChild)) stack[top++] = StackEntry{ secondChild, tMin, tMax };
+        }
+        else {
+            // Ray passes through the splitting plane, visit both children
+            if (!layout.isNull(secondChild)) stack[top++] = StackEntry{ secondChild, tSplit, tMax };
+            if (!layout.isNull(firstChild)) stack[top++] = StackEntry{ firstChild, tMin, tSplit };
+        }
+    }
+}
+
+// Every face of a box tree overlapping the frustum. Each stack entry carries the planes its box still
+// straddles: a box wholly inside the frustum accepts its whole subtree with no further box or triangle
+// test, a box wholly outside one plane rejects it. onFace(Face*) sees each face once.
+template <typename Layout, typename FaceHandler, typename Counting>
+inline void traverseBoxTreeInFrustum(const Layout& layout, const Frustum& frustum, FaceHandler& onFace, Counting& counting) {
+    static_assert(Layout::maxDepth + 2 <= TRAVERSAL_STACK_SIZE, "Tree deeper than the traversal stack");
+    typedef typename Layout::NodeRef NodeRef;
+    struct StackEntry {
+        NodeRef node;
+        unsigned int planes;
+    };
+
+    counting.query();
+    if (layout.empty()) return;
+
+    StackEntry stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = StackEntry{ layout.root(), frustum.activePlanes };
+    while (top > 0) {
+        StackEntry entry = stack[--top];
+        NodeRef node = entry.node;
+        unsigned int planes = entry.planes;
+        counting.node();
+        if (planes && !frustum.cullBox(layout.box(node), planes)) continue;
+
+        if (layout.isLeaf(node)) {
+            Face* const* begin = layout.leafBegin(node);
+            Face* const* end = layout.leafEnd(node);
+            if (!planes) {
+                for (Face* const* face = begin; face != end; ++face) onFace(*face);
+                continue;
+            }
+            counting.triangles(end - begin);
+            for (Face* const* face = begin; face != end; ++face) {
+                if (frustum.overlapsTriangle((*face)->vertices, planes)) onFace(*face);
+            }
+            continue;
+        }
+
+        NodeRef first, second;
+        layout.children(node, first, second);
+        stack[top++] = StackEntry{ second, planes };
+        stack[top++] = StackEntry{ first, planes };
+    }
+}
+
+// Every face of a space partitioning tree overlapping the frustum, accepting and rejecting subtrees
+// like traverseBoxTreeInFrustum(). KDTree node boxes bound the faces listed beneath them, so a box
+// inside the frustum holds only faces inside it. Faces shared by several leaves reach onFace(Face*)
+// once per leaf, the handler removes duplicates.
+template <typename Layout, typename FaceHandler, typename Counting>
+inline void traverseSplitTreeInFrustum(const Layout& layout, const Frustum& frustum, FaceHandler& onFace, Counting& counting) {
+    static_assert(Layout::maxDepth + 2 <= TRAVERSAL_STACK_SIZE, "Tree deeper than the traversal stack");
+    typedef typename Layout::NodeRef NodeRef;
+    struct StackEntry {
+        NodeRef node;
+        unsigned int planes;
+    };
+
+    counting.query();
+    if (layout.empty()) return;
+
+    StackEntry stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = StackEntry{ layout.root(), frustum.activePlanes };
+    while (top > 0) {
+        StackEntry entry = stack[--top];
+        NodeRef node = entry.node;
+        unsigned int planes = entry.planes;
+        counting.node();
+
+        const AABB& box = layout.box(node);
+        if (glm::any(glm::isnan(box.min)) || glm::any(glm::isnan(box.max))) continue;
+        if (planes && !frustum.cullBox(box, planes)) continue;
+
+        if (layout.isLeaf(node)) {
+            Face* const* begin = layout.leafBegin(node);
+            Face* const* end = layout.leafEnd(node);
+            if (!planes) {
+                for (Face* const* face = begin; face != end; ++face) onFace(*face);
+                continue;
+            }
+            counting.triangles(end - begin);
+            for (Face* const* face = begin; face != end; ++face) {
+                if (frustum.overlapsTriangle((*face)->vertices, planes)) onFace(*face);
+            }
+            continue;
+        }
+
+        NodeRef left = layout.left(node);
+        NodeRef right = layout.right(node);
+        if (!layout.isNull(right)) stack[top++] = StackEntry{ right, planes };
+        if (!layout.isNull(left)) stack[top++] = StackEntry{ left, planes };
+    }
+}
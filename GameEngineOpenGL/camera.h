@@ -250,6 +250,13 @@ public:
 		return viewMatrix;
 	}
 
+	// True when both cameras produce the same image: same view, lens and grid position
+	bool rendersSameAs(const Camera& other) const {
+		return viewMatrix == other.viewMatrix && position == other.position &&
+			mode == other.mode && zoom == other.zoom &&
+			nearPlane == other.nearPlane && farPlane == other.farPlane;
+	}
+
 	// We are using a free look camera, therefore Euler angles are used to calculate the camera direction
 	void updateViewMatrix() {
 		if (orbitMode) {
@@ -291,7 +298,6 @@ public:
 			// Find the largest dimension, adjust for aspect ratio
 			float width = size.x;
 			float height = size.y;
-			float depth = size.z;
 			float viewWidth = width;
 			float viewHeight = height;
 			if (aspectRatio > 1.0f) {
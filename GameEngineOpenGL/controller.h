@@ -3,30 +3,42 @@
 #include "view.h"
 #include <windows.h>
 #include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
 #include <commdlg.h>
 #include <string>
 
+// Ray and hit of every pick in the debugger output. Off by default: formatting them allocates,
+// and picks run on every mouse move.
+#ifndef PICK_DEBUG_OUTPUT
+#define PICK_DEBUG_OUTPUT 0
+#endif
 
 class Controller {
 public:
 	Model* model;
 	View* view;
 	std::thread thread;
-	bool loopThreadFlag;
+	std::atomic<int> targetFrameRate; // Upper bound on frames per second, 0 draws every change right away
 	HWND handle;
 	HWND parentHandle;
 	int mouseX;
 	int mouseY;
-	int selectedMeshIndex; // Track the currently selected mesh index
+	MeshHandle selectedMesh; // Track the currently selected mesh
 	int selectedFaceIndex; // Track the currently selected face index
+	bool selectingRectangle; // Shift+drag in progress, from rectangleStartX, rectangleStartY to the cursor
+	int rectangleStartX, rectangleStartY;
 
 	Controller(Model* model, View* view) : model(model), view(view), mouseX(0), mouseY(0),
 		handle(NULL), parentHandle(NULL),
-		loopThreadFlag(false), selectedMeshIndex(-1), selectedFaceIndex(-1) {
+		targetFrameRate(0), selectedMesh(), selectedFaceIndex(-1),
+		selectingRectangle(false), rectangleStartX(0), rectangleStartY(0) {
 	}
 
 	~Controller() {
-		loopThreadFlag = false; // Signal the thread to stop
+		model->renderCommands.close(); // Wake the render thread and let it exit
 		if (thread.joinable())
 		{
 			thread.join(); // Wait for the thread to finish
@@ -43,21 +55,47 @@ public:
 		}
 		// Create a separate thread for the OpenGL context
 		thread = std::thread(&Controller::runThread, this);
-		loopThreadFlag = true;
 		return 0;
 	}
 
 	void runThread() {
+		TRACE_THREAD_NAME("Render");
 		wglMakeCurrent(view->getHdc(), view->getHglrc());
-		model->init();
-		RECT rect;
-		while (loopThreadFlag) {
-			GetClientRect(handle, &rect);
-			int width = rect.right - rect.left;
-			int height = rect.bottom - rect.top;
-			view->setWindowSize(width, height);
-			view->render();
-			view->swapBuffer();
+		view->initRenderState();
+		// Everything drawn comes from this snapshot, edits reach it through the command queue
+		SceneSnapshot snapshot;
+		// Sleeps until the UI publishes something that changes the image
+		while (model->renderCommands.waitForFrame()) {
+			std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+			{
+				// Whole frame on the timeline, limiter sleep excluded
+				TRACE_SCOPE("render.loop");
+				// Frame boundary: apply what the UI thread published since the last frame
+				{
+					PROFILE_SCOPE("render.apply_commands");
+					model->renderCommands.applyTo(snapshot);
+				}
+				// One hover pick per frame, for the latest cursor position over the scene as drawn
+				if (snapshot.hovering && snapshot.width > 0 && snapshot.height > 0) {
+					PROFILE_SCOPE("render.hover_pick");
+					snapshot.pickHover(pickRay(static_cast<float>(snapshot.hoverX), static_cast<float>(snapshot.hoverY),
+						snapshot.width, snapshot.height, snapshot.camera.getViewMatrix(), snapshot.getProjectionMatrix(), snapshot.camera));
+				}
+				else {
+					snapshot.clearHover();
+				}
+				view->render(snapshot);
+				{
+					PROFILE_SCOPE("render.swap");
+					view->swapBuffer();
+				}
+			}
+
+			// Frame limiter: changes published meanwhile are drawn together in the next frame
+			int frameRate = targetFrameRate;
+			if (frameRate > 0) {
+				std::this_thread::sleep_until(frameStart + std::chrono::microseconds(1000000 / frameRate));
+			}
 		}
 		view->closeContext(handle);
 		wglMakeCurrent(NULL, NULL);
@@ -65,6 +103,20 @@ public:
 
 	void resizeWindow(int width, int height) {
 		view->setWindowSize(width, height);
+		model->renderCommands.pushWindowSize(width, height);
+		if (height > 0) {
+			model->updateProjection(width, height);
+		}
+	}
+
+	// Window contents were lost (uncovered, restored), draw the current snapshot again
+	void requestRedraw() {
+		model->renderCommands.requestRedraw();
+	}
+
+	// Cap the frame rate while the scene keeps changing (e.g. dragging the camera), 0 for no cap
+	void setTargetFrameRate(int framesPerSecond) {
+		targetFrameRate = framesPerSecond;
 	}
 
 	void handleKeyboardInput(WPARAM wParam) {
@@ -90,12 +142,12 @@ public:
 
 	void zoomIn() {
 		model->camera.zoomIn(0.1f);
-		view->setWindowSize(view->getWindowWidth(), view->getWindowHeight());
+		resizeWindow(view->getWindowWidth(), view->getWindowHeight());
 	}
 
 	void zoomOut() {
 		model->camera.zoomOut(0.1f);
-		view->setWindowSize(view->getWindowWidth(), view->getWindowHeight());
+		resizeWindow(view->getWindowWidth(), view->getWindowHeight());
 	}
 
 	// Clear selection for all meshes
@@ -103,13 +155,13 @@ public:
 		for (auto& mesh : model->meshes) {
 			mesh.setSelected(false);
 		}
-		selectedMeshIndex = -1;
+		selectedMesh = MeshHandle();
 		selectedFaceIndex = -1;
 	}
 
 	// Handles camera rotation based on mouse movement
 	void handleMouseInput(WPARAM state, float x, float y) {
-		if (state == MK_LBUTTON)
+		if (state == MK_LBUTTON && !selectingRectangle)
 		{
 			float mouseDeltaX = (x - mouseX);
 			float mouseDeltaY = (y - mouseY);
@@ -145,11 +197,12 @@ public:
 			outOrigin = glm::vec3(nearWorldPoint);
 			outDir = glm::normalize(glm::vec3(farWorldPoint) - glm::vec3(nearWorldPoint));
 			
-			// Debug output for ray picking
+#if PICK_DEBUG_OUTPUT
 			std::wstringstream ss;
 			ss << L"[Ortho Ray] Origin: (" << outOrigin.x << ", " << outOrigin.y << ", " << outOrigin.z 
 			   << ") Dir: (" << outDir.x << ", " << outDir.y << ", " << outDir.z << ")\n";
 			OutputDebugString(ss.str().c_str());
+#endif
 		}
 		else {
 			// Perspective projection
@@ -166,18 +219,49 @@ public:
 			outOrigin = camera.getPosition();
 			outDir = rayWorld;
 			
-			// Debug output for ray picking
+#if PICK_DEBUG_OUTPUT
 			std::wstringstream ss;
 			ss << L"[Persp Ray] Origin: (" << outOrigin.x << ", " << outOrigin.y << ", " << outOrigin.z 
 			   << ") Dir: (" << outDir.x << ", " << outDir.y << ", " << outDir.z << ")\n";
 			OutputDebugString(ss.str().c_str());
+#endif
 		}
 	}
 	
-	// Handles mouse button down events, for object selection or other actions
+	// Picking ray through a screen point, with the ray range of the camera mode
+	Ray pickRay(float x, float y, int screenWidth, int screenHeight,
+		const glm::mat4& view, const glm::mat4& projection, const Camera& camera) {
+		glm::vec3 rayOrigin, rayDir;
+		screenPointToRay(x, y, screenWidth, screenHeight, view, projection, camera, rayOrigin, rayDir);
+
+		// For orthographic mode, use a large ray range since we could have objects in negative space
+		if (camera.mode == ORTHOGRAPHIC_MODE) {
+			return Ray(rayOrigin, rayDir, -std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+		}
+		return Ray(rayOrigin, rayDir, 0.0f, std::numeric_limits<float>::max());
+	}
+
+	// Cursor moved over the view: hover pre-selection follows it unless a button drags the camera.
+	// The render thread picks for the latest position once per frame.
+	void handleMouseHover(WPARAM state, int x, int y) {
+		bool dragging = (state & (MK_LBUTTON | MK_RBUTTON | MK_MBUTTON)) != 0;
+		model->renderCommands.pushHover(!dragging, x, y);
+	}
+
+	void handleMouseLeave() {
+		model->renderCommands.pushHover(false, 0, 0);
+	}
+
+	// Handles mouse button down events, for object selection or other actions.
+	// Shift starts a rectangle selection instead of picking.
 	void handleMouseDown(WPARAM state, float x, float y) {
 		mouseX = x;
 		mouseY = y;
+		if (state & MK_SHIFT) {
+			beginRectangleSelection(static_cast<int>(x), static_cast<int>(y));
+			return;
+		}
+
 		// 1. Get camera matrices and window size
 		glm::mat4 viewMatrix = model->camera.getViewMatrix();
 		glm::mat4 projMatrix = model->getProjectionMatrix();
@@ -185,36 +269,24 @@ public:
 		int height = view->getWindowHeight();
 
 		// 2. Convert screen point to ray
-		glm::vec3 rayOrigin, rayDir;
-		screenPointToRay(x, y, width, height, viewMatrix, projMatrix, model->camera, rayOrigin, rayDir);
+		Ray ray = pickRay(x, y, width, height, viewMatrix, projMatrix, model->camera);
 
-		// 3. Perform ray test to find intersections and track both mesh and face indices
-		int meshIndex = -1;
+		// 3. Perform ray test to find intersections and track both mesh and face
+		MeshHandle hitMesh;
 		int faceIndex = -1;
-		
-		// Set appropriate ray range based on camera mode
-		float tMin = 0.0f;
-		float tMax = std::numeric_limits<float>::max();
-		
-		// For orthographic mode, use a large ray range since we could have objects in negative space
-		if (model->camera.mode == ORTHOGRAPHIC_MODE) {
-			tMin = -std::numeric_limits<float>::max(); // Allow intersections behind the ray origin
-			tMax = std::numeric_limits<float>::max();
-		}
-		
-		Ray ray(rayOrigin, rayDir, tMin, tMax);
-		findRayIntersection(ray, meshIndex, faceIndex);
+		model->recorder.recordPick(ray);
+		findRayIntersection(ray, hitMesh, faceIndex);
         
         // 4. Selection logic:
-        if (meshIndex >= 0) {
+        if (!hitMesh.isNull()) {
             // Clicked on an object
-            if (selectedMeshIndex == meshIndex) {
+            if (selectedMesh == hitMesh) {
                 // Clicked on the same object - select triangle or deselect object
                 if (faceIndex >= 0) {
                     // If we clicked on a different triangle of the same mesh
                     if (selectedFaceIndex != faceIndex) {
                         // Select the specific triangle (keep the mesh selected)
-                        selectFace(meshIndex, faceIndex);
+                        selectFace(hitMesh, faceIndex);
 						selectedFaceIndex = faceIndex;
                     } 
                     // If clicked on same triangle, do nothing (keep it selected)
@@ -223,7 +295,7 @@ public:
             else {
                 // Clicked on a different object - clear previous selection and select new object
                 clearAllSelections();
-                selectMesh(meshIndex);
+                selectMesh(hitMesh);
             }
         } 
         else {
@@ -231,20 +303,92 @@ public:
             clearAllSelections();
         }
 
-        // Save the selected mesh index for the controller state
-		selectedMeshIndex = meshIndex;
+        // Save the selected mesh for the controller state
+		setSelection(hitMesh, selectedFaceIndex);
+	}
+
+	// Rectangle (marquee) selection: Shift+drag a rectangle over the view and release to select every
+	// visible mesh, and its faces, wholly or partly inside. The mouse is captured meanwhile, so the
+	// rectangle may leave the view; coordinates are signed client pixels.
+	void beginRectangleSelection(int x, int y) {
+		selectingRectangle = true;
+		rectangleStartX = x;
+		rectangleStartY = y;
+		SetCapture(handle);
+		model->renderCommands.pushSelectionRectangle(true, x, y, x, y);
+	}
+
+	void handleRectangleDrag(int x, int y) {
+		if (!selectingRectangle) return;
+		model->renderCommands.pushSelectionRectangle(true, rectangleStartX, rectangleStartY, x, y);
+	}
+
+	// Ends a rectangle selection. A rectangle of a few pixels is taken as a click.
+	void handleMouseUp(int x, int y) {
+		if (!selectingRectangle) return;
+		endRectangleSelection();
+		if (std::abs(x - rectangleStartX) < 3 && std::abs(y - rectangleStartY) < 3) {
+			handleMouseDown(0, static_cast<float>(x), static_cast<float>(y));
+		}
+		else {
+			selectInRectangle(rectangleStartX, rectangleStartY, x, y);
+		}
+	}
+
+	// Removes the rectangle and releases the mouse, selecting nothing by itself.
+	// Also called when the capture is taken away mid-drag.
+	void endRectangleSelection() {
+		if (!selectingRectangle) return;
+		selectingRectangle = false;
+		model->renderCommands.pushSelectionRectangle(false, 0, 0, 0, 0);
+		ReleaseCapture();
+	}
+
+	// Select what is inside the rectangle between two corners in client pixels, replacing the selection
+	void selectInRectangle(int x0, int y0, int x1, int y1) {
+		int width = view->getWindowWidth();
+		int height = view->getWindowHeight();
+		if (width <= 0 || height <= 0) return;
+
+		// Client pixels to normalized device coordinates, y grows upwards
+		glm::vec2 ndcMin(2.0f * std::min(x0, x1) / width - 1.0f, 1.0f - 2.0f * std::max(y0, y1) / height);
+		glm::vec2 ndcMax(2.0f * std::max(x0, x1) / width - 1.0f, 1.0f - 2.0f * std::min(y0, y1) / height);
+
+		// Perspective volumes end at the near and far planes, orthographic ones run through the
+		// scene like orthographic picking rays. Recorded like a click's pick ray.
+		glm::mat4 viewProjection = model->getProjectionMatrix() * model->camera.getViewMatrix();
+		bool depthLimited = model->camera.mode == PERSPECTIVE_MODE;
+		std::vector<RectangleHit> hits;
+		model->recorder.recordSelectRectangle(viewProjection, ndcMin, ndcMax, depthLimited);
+		model->findFacesInRectangle(viewProjection, ndcMin, ndcMax, depthLimited, hits);
+
+		clearAllSelections();
+		for (RectangleHit& hit : hits) {
+			if (Mesh* mesh = model->meshes.get(hit.mesh)) {
+				mesh->selectFaces(std::move(hit.faces));
+			}
+		}
+		// Commands acting on one object take the first mesh selected, no single face is picked
+		setSelection(hits.empty() ? MeshHandle() : hits.front().mesh, -1);
 	}
 
-	void selectMesh(int meshIndex) {
-	    if (meshIndex >= 0 && meshIndex < static_cast<int>(model->meshes.size())) {
-	        model->meshes[meshIndex].setSelected(true);
+	// Selection state of the controller, read back by the window procedure after every mouse button
+	// message. Clicks and rectangle selections both end here.
+	void setSelection(MeshHandle mesh, int faceIndex) {
+		selectedMesh = mesh;
+		selectedFaceIndex = faceIndex;
+	}
+
+	void selectMesh(MeshHandle meshHandle) {
+	    if (Mesh* mesh = model->meshes.get(meshHandle)) {
+	        mesh->setSelected(true);
 	    }
 	}
 	
-	void selectFace(int meshIndex, int faceIndex) {
-	    if (meshIndex >= 0 && meshIndex < static_cast<int>(model->meshes.size())) {
-	        if (faceIndex >= 0 && faceIndex < static_cast<int>(model->meshes[meshIndex].faces.size())) {
-	            model->meshes[meshIndex].selectFace(faceIndex);
+	void selectFace(MeshHandle meshHandle, int faceIndex) {
+	    if (Mesh* mesh = model->meshes.get(meshHandle)) {
+	        if (faceIndex >= 0 && faceIndex < static_cast<int>(mesh->geometry->faces.size())) {
+	            mesh->selectFace(faceIndex);
 	        }
 	    }
 	}
@@ -297,7 +441,7 @@ public:
 		ofn.hwndOwner = parentHandle; // Use parent window as owner
 		ofn.lpstrFile = filePath;
 		ofn.nMaxFile = MAX_PATH;
-		ofn.lpstrFilter = L"STL Files\0*.stl\0All Files\0*.*\0";
+		ofn.lpstrFilter = L"STL Files\0*.stl\0Mesh Cache Files\0*.cadmesh\0All Files\0*.*\0";
 		ofn.nFilterIndex = 1;
 		ofn.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST;
 
@@ -315,7 +459,12 @@ public:
 	void createFromFile() {
 		std::wstring filePath = openFileExplorer();
 		if (!filePath.empty()) {
-			model->createFromFile(filePath);
+			if (!model->createFromFile(filePath).isNull()) {
+				MessageBox(NULL, L"File loaded successfully!", L"Info", MB_OK);
+			}
+			else {
+				MessageBox(NULL, L"Failed to load the file.", L"Error", MB_OK);
+			}
 		}
 		else {
 			MessageBox(parentHandle, L"No file selected", L"Error", MB_OK);
@@ -323,10 +472,7 @@ public:
 	}
 
 	Mesh* getSelectedMesh() {
-		if (selectedMeshIndex >= 0 && selectedMeshIndex < (int)model->meshes.size()) {
-			return &model->meshes[selectedMeshIndex];
-		}
-		return nullptr;
+		return model->meshes.get(selectedMesh);
 	}
 
 	void toggleOrbitAroundObject() {
@@ -345,9 +491,9 @@ public:
 	}
 
 	void deleteSelectedObject() {
-		if (selectedMeshIndex >= 0 && selectedMeshIndex < (int)model->meshes.size()) {
-			model->deleteMesh(selectedMeshIndex);
-			selectedMeshIndex = -1; // Reset selection
+		if (model->meshes.get(selectedMesh)) {
+			model->deleteMesh(selectedMesh);
+			selectedMesh = MeshHandle(); // Reset selection
 			selectedFaceIndex = -1;
 		}
 	}
@@ -382,56 +528,13 @@ public:
 		}
 	}
 
-	// Helper method to find the intersection of a ray with the closest face
-	void findRayIntersection(const Ray& ray, int& outMeshIndex, int& outFaceIndex) {
-		outMeshIndex = -1;
-		outFaceIndex = -1;
-		
-		std::vector<Face*> hitFaces;
-		float closestDistance = std::numeric_limits<float>::max();
-		Face* closestFace = nullptr;
-		
-		// Use the spatial accelerator to efficiently get hit faces
-		if (model->accelerator) {
-		#if SPACIAL_OPT_MODE == SPACIAL_OPT_MEMORY
-			void* root = static_cast<BVH*>(model->accelerator.get())->getRoot();
-		#else
-			void* root = static_cast<KDTree*>(model->accelerator.get())->getRoot();
-		#endif
-			model->accelerator->traverse(root, ray, hitFaces);
-		}
-		
-		if (!hitFaces.empty()) {
-			// Find the closest face by computing distances
-			for (Face* face : hitFaces) {
-				// For simplicity, use the centroid of the face to determine distance
-				float dist = glm::length(face->centroid - ray.origin);
-				if (dist < closestDistance) {
-					closestDistance = dist;
-					closestFace = face;
-				}
-			}
-			
-			// Find which mesh and face index this belongs to
-			if (closestFace != nullptr) {
-				for (size_t m = 0; m < model->meshes.size(); ++m) {
-					const Mesh& mesh = model->meshes[m];
-					for (size_t f = 0; f < mesh.faces.size(); ++f) {
-						if (&mesh.faces[f] == closestFace) {
-							outMeshIndex = static_cast<int>(m);
-							outFaceIndex = static_cast<int>(f);
-							return;
-						}
-					}
-				}
-			}
-		}
-		
-		// If we didn't hit any faces or couldn't identify the mesh/face, leave outputs as -1
+	// Closest mesh and face under the ray, picking itself lives in the model
+	void findRayIntersection(const Ray& ray, MeshHandle& outMesh, int& outFaceIndex) {
+		model->findRayIntersection(ray, outMesh, outFaceIndex);
 	}
 
-	// Returns the index of the intersected mesh, or -1 if no intersection
-	int testRayIntersections(float originX, float originY, float originZ, float dirX, float dirY, float dirZ) {
+	// Returns the handle of the intersected mesh, or a null handle if no intersection
+	MeshHandle testRayIntersections(float originX, float originY, float originZ, float dirX, float dirY, float dirZ) {
 		// Set appropriate ray range based on camera mode
 		float tMin = 0.0f;
 		float tMax = std::numeric_limits<float>::max();
@@ -444,19 +547,22 @@ public:
 		
 		Ray ray(glm::vec3(originX, originY, originZ), glm::vec3(dirX, dirY, dirZ), tMin, tMax);
 
-		int meshIndex, faceIndex;
-		findRayIntersection(ray, meshIndex, faceIndex);
+		MeshHandle meshHandle;
+		int faceIndex;
+		findRayIntersection(ray, meshHandle, faceIndex);
 		
-		if (meshIndex != -1) {
+#if PICK_DEBUG_OUTPUT
+		if (!meshHandle.isNull()) {
 			std::wstringstream ss;
-			ss << L"[Picking] Intersection found: Mesh " << meshIndex;
+			ss << L"[Picking] Intersection found: Mesh " << meshHandle.index;
 			if (faceIndex != -1) {
 				ss << L", Face " << faceIndex;
 			}
 			ss << L"\n";
 			OutputDebugString(ss.str().c_str());
 		}
+#endif
 		
-		return meshIndex;
+		return meshHandle;
 	}
 };
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "Mesh.h"
+
+/*
+* Convex volume of a screen rectangle, for rectangle (marquee) selection.
+*
+* Built from a clip matrix (projection * view, times a mesh's model matrix for an object-space volume)
+* and the rectangle in normalized device coordinates. Each plane is a vec4 (normal, offset) with
+* dot(normal, p) + offset >= 0 inside; the planes are taken straight from the matrix rows and are not
+* normalized, only signs are ever compared.
+*
+* Queries carry a mask of the planes still worth testing. A box wholly inside a plane clears its bit,
+* so everything beneath it skips that plane, and a mask of zero accepts the whole subtree untested.
+*/
+
+#define FRUSTUM_PLANE_COUNT 6
+#define FRUSTUM_ALL_PLANES 0x3fu
+
+class Frustum {
+public:
+    enum Plane { PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR };
+
+    glm::vec4 planes[FRUSTUM_PLANE_COUNT];
+    unsigned int activePlanes; // Planes that bound the volume, the others are ignored
+
+    Frustum() : activePlanes(0) {}
+
+    // Volume through the rectangle [ndcMin, ndcMax] of the image of clip.
+    // Without depth limits the volume runs through the whole scene along the view direction.
+    // The near plane also rejects what is behind a perspective camera.
+    static Frustum fromRectangle(const glm::mat4& clip, const glm::vec2& ndcMin, const glm::vec2& ndcMax, bool depthLimited) {
+        glm::vec4 row0(clip[0][0], clip[1][0], clip[2][0], clip[3][0]);
+        glm::vec4 row1(clip[0][1], clip[1][1], clip[2][1], clip[3][1]);
+        glm::vec4 row2(clip[0][2], clip[1][2], clip[2][2], clip[3][2]);
+        glm::vec4 row3(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+
+        // x_clip >= ndcMin.x * w_clip and so on, w_clip > 0 inside the volume
+        Frustum frustum;
+        frustum.planes[PLANE_LEFT] = row0 - row3 * ndcMin.x;
+        frustum.planes[PLANE_RIGHT] = row3 * ndcMax.x - row0;
+        frustum.planes[PLANE_BOTTOM] = row1 - row3 * ndcMin.y;
+        frustum.planes[PLANE_TOP] = row3 * ndcMax.y - row1;
+        frustum.planes[PLANE_NEAR] = row3 + row2;
+        frustum.planes[PLANE_FAR] = row3 - row2;
+        frustum.activePlanes = depthLimited ? FRUSTUM_ALL_PLANES : (1u << PLANE_LEFT) | (1u << PLANE_RIGHT) | (1u << PLANE_BOTTOM) | (1u << PLANE_TOP);
+        return frustum;
+    }
+
+    // False if the box is wholly outside a plane in mask. Otherwise clears the bits of the planes
+    // the box is wholly inside of; a mask of zero means the box is inside the volume.
+    bool cullBox(const AABB& box, unsigned int& mask) const {
+        for (int i = 0; i < FRUSTUM_PLANE_COUNT; ++i) {
+            unsigned int bit = 1u << i;
+            if (!(mask & bit)) continue;
+            const glm::vec4& plane = planes[i];
+            // Corners furthest along and against the plane normal
+            glm::vec3 inner(plane.x >= 0.0f ? box.max.x : box.min.x,
+                            plane.y >= 0.0f ? box.max.y : box.min.y,
+                            plane.z >= 0.0f ? box.max.z : box.min.z);
+            glm::vec3 outer(plane.x >= 0.0f ? box.min.x : box.max.x,
+                            plane.y >= 0.0f ? box.min.y : box.max.y,
+                            plane.z >= 0.0f ? box.min.z : box.max.z);
+            if (glm::dot(glm::vec3(plane), inner) + plane.w < 0.0f) return false;
+            if (glm::dot(glm::vec3(plane), outer) + plane.w >= 0.0f) mask &= ~bit;
+        }
+        return true;
+    }
+
+    // Whether any part of the triangle is inside the planes in mask. Triangles straddling a plane are
+    // clipped against the planes in turn, the exact answer near the volume's edges and corners.
+    bool overlapsTriangle(const glm::vec3 (&vertices)[3], unsigned int mask) const {
+        // Fast paths: wholly outside one plane, or wholly inside all of them
+        unsigned int straddling = 0;
+        for (int i = 0; i < FRUSTUM_PLANE_COUNT; ++i) {
+            unsigned int bit = 1u << i;
+            if (!(mask & bit)) continue;
+            int inside = 0;
+            for (int v = 0; v < 3; ++v) {
+                if (distance(i, vertices[v]) >= 0.0f) inside++;
+            }
+            if (inside == 0) return false;
+            if (inside < 3) straddling |= bit;
+        }
+        if (!straddling) return true;
+
+        // Each plane adds at most one vertex to the convex polygon
+        glm::vec3 polygon[3 + FRUSTUM_PLANE_COUNT];
+        glm::vec3 clipped[3 + FRUSTUM_PLANE_COUNT];
+        int count = 3;
+        for (int v = 0; v < 3; ++v) polygon[v] = vertices[v];
+        for (int i = 0; i < FRUSTUM_PLANE_COUNT && count > 0; ++i) {
+            if (!(straddling & (1u << i))) continue;
+            int clippedCount = 0;
+            for (int v = 0; v < count; ++v) {
+                const glm::vec3& a = polygon[v];
+                const glm::vec3& b = polygon[(v + 1) % count];
+                float da = distance(i, a);
+                float db = distance(i, b);
+                if (da >= 0.0f) clipped[clippedCount++] = a;
+                if ((da >= 0.0f) != (db >= 0.0f)) clipped[clippedCount++] = a + (b - a) * (da / (da - db));
+            }
+            count = clippedCount;
+            for (int v = 0; v < count; ++v) polygon[v] = clipped[v];
+        }
+        return count > 0;
+    }
+
+private:
+    float distance(int plane, const glm::vec3& point) const {
+        return glm::dot(glm::vec3(planes[plane]), point) + planes[plane].w;
+    }
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <map>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "Mesh.h"
+
+/*
+* Cache of shared mesh geometry.
+*
+* Every primitive with the same parameters (segments, rings, radii...) has identical object-space
+* geometry, so it is generated once and every mesh created from it references the same MeshGeometry.
+* Imported files are keyed by their size and two independent 64-bit hashes of their bytes, so an
+* assembly that imports the same part a thousand times parses and stores it once, and different
+* content would need to collide in both hashes to share geometry.
+* Entries are weak: the geometry lives as long as some mesh uses it and is regenerated after the
+* last one is deleted.
+*/
+
+enum PrimitiveType {
+    PRIMITIVE_CUBE,
+    PRIMITIVE_PYRAMID,
+    PRIMITIVE_CIRCLE,
+    PRIMITIVE_CYLINDER,
+    PRIMITIVE_SPHERE,
+    PRIMITIVE_CONE,
+    PRIMITIVE_TORUS,
+    PRIMITIVE_PLANE
+};
+
+// Parameters that fully determine a primitive's geometry
+struct PrimitiveKey {
+    int type;
+    int segments;
+    int rings;
+    float size0; // Size, radius or major radius
+    float size1; // Height or minor radius
+
+    PrimitiveKey(int type, int segments, int rings, float size0, float size1)
+        : type(type), segments(segments), rings(rings), size0(size0), size1(size1) {}
+
+    bool operator<(const PrimitiveKey& other) const {
+        if (type != other.type) return type < other.type;
+        if (segments != other.segments) return segments < other.segments;
+        if (rings != other.rings) return rings < other.rings;
+        if (size0 != other.size0) return size0 < other.size0;
+        return size1 < other.size1;
+    }
+};
+
+// Identifies imported file content: byte size plus two independent 64-bit hashes of the bytes.
+// The digest confirms a hash match; the bytes of cached content are gone once it is parsed.
+struct ContentKey {
+    uint64_t size;
+    uint64_t hash;
+    uint64_t digest;
+
+    ContentKey(uint64_t size, uint64_t hash, uint64_t digest) : size(size), hash(hash), digest(digest) {}
+
+    bool operator<(const ContentKey& other) const {
+        if (size != other.size) return size < other.size;
+        if (hash != other.hash) return hash < other.hash;
+        return digest < other.digest;
+    }
+
+    // Hash eight bytes at a time: FNV-1a style over 64-bit words, and a multiply-rotate mix with
+    // other constants for the digest, both in the same pass and with a final avalanche
+    static ContentKey fromBytes(const std::vector<char>& bytes) {
+        const uint64_t prime = 0x100000001b3ull;
+        const uint64_t golden = 0x9e3779b97f4a7c15ull;
+        uint64_t hash = 0xcbf29ce484222325ull;
+        uint64_t digest = 0x6a09e667f3bcc909ull;
+
+        size_t words = bytes.size() / 8;
+        for (size_t i = 0; i < words; ++i) {
+            uint64_t word;
+            std::memcpy(&word, bytes.data() + i * 8, sizeof(word));
+            hash = (hash ^ word) * prime;
+            hash ^= hash >> 29;
+            digest = (digest + word) * golden;
+            digest = (digest << 31) | (digest >> 33);
+        }
+        for (size_t i = words * 8; i < bytes.size(); ++i) {
+            hash = (hash ^ static_cast<unsigned char>(bytes[i])) * prime;
+            digest = (digest + static_cast<unsigned char>(bytes[i])) * golden;
+        }
+
+        return ContentKey(bytes.size(), avalanche(hash, 0xff51afd7ed558ccdull), avalanche(digest, 0xc4ceb9fe1a85ec53ull));
+    }
+
+private:
+    static uint64_t avalanche(uint64_t value, uint64_t multiplier) {
+        value ^= value >> 33;
+        value *= multiplier;
+        value ^= value >> 33;
+        return value;
+    }
+};
+
+// sin/cos of (i * arc / steps) for i = 0..steps, computed once per geometry instead of per vertex
+struct SinCosTable {
+    std::vector<float> sinValues;
+    std::vector<float> cosValues;
+
+    SinCosTable(int steps, double arc) : sinValues(steps + 1), cosValues(steps + 1) {
+        for (int i = 0; i <= steps; ++i) {
+            double angle = arc * i / steps;
+            sinValues[i] = static_cast<float>(std::sin(angle));
+            cosValues[i] = static_cast<float>(std::cos(angle));
+        }
+    }
+};
+
+// Weak map from a key to the geometry built for it
+template <typename Key>
+class GeometryTable {
+private:
+    std::map<Key, std::weak_ptr<MeshGeometry>> entries;
+    size_t purgeThreshold = 16;
+
+    // Drop entries whose geometry has been released. Runs only when the table has doubled since
+    // the last purge, so importing many unique parts stays linear overall.
+    void purge() {
+        if (entries.size() < purgeThreshold) return;
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.expired()) it = entries.erase(it);
+            else ++it;
+        }
+        purgeThreshold = std::max<size_t>(16, entries.size() * 2);
+    }
+
+public:
+    // Return the cached geometry for the key, or generate it with generate() and cache it.
+    // A generator returning nullptr (e.g. a failed import) caches nothing.
+    template <typename Generator>
+    std::shared_ptr<MeshGeometry> acquire(const Key& key, Generator generate) {
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            if (std::shared_ptr<MeshGeometry> geometry = it->second.lock()) {
+                return geometry;
+            }
+        }
+
+        purge();
+        std::shared_ptr<MeshGeometry> geometry = generate();
+        if (geometry) {
+            entries[key] = geometry;
+        }
+        return geometry;
+    }
+
+    // Cached geometry for the key, or nullptr
+    std::shared_ptr<MeshGeometry> find(const Key& key) const {
+        auto it = entries.find(key);
+        return it != entries.end() ? it->second.lock() : nullptr;
+    }
+
+    // Number of cached keys (live or not yet purged)
+    size_t size() const {
+        return entries.size();
+    }
+};
+
+class GeometryCache {
+private:
+    GeometryTable<PrimitiveKey> primitives; // Generated primitives by parameter set
+    GeometryTable<ContentKey> imports;      // Imported files by content
+
+public:
+    template <typename Generator>
+    std::shared_ptr<MeshGeometry> acquire(const PrimitiveKey& key, Generator generate) {
+        return primitives.acquire(key, generate);
+    }
+
+    template <typename Generator>
+    std::shared_ptr<MeshGeometry> acquire(const ContentKey& key, Generator generate) {
+        return imports.acquire(key, generate);
+    }
+
+    std::shared_ptr<MeshGeometry> find(const PrimitiveKey& key) const {
+        return primitives.find(key);
+    }
+
+    std::shared_ptr<MeshGeometry> find(const ContentKey& key) const {
+        return imports.find(key);
+    }
+
+    size_t size() const {
+        return primitives.size() + imports.size();
+    }
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <GL/gl.h>
 #include "camera.h"
+#include "profiler.h"
 
 class Grid {
 public:
@@ -11,6 +12,7 @@ public:
 
 	// Draws a grid on the XZ plane
 	void drawXZGrid() {
+        PROFILE_SCOPE("render.grid");
         glDisable(GL_LIGHTING);
         glColor3f(0.7f, 0.7f, 0.7f);
         glLineWidth(1.0f);
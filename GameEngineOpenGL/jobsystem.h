@@ -0,0 +1,390 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include "tracerecorder.h"
+
+/*
+* Engine-wide job system.
+*
+* One pool of worker threads shared by every parallel feature (import, accelerator builds, vertex
+* transforms, ray queries), so features running at the same time never oversubscribe the cores.
+*
+* Each worker owns a deque. Jobs submitted from a worker go to the back of its own deque and the
+* worker pops from the back (newest first, still warm in cache). A worker with an empty deque takes
+* jobs submitted from outside the pool, then steals from the front of the other workers' deques
+* (oldest first, usually the largest remaining piece of work).
+*
+* A job may depend on other jobs, it is queued once all of them have finished. Threads waiting on
+* a job run queued jobs in the meantime, so waiting inside a job cannot starve the pool.
+*
+* An exception thrown by a job is caught on the thread that ran it and stored with the job, which
+* still counts as finished (its dependents run). wait() rethrows it; parallelFor() rethrows the first
+* exception of its pieces on the caller once every participant has stopped.
+*
+* Work that must happen on the UI thread (touching Model, showing dialogs) is posted to the main
+* thread queue and run by runMainThreadTasks(), which the UI thread calls from its message loop.
+*/
+
+class Job {
+public:
+    bool isFinished() const {
+        return finished.load(std::memory_order_acquire);
+    }
+
+private:
+    friend class JobSystem;
+
+    std::function<void()> work;
+    std::atomic<int> unmetDependencies;           // Queued when this reaches 0
+    std::atomic<bool> finished;
+    std::exception_ptr error;                     // Written before finished is set
+    std::mutex continuationMutex;
+    std::vector<std::shared_ptr<Job>> continuations; // Jobs waiting for this one
+
+    explicit Job(std::function<void()> work) : work(std::move(work)), unmetDependencies(1), finished(false) {}
+};
+
+// Jobs are reference counted, a handle keeps the job alive for whoever waits on it
+typedef std::shared_ptr<Job> JobHandle;
+
+class JobSystem {
+public:
+    // The shared pool. Workers start on first use.
+    static JobSystem& instance() {
+        static JobSystem system;
+        return system;
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    size_t workerCount() const {
+        return workers.size();
+    }
+
+    // *** Jobs ***
+
+    JobHandle submit(std::function<void()> work) {
+        return submit(std::move(work), std::vector<JobHandle>());
+    }
+
+    // Run work after every job in dependencies has finished
+    JobHandle submit(std::function<void()> work, const std::vector<JobHandle>& dependencies) {
+        JobHandle job(new Job(std::move(work)));
+        for (const JobHandle& dependency : dependencies) {
+            if (!dependency) continue;
+            std::lock_guard<std::mutex> lock(dependency->continuationMutex);
+            if (!dependency->isFinished()) {
+                job->unmetDependencies.fetch_add(1, std::memory_order_relaxed);
+                dependency->continuations.push_back(job);
+            }
+        }
+        // Drop the reference held during registration, the job is queued if nothing is pending
+        release(job);
+        return job;
+    }
+
+    // Block until the job has finished, running other queued jobs in the meantime.
+    // Rethrows the exception the job threw, if any.
+    void wait(const JobHandle& job) {
+        if (!job) return;
+        while (!job->isFinished()) {
+            if (runOne()) continue;
+
+            // Nothing to help with, the job is running elsewhere
+            waiters.fetch_add(1);
+            {
+                std::unique_lock<std::mutex> lock(doneMutex);
+                done.wait_for(lock, std::chrono::milliseconds(1), [&]() {
+                    return job->isFinished() || queuedJobs.load() > 0;
+                });
+            }
+            waiters.fetch_sub(1);
+        }
+        if (job->error) std::rethrow_exception(job->error);
+    }
+
+    // Waits for every job before rethrowing the first exception among them
+    void wait(const std::vector<JobHandle>& jobs) {
+        std::exception_ptr error;
+        for (const JobHandle& job : jobs) {
+            try {
+                wait(job);
+            }
+            catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+    }
+
+    // *** Data parallel helpers ***
+
+    // Call body(rangeBegin, rangeEnd) over [begin, end) in pieces of at most grainSize items.
+    // The calling thread takes part and the call returns once every piece is done.
+    // Pieces are handed out from a shared counter, so uneven pieces balance themselves.
+    // If body throws, no further pieces start and the first exception is rethrown here once the
+    // pieces already running have returned.
+    template <typename Body>
+    void parallelFor(size_t begin, size_t end, size_t grainSize, const Body& body) {
+        if (end <= begin) return;
+        grainSize = std::max<size_t>(1, grainSize);
+        size_t pieceCount = (end - begin + grainSize - 1) / grainSize;
+        if (pieceCount == 1 || workers.empty()) {
+            body(begin, end);
+            return;
+        }
+
+        std::atomic<size_t> nextPiece(0);
+        std::mutex errorMutex;
+        std::exception_ptr error;
+        auto runPieces = [&]() {
+            try {
+                for (size_t piece = nextPiece.fetch_add(1); piece < pieceCount; piece = nextPiece.fetch_add(1)) {
+                    size_t rangeBegin = begin + piece * grainSize;
+                    body(rangeBegin, std::min(end, rangeBegin + grainSize));
+                }
+            }
+            catch (...) {
+                // The other participants find no piece left and stop
+                nextPiece.store(pieceCount);
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) error = std::current_exception();
+            }
+        };
+
+        // One helper per worker at most, the caller is the last participant
+        size_t helperCount = std::min(pieceCount - 1, workers.size());
+        std::vector<JobHandle> helpers;
+        helpers.reserve(helperCount);
+        for (size_t i = 0; i < helperCount; ++i) {
+            helpers.push_back(submit(runPieces));
+        }
+        runPieces();
+        wait(helpers); // The helpers use this frame, even when a piece failed
+        if (error) std::rethrow_exception(error);
+    }
+
+    // Map every piece of [begin, end) to a value with map(rangeBegin, rangeEnd) and fold the values
+    // with combine. Values are combined in range order, so the result does not depend on scheduling.
+    template <typename T, typename Map, typename Combine>
+    T parallelReduce(size_t begin, size_t end, size_t grainSize, const T& identity, const Map& map, const Combine& combine) {
+        if (end <= begin) return identity;
+        grainSize = std::max<size_t>(1, grainSize);
+        size_t pieceCount = (end - begin + grainSize - 1) / grainSize;
+
+        std::vector<T> partial(pieceCount, identity);
+        parallelFor(0, pieceCount, 1, [&](size_t firstPiece, size_t lastPiece) {
+            for (size_t piece = firstPiece; piece < lastPiece; ++piece) {
+                size_t rangeBegin = begin + piece * grainSize;
+                partial[piece] = map(rangeBegin, std::min(end, rangeBegin + grainSize));
+            }
+        });
+
+        T result = identity;
+        for (const T& value : partial) {
+            result = combine(result, value);
+        }
+        return result;
+    }
+
+    // *** Main thread continuations ***
+
+    // Called whenever a main thread task is posted, e.g. to post a window message that makes the
+    // UI thread call runMainThreadTasks(). Set once at startup.
+    void setMainThreadWakeup(std::function<void()> wakeup) {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        mainThreadWakeup = std::move(wakeup);
+    }
+
+    void postToMainThread(std::function<void()> task) {
+        std::function<void()> wakeup;
+        {
+            std::lock_guard<std::mutex> lock(mainMutex);
+            mainThreadTasks.push_back(std::move(task));
+            wakeup = mainThreadWakeup;
+        }
+        if (wakeup) wakeup();
+    }
+
+    // Run task on the main thread once the job has finished
+    JobHandle continueOnMainThread(const JobHandle& after, std::function<void()> task) {
+        return submit([this, task]() { postToMainThread(task); }, std::vector<JobHandle>(1, after));
+    }
+
+    // Run every posted main thread task, returns how many ran. UI thread only.
+    size_t runMainThreadTasks() {
+        std::vector<std::function<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> lock(mainMutex);
+            tasks.swap(mainThreadTasks);
+        }
+        for (std::function<void()>& task : tasks) {
+            task();
+        }
+        return tasks.size();
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues; // One per worker, the last one takes outside submissions
+    std::atomic<size_t> queuedJobs;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;  // Idle workers sleep here
+    bool stopping;
+
+    std::mutex doneMutex;
+    std::condition_variable done;  // Threads in wait() with nothing to run sleep here
+    std::atomic<int> waiters;
+
+    std::mutex mainMutex;
+    std::vector<std::function<void()>> mainThreadTasks;
+    std::function<void()> mainThreadWakeup;
+
+    // The UI and render threads keep running, so one core is left to them
+    JobSystem() : queuedJobs(0), stopping(false), waiters(0) {
+        unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        size_t count = hardwareThreads > 2 ? hardwareThreads - 1 : 1;
+
+        for (size_t i = 0; i <= count; ++i) {
+            queues.emplace_back(new WorkQueue());
+        }
+        workers.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            workers.emplace_back(&JobSystem::workerLoop, this, static_cast<int>(i));
+        }
+    }
+
+    // Index of the worker running on this thread, -1 outside the pool
+    static int& currentWorker() {
+        thread_local int index = -1;
+        return index;
+    }
+
+    void workerLoop(int index) {
+        currentWorker() = index;
+        TRACE_THREAD_NAME("Worker " + std::to_string(index));
+        for (;;) {
+            if (runOne()) continue;
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this]() { return stopping || queuedJobs.load() > 0; });
+            if (stopping) return;
+        }
+    }
+
+    void release(const JobHandle& job) {
+        if (job->unmetDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            enqueue(job);
+        }
+    }
+
+    void enqueue(const JobHandle& job) {
+        int index = currentWorker();
+        WorkQueue& queue = *queues[index >= 0 ? index : queues.size() - 1];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(job);
+        }
+        queuedJobs.fetch_add(1);
+        {
+            // Taking the lock orders this notify after a worker's predicate check
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+        if (waiters.load() > 0) {
+            done.notify_all();
+        }
+    }
+
+    bool popBack(WorkQueue& queue, JobHandle& job) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) return false;
+        job = std::move(queue.jobs.back());
+        queue.jobs.pop_back();
+        return true;
+    }
+
+    bool popFront(WorkQueue& queue, JobHandle& job) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) return false;
+        job = std::move(queue.jobs.front());
+        queue.jobs.pop_front();
+        return true;
+    }
+
+    // Own deque first, then outside submissions, then steal from the other workers
+    bool findJob(JobHandle& job) {
+        if (queuedJobs.load() == 0) return false;
+
+        int index = currentWorker();
+        size_t queueCount = queues.size();
+        if (index >= 0 && popBack(*queues[index], job)) return true;
+        if (popFront(*queues[queueCount - 1], job)) return true;
+
+        size_t start = index >= 0 ? static_cast<size_t>(index) + 1 : 0;
+        for (size_t i = 0; i < queueCount - 1; ++i) {
+            size_t victim = (start + i) % (queueCount - 1);
+            if (static_cast<int>(victim) != index && popFront(*queues[victim], job)) return true;
+        }
+        return false;
+    }
+
+    bool runOne() {
+        JobHandle job;
+        if (!findJob(job)) return false;
+        queuedJobs.fetch_sub(1);
+
+        try {
+            TRACE_SCOPE("job");
+            job->work();
+        }
+        catch (...) {
+            job->error = std::current_exception();
+        }
+        job->work = nullptr; // Release captures now, handles may outlive the job by a lot
+
+        std::vector<JobHandle> continuations;
+        {
+            std::lock_guard<std::mutex> lock(job->continuationMutex);
+            job->finished.store(true, std::memory_order_release);
+            continuations.swap(job->continuations);
+        }
+        for (const JobHandle& continuation : continuations) {
+            release(continuation);
+        }
+        if (waiters.load() > 0) {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            done.notify_all();
+        }
+        return true;
+    }
+};
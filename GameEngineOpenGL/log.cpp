@@ -0,0 +1,29 @@
+#include "log.h"
+#include <atomic>
+#include <iostream>
+
+namespace {
+    std::atomic<LogHandler> logHandler(nullptr);
+}
+
+void setLogHandler(LogHandler handler) {
+    logHandler.store(handler);
+}
+
+void logMessage(LogLevel level, const std::string& message) {
+    LogHandler handler = logHandler.load();
+    if (handler) {
+        handler(level, message);
+        return;
+    }
+    std::cerr << "[" << logLevelName(level) << "] " << message << std::endl;
+}
+
+const char* logLevelName(LogLevel level) {
+    switch (level) {
+        case LOG_DEBUG: return "debug";
+        case LOG_INFO: return "info";
+        case LOG_WARNING: return "warning";
+        default: return "error";
+    }
+}
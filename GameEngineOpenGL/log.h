@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+// Diagnostics from the core library. The core never talks to a console or a window itself:
+// messages go to the installed handler, which the app routes to its debugger output and batch
+// tools to stderr. Without a handler messages are written to stderr.
+
+enum LogLevel {
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARNING,
+    LOG_ERROR
+};
+
+typedef void (*LogHandler)(LogLevel level, const std::string& message);
+
+// Install the handler for every thread, nullptr restores the default. Set once at startup.
+void setLogHandler(LogHandler handler);
+
+void logMessage(LogLevel level, const std::string& message);
+
+const char* logLevelName(LogLevel level);
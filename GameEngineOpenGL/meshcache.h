@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "log.h"
+#include "Mesh.h"
+
+/*
+* Native mesh cache format (.cadmesh), written by the meshbake tool and opened by the editor.
+*
+* A baked file holds welded, cleaned geometry ready to be used as is: the editor reads the arrays
+* straight into MeshGeometry without parsing text or re-welding. Accelerators are pointer trees and
+* are rebuilt on load, that is a fraction of the STL parse it replaces.
+*
+* Layout, little endian:
+*   header   MeshCacheHeader (56 bytes)
+*   vertices vertexCount * 3 floats
+*   colors   vertexCount * 3 floats, only with MESH_CACHE_HAS_COLORS
+*   indices  indexCount uint32
+*/
+
+static const char MESH_CACHE_MAGIC[8] = { 'C', 'A', 'D', 'M', 'E', 'S', 'H', '\0' };
+static const uint32_t MESH_CACHE_VERSION = 1;
+static const uint32_t MESH_CACHE_HAS_COLORS = 1u << 0; // Without it the importer's color is used
+static const char* const MESH_CACHE_EXTENSION = ".cadmesh";
+
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+static_assert(sizeof(MeshCacheHeader) == 56, "Mesh cache header layout changed");
+static_assert(sizeof(unsigned int) == sizeof(uint32_t), "Indices are stored as uint32");
+
+class MeshCache {
+public:
+    static bool isCacheFile(const std::vector<char>& bytes) {
+        return bytes.size() >= sizeof(MeshCacheHeader) && std::memcmp(bytes.data(), MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0;
+    }
+
+    static bool write(const std::string& filePath, const MeshGeometry& geometry) {
+        MeshCacheHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+        header.version = MESH_CACHE_VERSION;
+        header.flags = geometry.colors.size() == geometry.vertices.size() && !geometry.colors.empty() ? MESH_CACHE_HAS_COLORS : 0;
+        header.vertexCount = geometry.vertices.size() / 3;
+        header.indexCount = geometry.indices.size();
+        for (int axis = 0; axis < 3; ++axis) {
+            header.boundsMin[axis] = geometry.bounds.min[axis];
+            header.boundsMax[axis] = geometry.bounds.max[axis];
+        }
+
+        std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            logMessage(LOG_ERROR, "Failed to create mesh cache file: " + filePath);
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeArray(file, geometry.vertices);
+        if (header.flags & MESH_CACHE_HAS_COLORS) {
+            writeArray(file, geometry.colors);
+        }
+        writeArray(file, geometry.indices);
+        return static_cast<bool>(file);
+    }
+
+    // Same contract as Mesh::parseSTL: fills the buffers, colors default to color
+    static bool parse(const std::vector<char>& bytes, const glm::vec3& color,
+                      std::vector<float>& vertices, std::vector<float>& colors, std::vector<unsigned int>& indices) {
+        if (!isCacheFile(bytes)) return false;
+
+        MeshCacheHeader header;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        if (header.version != MESH_CACHE_VERSION) {
+            logMessage(LOG_ERROR, "Unsupported mesh cache version " + std::to_string(header.version));
+            return false;
+        }
+
+        // Validate sizes before allocating anything
+        bool hasColors = (header.flags & MESH_CACHE_HAS_COLORS) != 0;
+        uint64_t available = bytes.size() - sizeof(header);
+        uint64_t floatCount = header.vertexCount * 3;
+        if (header.vertexCount > available / (sizeof(float) * 3) ||
+            header.indexCount > available / sizeof(uint32_t) ||
+            floatCount * sizeof(float) * (hasColors ? 2 : 1) + header.indexCount * sizeof(uint32_t) != available) {
+            logMessage(LOG_ERROR, "Mesh cache file is truncated or corrupt");
+            return false;
+        }
+
+        const char* cursor = bytes.data() + sizeof(header);
+        vertices.resize(static_cast<size_t>(floatCount));
+        cursor = readArray(cursor, vertices);
+        if (hasColors) {
+            colors.resize(static_cast<size_t>(floatCount));
+            cursor = readArray(cursor, colors);
+        }
+        else {
+            colors.resize(static_cast<size_t>(floatCount));
+            for (size_t i = 0; i + 2 < colors.size(); i += 3) {
+                colors[i] = color.x;
+                colors[i + 1] = color.y;
+                colors[i + 2] = color.z;
+            }
+        }
+        indices.resize(static_cast<size_t>(header.indexCount));
+        readArray(cursor, indices);
+
+        for (unsigned int index : indices) {
+            if (index >= header.vertexCount) {
+                logMessage(LOG_ERROR, "Mesh cache file has an index out of range");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Replace the extension of a source path, "parts/bracket.stl" -> "parts/bracket.cadmesh"
+    static std::string cachePathFor(const std::string& sourcePath) {
+        size_t slash = sourcePath.find_last_of("/\\");
+        size_t dot = sourcePath.find_last_of('.');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+            return sourcePath + MESH_CACHE_EXTENSION;
+        }
+        return sourcePath.substr(0, dot) + MESH_CACHE_EXTENSION;
+    }
+
+private:
+    template <typename T>
+    static void writeArray(std::ofstream& file, const std::vector<T>& values) {
+        if (!values.empty()) {
+            file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        }
+    }
+
+    template <typename T>
+    static const char* readArray(const char* cursor, std::vector<T>& values) {
+        if (!values.empty()) {
+            std::memcpy(values.data(), cursor, values.size() * sizeof(T));
+        }
+        return cursor + values.size() * sizeof(T);
+    }
+};
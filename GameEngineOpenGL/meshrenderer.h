@@ -0,0 +1,420 @@
+#pragma once
+
+#include <GL/gl.h>
+#include <GL/glu.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "Mesh.h"
+#include "spacialaccelerator.h"
+
+// Immediate mode OpenGL drawing of the core scene types. Mesh and the accelerators hold no GL code,
+// so the geometry core builds without a GL context; only the app renders.
+class MeshRenderer {
+public:
+    // Render the mesh
+    static void draw(const Mesh& mesh) {
+        // Skip rendering if not visible
+        if (!mesh.isVisible) return;
+        PROFILE_COUNT("render.meshes", 1); // Timed once per frame as render.mesh_pass, not per mesh
+
+        const std::vector<Face>& faces = mesh.geometry->faces;
+        const std::vector<unsigned int>& indices = mesh.geometry->indices;
+        PROFILE_COUNT("render.triangles", indices.size() / 3);
+
+        // Safety check for face highlighting
+        bool canHighlightFace = mesh.isSelected &&
+            mesh.selectedFaceIndex >= 0 &&
+            mesh.selectedFaceIndex < static_cast<int>(faces.size()) &&
+            mesh.selectedFaceIndex * 3 + 2 < indices.size();
+
+        // Vertices stay in object space, the model matrix places them
+        glPushMatrix();
+        glMultMatrixf(glm::value_ptr(mesh.modelMatrix));
+
+        // Enable vertex and color arrays
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 0, mesh.geometry->vertices.data());
+        
+        if (mesh.useBaseColor || mesh.geometry->colors.empty()) {
+            glColor3f(mesh.colorR, mesh.colorG, mesh.colorB);
+        }
+        else {
+            glEnableClientState(GL_COLOR_ARRAY);
+            glColorPointer(3, GL_FLOAT, 0, mesh.geometry->colors.data());
+        }
+
+        // Setup mesh.transparency if enabled
+        if (mesh.isTransparent) {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glColor4f(mesh.colorR, mesh.colorG, mesh.colorB, 1.0f - mesh.transparency);
+        }
+
+        // Enable wireframe mode if requested
+        if (mesh.wireframeMode) {
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        }
+
+        // Draw with appropriate highlight method
+        if (mesh.isSelected) {
+            // Highlight the faces of a rectangle selection over the mesh
+            if (mesh.faceSelection) {
+                glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, indices.data());
+
+                const std::vector<unsigned int>& selectedIndices = mesh.faceSelection->indices;
+                glDisableClientState(GL_COLOR_ARRAY);
+                glDepthFunc(GL_LEQUAL);
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                glColor4f(1.0f, 0.5f, 0.0f, 0.7f); // Orange highlight, as a selected face
+                glDrawElements(GL_TRIANGLES, selectedIndices.size(), GL_UNSIGNED_INT, selectedIndices.data());
+                glDisable(GL_BLEND);
+                glDepthFunc(GL_LESS);
+            }
+            // Highlight entire mesh if no specific face is selected
+            else if (!canHighlightFace) {
+                // Draw mesh with normal colors
+                glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, indices.data());
+
+                // Draw wireframe highlight overlay
+                glDisableClientState(GL_COLOR_ARRAY);
+                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+                glLineWidth(2.0f);
+                glColor3f(1.0f, 1.0f, 0.0f); // Yellow highlight
+                glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, indices.data());
+                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+                glLineWidth(1.0f);
+            }
+            // Highlight specific triangle
+            else {
+                // Draw non-selected triangles normally
+                for (int i = 0; i < static_cast<int>(faces.size()); ++i) {
+                    if (i != mesh.selectedFaceIndex && i * 3 + 2 < indices.size()) {
+                        glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, &indices[i * 3]);
+                    }
+                }
+
+                // Draw the selected triangle with highlight
+                glDisableClientState(GL_COLOR_ARRAY);
+                
+                // Fill with semi-transparent highlight
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                glColor4f(1.0f, 0.5f, 0.0f, 0.7f); // Orange highlight
+                glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, &indices[mesh.selectedFaceIndex * 3]);
+
+                // Draw outline
+                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+                glLineWidth(3.0f);
+                glColor3f(1.0f, 0.8f, 0.0f); // Yellow-orange outline
+                glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, &indices[mesh.selectedFaceIndex * 3]);
+                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+                glLineWidth(1.0f);
+                glDisable(GL_BLEND);
+            }
+        }
+        else {
+            // Draw normally without highlighting
+            glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, indices.data());
+        }
+
+        // Restore render states
+        if (mesh.isTransparent) {
+            glDisable(GL_BLEND);
+        }
+
+        if (mesh.wireframeMode) {
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        }
+
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glPopMatrix();
+
+        // Draw additional visualizations if enabled
+        if (mesh.showBoundingBox) {
+            drawBoundingBox(mesh);
+        }
+
+        if (mesh.showVertices) {
+            drawVertices(mesh);
+        }
+    }
+
+    // Draw local coordinate axes
+    static void drawLocalAxis(const Mesh& mesh) {
+        if (mesh.geometry->empty() || !mesh.isVisible) return;
+        
+        // Draw the axes
+        glBegin(GL_LINES);
+
+        // X-axis (red)
+        glColor3f(1.0f, 0.0f, 0.0f);
+        glVertex3f(mesh.centerX, mesh.centerY, mesh.centerZ);
+        glVertex3f(mesh.centerX + 2.0f, mesh.centerY, mesh.centerZ);
+
+        // Y-axis (green)
+        glColor3f(0.0f, 1.0f, 0.0f);
+        glVertex3f(mesh.centerX, mesh.centerY, mesh.centerZ);
+        glVertex3f(mesh.centerX, mesh.centerY + 2.0f, mesh.centerZ);
+
+        // Z-axis (blue)
+        glColor3f(0.0f, 0.0f, 1.0f);
+        glVertex3f(mesh.centerX, mesh.centerY, mesh.centerZ);
+        glVertex3f(mesh.centerX, mesh.centerY, mesh.centerZ + 2.0f);
+
+        glEnd();
+    }
+    
+    // Hover pre-selection: thin outline of the mesh under the cursor and a light fill of the face.
+    // Drawn over the already rendered mesh, GL_LEQUAL lets the overlay pass the equal depth.
+    static void drawHover(const Mesh& mesh, int faceIndex) {
+        if (mesh.geometry->empty() || !mesh.isVisible) return;
+        const std::vector<unsigned int>& indices = mesh.geometry->indices;
+
+        glPushMatrix();
+        glMultMatrixf(glm::value_ptr(mesh.modelMatrix));
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 0, mesh.geometry->vertices.data());
+        glDepthFunc(GL_LEQUAL);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        // Outline the whole mesh
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        glColor4f(0.4f, 0.8f, 1.0f, 0.6f); // Light blue
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, indices.data());
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+        // Fill the face under the cursor
+        if (faceIndex >= 0 && faceIndex * 3 + 2 < static_cast<int>(indices.size())) {
+            glColor4f(0.0f, 1.0f, 1.0f, 0.4f); // Cyan
+            glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, &indices[faceIndex * 3]);
+        }
+
+        glDisable(GL_BLEND);
+        glDepthFunc(GL_LESS);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glPopMatrix();
+    }
+
+    // Draw the bounding box (using OBB corners)
+    static void drawBoundingBox(const Mesh& mesh) {
+        if (mesh.geometry->empty() || !mesh.isVisible) return;
+
+        // Draw using the OBB corners for accurate visualization
+        glColor3f(1.0f, 1.0f, 0.0f); // Yellow color
+        glBegin(GL_LINES);
+
+        // Bottom face
+        glVertex3f(mesh.obbCorners[0].x, mesh.obbCorners[0].y, mesh.obbCorners[0].z);
+        glVertex3f(mesh.obbCorners[1].x, mesh.obbCorners[1].y, mesh.obbCorners[1].z);
+
+        glVertex3f(mesh.obbCorners[1].x, mesh.obbCorners[1].y, mesh.obbCorners[1].z);
+        glVertex3f(mesh.obbCorners[2].x, mesh.obbCorners[2].y, mesh.obbCorners[2].z);
+
+        glVertex3f(mesh.obbCorners[2].x, mesh.obbCorners[2].y, mesh.obbCorners[2].z);
+        glVertex3f(mesh.obbCorners[3].x, mesh.obbCorners[3].y, mesh.obbCorners[3].z);
+
+        glVertex3f(mesh.obbCorners[3].x, mesh.obbCorners[3].y, mesh.obbCorners[3].z);
+        glVertex3f(mesh.obbCorners[0].x, mesh.obbCorners[0].y, mesh.obbCorners[0].z);
+
+        // Top face
+        glVertex3f(mesh.obbCorners[4].x, mesh.obbCorners[4].y, mesh.obbCorners[4].z);
+        glVertex3f(mesh.obbCorners[5].x, mesh.obbCorners[5].y, mesh.obbCorners[5].z);
+
+        glVertex3f(mesh.obbCorners[5].x, mesh.obbCorners[5].y, mesh.obbCorners[5].z);
+        glVertex3f(mesh.obbCorners[6].x, mesh.obbCorners[6].y, mesh.obbCorners[6].z);
+
+        glVertex3f(mesh.obbCorners[6].x, mesh.obbCorners[6].y, mesh.obbCorners[6].z);
+        glVertex3f(mesh.obbCorners[7].x, mesh.obbCorners[7].y, mesh.obbCorners[7].z);
+
+        glVertex3f(mesh.obbCorners[7].x, mesh.obbCorners[7].y, mesh.obbCorners[7].z);
+        glVertex3f(mesh.obbCorners[4].x, mesh.obbCorners[4].y, mesh.obbCorners[4].z);
+
+        // Vertical edges
+        glVertex3f(mesh.obbCorners[0].x, mesh.obbCorners[0].y, mesh.obbCorners[0].z);
+        glVertex3f(mesh.obbCorners[4].x, mesh.obbCorners[4].y, mesh.obbCorners[4].z);
+
+        glVertex3f(mesh.obbCorners[1].x, mesh.obbCorners[1].y, mesh.obbCorners[1].z);
+        glVertex3f(mesh.obbCorners[5].x, mesh.obbCorners[5].y, mesh.obbCorners[5].z);
+
+        glVertex3f(mesh.obbCorners[2].x, mesh.obbCorners[2].y, mesh.obbCorners[2].z);
+        glVertex3f(mesh.obbCorners[6].x, mesh.obbCorners[6].y, mesh.obbCorners[6].z);
+
+        glVertex3f(mesh.obbCorners[3].x, mesh.obbCorners[3].y, mesh.obbCorners[3].z);
+        glVertex3f(mesh.obbCorners[7].x, mesh.obbCorners[7].y, mesh.obbCorners[7].z);
+
+        glEnd();
+    }
+    
+    // Draw points at each vertex
+    static void drawVertices(const Mesh& mesh) {
+        if (mesh.geometry->empty() || !mesh.isVisible) return;
+
+        const std::vector<GLfloat>& vertices = mesh.geometry->vertices;
+
+        glPushMatrix();
+        glMultMatrixf(glm::value_ptr(mesh.modelMatrix));
+        glPointSize(5.0f);
+        glBegin(GL_POINTS);
+        glColor3f(0.0f, 0.0f, 0.0f); // Black dots
+
+        for (size_t i = 0; i < vertices.size(); i += 3) {
+            glVertex3f(vertices[i], vertices[i + 1], vertices[i + 2]);
+        }
+
+        glEnd();
+        glPopMatrix();
+    }
+
+    // Draw the node boxes of an accelerator (BVH in green, KD-tree in blue with red split planes, LBVH in orange)
+    static void drawAccelerator(const SpatialAccelerator& accelerator) {
+        if (const BVH* bvh = dynamic_cast<const BVH*>(&accelerator)) {
+            drawBVHNode(bvh->getRoot());
+        }
+        else if (const KDTree* kdTree = dynamic_cast<const KDTree*>(&accelerator)) {
+            drawKDTreeNode(kdTree->getRoot());
+        }
+        else if (const LBVH* lbvh = dynamic_cast<const LBVH*>(&accelerator)) {
+            drawLBVHNodes(lbvh->getNodes());
+        }
+    }
+
+private:
+    static void drawBVHNode(const BVH::BVHNode* node) {
+        if (!node) return;
+
+        // Draw the bounding box of the current node
+        const glm::vec3& min = node->boundingBox.min;
+        const glm::vec3& max = node->boundingBox.max;
+
+        glColor3f(0.0f, 1.0f, 0.0f); // Green color for bounding boxes
+        glBegin(GL_LINES);
+
+        // Bottom face
+        glVertex3f(min.x, min.y, min.z); glVertex3f(max.x, min.y, min.z);
+        glVertex3f(max.x, min.y, min.z); glVertex3f(max.x, min.y, max.z);
+        glVertex3f(max.x, min.y, max.z); glVertex3f(min.x, min.y, max.z);
+        glVertex3f(min.x, min.y, max.z); glVertex3f(min.x, min.y, min.z);
+
+        // Top face
+        glVertex3f(min.x, max.y, min.z); glVertex3f(max.x, max.y, min.z);
+        glVertex3f(max.x, max.y, min.z); glVertex3f(max.x, max.y, max.z);
+        glVertex3f(max.x, max.y, max.z); glVertex3f(min.x, max.y, max.z);
+        glVertex3f(min.x, max.y, max.z); glVertex3f(min.x, max.y, min.z);
+
+        // Vertical edges
+        glVertex3f(min.x, min.y, min.z); glVertex3f(min.x, max.y, min.z);
+        glVertex3f(max.x, min.y, min.z); glVertex3f(max.x, max.y, min.z);
+        glVertex3f(max.x, min.y, max.z); glVertex3f(max.x, max.y, max.z);
+        glVertex3f(min.x, min.y, max.z); glVertex3f(min.x, max.y, max.z);
+
+        glEnd();
+
+        // Recursively draw child nodes if they exist
+        drawBVHNode(node->left);
+        drawBVHNode(node->right);
+    }
+
+    static void drawKDTreeNode(const KDTree::KDTreeNode* node) {
+        if (!node) return;
+        
+        // Safety check for invalid or uninitialized bounding boxes
+        if (glm::any(glm::isnan(node->boundingBox.min)) ||
+            glm::any(glm::isnan(node->boundingBox.max)) ||
+            glm::any(glm::isinf(node->boundingBox.min)) ||
+            glm::any(glm::isinf(node->boundingBox.max))) {
+            return;
+        }
+        
+        // Draw the bounding box
+        const glm::vec3& min = node->boundingBox.min;
+        const glm::vec3& max = node->boundingBox.max;
+        
+        glColor3f(0.0f, 0.0f, 1.0f); // Blue color for KD-Tree
+        glBegin(GL_LINES);
+        
+        // Bottom face
+        glVertex3f(min.x, min.y, min.z); glVertex3f(max.x, min.y, min.z);
+        glVertex3f(max.x, min.y, min.z); glVertex3f(max.x, min.y, max.z);
+        glVertex3f(max.x, min.y, max.z); glVertex3f(min.x, min.y, max.z);
+        glVertex3f(min.x, min.y, max.z); glVertex3f(min.x, min.y, min.z);
+        
+        // Top face
+        glVertex3f(min.x, max.y, min.z); glVertex3f(max.x, max.y, min.z);
+        glVertex3f(max.x, max.y, min.z); glVertex3f(max.x, max.y, max.z);
+        glVertex3f(max.x, max.y, max.z); glVertex3f(min.x, max.y, max.z);
+        glVertex3f(min.x, max.y, max.z); glVertex3f(min.x, max.y, min.z);
+
+        // Vertical edges
+        glVertex3f(min.x, min.y, min.z); glVertex3f(min.x, max.y, min.z);
+        glVertex3f(max.x, min.y, min.z); glVertex3f(max.x, max.y, min.z);
+        glVertex3f(max.x, min.y, max.z); glVertex3f(max.x, max.y, max.z);
+        glVertex3f(min.x, min.y, max.z); glVertex3f(min.x, max.y, max.z);
+
+        glEnd();
+        
+        // Draw the splitting plane if not a leaf
+        if (!node->isLeaf && node->splitAxis >= 0 && node->splitAxis <= 2) {
+            glColor3f(1.0f, 0.0f, 0.0f); // Red color for splitting planes
+            glBegin(GL_QUADS);
+            
+            int axis = node->splitAxis;
+            float pos = node->splitPosition;
+            
+            if (axis == 0) { // X-axis
+                glVertex3f(pos, min.y, min.z);
+                glVertex3f(pos, max.y, min.z);
+                glVertex3f(pos, max.y, max.z);
+                glVertex3f(pos, min.y, max.z);
+            } else if (axis == 1) { // Y-axis
+                glVertex3f(min.x, pos, min.z);
+                glVertex3f(max.x, pos, min.z);
+                glVertex3f(max.x, pos, max.z);
+                glVertex3f(min.x, pos, max.z);
+            } else if (axis == 2) { // Z-axis
+                glVertex3f(min.x, min.y, pos);
+                glVertex3f(max.x, min.y, pos);
+                glVertex3f(max.x, max.y, pos);
+                glVertex3f(min.x, max.y, pos);
+            }
+            
+            glEnd();
+        }
+        
+        // Recursively draw child nodes with safety checks
+        if (node->left) drawKDTreeNode(node->left);
+        if (node->right) drawKDTreeNode(node->right);
+    }
+
+    // The nodes are one flat array, no recursion needed
+    static void drawLBVHNodes(const std::vector<LBVH::LBVHNode>& nodes) {
+        glColor3f(1.0f, 0.5f, 0.0f); // Orange for the linear BVH
+        glBegin(GL_LINES);
+        for (const LBVH::LBVHNode& node : nodes) {
+            const glm::vec3& min = node.boundingBox.min;
+            const glm::vec3& max = node.boundingBox.max;
+
+            // Bottom face
+            glVertex3f(min.x, min.y, min.z); glVertex3f(max.x, min.y, min.z);
+            glVertex3f(max.x, min.y, min.z); glVertex3f(max.x, min.y, max.z);
+            glVertex3f(max.x, min.y, max.z); glVertex3f(min.x, min.y, max.z);
+            glVertex3f(min.x, min.y, max.z); glVertex3f(min.x, min.y, min.z);
+
+            // Top face
+            glVertex3f(min.x, max.y, min.z); glVertex3f(max.x, max.y, min.z);
+            glVertex3f(max.x, max.y, min.z); glVertex3f(max.x, max.y, max.z);
+            glVertex3f(max.x, max.y, max.z); glVertex3f(min.x, max.y, max.z);
+            glVertex3f(min.x, max.y, max.z); glVertex3f(min.x, max.y, min.z);
+
+            // Vertical edges
+            glVertex3f(min.x, min.y, min.z); glVertex3f(min.x, max.y, min.z);
+            glVertex3f(max.x, min.y, min.z); glVertex3f(max.x, max.y, min.z);
+            glVertex3f(max.x, min.y, max.z); glVertex3f(max.x, max.y, max.z);
+            glVertex3f(min.x, min.y, max.z); glVertex3f(min.x, max.y, max.z);
+        }
+        glEnd();
+    }
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <glm/glm.hpp>
+
+/*
+* Vertex welding and cleanup for imported triangle soups.
+*
+* STL stores every triangle with its own three vertices, so a closed part carries each vertex about
+* six times. Welding merges vertices with the same position (and color) into one, which shrinks the
+* buffers and gives the triangles shared indices.
+*
+* With a tolerance of 0 positions must match bit for bit (-0 and +0 are the same). With a positive
+* tolerance positions are snapped to a grid of that spacing before comparing. Two vertices closer
+* than the tolerance but on different sides of a grid line stay separate; that is accepted, the
+* goal is removing exact and near-exact duplicates from CAD exports, not simplification.
+*
+* Triangles that end up with a repeated index or zero area are dropped, then vertices no triangle
+* references are removed.
+*/
+
+struct WeldStats {
+    size_t inputVertices = 0;
+    size_t outputVertices = 0;
+    size_t inputTriangles = 0;
+    size_t outputTriangles = 0;
+    size_t degenerateTriangles = 0; // Dropped, collapsed or zero area
+};
+
+class MeshWeld {
+public:
+    static WeldStats weld(std::vector<float>& vertices, std::vector<float>& colors, std::vector<unsigned int>& indices,
+                          float tolerance = 0.0f) {
+        WeldStats stats;
+        size_t vertexCount = vertices.size() / 3;
+        bool hasColors = colors.size() == vertices.size();
+        stats.inputVertices = vertexCount;
+        stats.inputTriangles = indices.size() / 3;
+
+        // 1. Map every vertex to the first vertex with the same key
+        std::vector<unsigned int> canonical(vertexCount);
+        std::unordered_map<VertexKey, unsigned int, VertexKeyHash> firstWithKey;
+        firstWithKey.reserve(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            VertexKey key = makeKey(&vertices[v * 3], hasColors ? &colors[v * 3] : nullptr, tolerance);
+            canonical[v] = firstWithKey.insert(std::make_pair(key, static_cast<unsigned int>(v))).first->second;
+        }
+
+        // 2. Keep triangles that still have three distinct corners and some area
+        std::vector<unsigned int> cleanIndices;
+        cleanIndices.reserve(indices.size());
+        for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+            if (indices[t] >= vertexCount || indices[t + 1] >= vertexCount || indices[t + 2] >= vertexCount) {
+                stats.degenerateTriangles++;
+                continue;
+            }
+            unsigned int a = canonical[indices[t]];
+            unsigned int b = canonical[indices[t + 1]];
+            unsigned int c = canonical[indices[t + 2]];
+            if (a == b || b == c || a == c || isZeroArea(vertices, a, b, c)) {
+                stats.degenerateTriangles++;
+                continue;
+            }
+            cleanIndices.insert(cleanIndices.end(), { a, b, c });
+        }
+
+        // 3. Compact to the referenced vertices, in order of first use
+        const unsigned int unused = 0xFFFFFFFFu;
+        std::vector<unsigned int> remap(vertexCount, unused);
+        std::vector<float> cleanVertices;
+        std::vector<float> cleanColors;
+        cleanVertices.reserve(firstWithKey.size() * 3);
+        if (hasColors) cleanColors.reserve(firstWithKey.size() * 3);
+        for (unsigned int& index : cleanIndices) {
+            if (remap[index] == unused) {
+                remap[index] = static_cast<unsigned int>(cleanVertices.size() / 3);
+                cleanVertices.insert(cleanVertices.end(), &vertices[index * 3], &vertices[index * 3] + 3);
+                if (hasColors) cleanColors.insert(cleanColors.end(), &colors[index * 3], &colors[index * 3] + 3);
+            }
+            index = remap[index];
+        }
+
+        vertices.swap(cleanVertices);
+        indices.swap(cleanIndices);
+        if (hasColors) colors.swap(cleanColors);
+        stats.outputVertices = vertices.size() / 3;
+        stats.outputTriangles = indices.size() / 3;
+        return stats;
+    }
+
+private:
+    // Compared member by member: the struct has tail padding, which copies do not preserve
+    struct VertexKey {
+        int64_t position[3];
+        uint32_t color[3];
+
+        bool operator==(const VertexKey& other) const {
+            return position[0] == other.position[0] && position[1] == other.position[1] && position[2] == other.position[2] &&
+                   color[0] == other.color[0] && color[1] == other.color[1] && color[2] == other.color[2];
+        }
+    };
+
+    struct VertexKeyHash {
+        size_t operator()(const VertexKey& key) const {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (int i = 0; i < 3; ++i) hash = (hash ^ static_cast<uint64_t>(key.position[i])) * 0x100000001b3ull;
+            for (int i = 0; i < 3; ++i) hash = (hash ^ key.color[i]) * 0x100000001b3ull;
+            return static_cast<size_t>(hash ^ (hash >> 32));
+        }
+    };
+
+    static VertexKey makeKey(const float* position, const float* color, float tolerance) {
+        VertexKey key = VertexKey(); // Colors stay 0 without a color buffer
+        for (int i = 0; i < 3; ++i) {
+            if (tolerance > 0.0f) {
+                key.position[i] = static_cast<int64_t>(std::llround(static_cast<double>(position[i]) / tolerance));
+            }
+            else {
+                float value = position[i] == 0.0f ? 0.0f : position[i]; // -0 welds with +0
+                uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                key.position[i] = bits;
+            }
+            if (color) {
+                std::memcpy(&key.color[i], &color[i], sizeof(uint32_t));
+            }
+        }
+        return key;
+    }
+
+    static bool isZeroArea(const std::vector<float>& vertices, unsigned int a, unsigned int b, unsigned int c) {
+        glm::vec3 p0(vertices[a * 3], vertices[a * 3 + 1], vertices[a * 3 + 2]);
+        glm::vec3 p1(vertices[b * 3], vertices[b * 3 + 1], vertices[b * 3 + 2]);
+        glm::vec3 p2(vertices[c * 3], vertices[c * 3 + 1], vertices[c * 3 + 2]);
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        return normal.x == 0.0f && normal.y == 0.0f && normal.z == 0.0f;
+    }
+};
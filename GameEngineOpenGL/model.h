@@ -1,42 +1,104 @@
 #pragma once
 
 #include "camera.h"
-#include <glm/gtc/type_ptr.hpp>
-#include <GL/gl.h>
-#include <GL/glu.h>
+#include <chrono>
 #include <sstream>
+#include <string>
 #include <vector>
 #include "Mesh.h"
-#include "grid.h"
+#include "log.h"
+#include "meshcache.h"
 #include "spacialaccelerator.h"
-#include "ProjectionSystem.h"
+#include "raypacket.h"
+#include "geometrycache.h"
+#include "projectionsystem.h"
+#include "scenesnapshot.h"
+#include "sessiontrace.h"
+#include "jobsystem.h"
 #include <memory>
 
+// Rays per job system piece of Model::findRayIntersections
+#define RAYCAST_BATCH_GRAIN 1024
+
+// Closest hit of one ray of a batch
+struct RayIntersection {
+    MeshHandle mesh;    // Null if nothing is hit
+    int faceIndex;      // -1 if nothing is hit
+    float distance;     // Along the world ray, its tMax if nothing is hit
+};
+
+// A mesh reached by a rectangle selection
+struct RectangleHit {
+    MeshHandle mesh;
+    std::vector<int> faces; // Sorted indices of its faces wholly or partly inside the rectangle
+};
+
 class Model {
 public:
 	Camera camera;
-	std::vector<Mesh> meshes;
-	Grid grid;
-    std::unique_ptr<SpatialAccelerator> accelerator;
+	MeshStore meshes; // Slot map, refer to meshes by MeshHandle
+    GeometryCache geometryCache; // Generated primitive geometry shared between meshes
     std::unique_ptr<ViewProjMethodGLM> projectionMethod;
+    SceneCommandQueue renderCommands; // Edits published to the render thread
+    SessionRecorder recorder; // Records scene operations while a session trace is being written
+    mutable AcceleratorSelector acceleratorSelector; // Learns build and pick costs for ACCELERATOR_AUTO
     
-	Model() : camera(), grid(camera) {
-        // Create the appropriate spatial accelerator based on optimization mode
-        accelerator.reset(SpatialAcceleratorFactory::createAccelerator());
+	Model() : camera(), batchDepth(0), acceleratorType(ACCELERATOR_AUTO) {
 	}
 
-	void init() {
-		// To enable depth testing, which can be used to determine which objects, or parts of objects, are visible
-		glEnable(GL_DEPTH_TEST);
-		// Clear the color and depth buffer
-		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	}
+    AcceleratorType getAcceleratorType() const {
+        return acceleratorType;
+    }
 
+    // Switch the accelerator used for every geometry. Existing accelerators are rebuilt.
+    void setAcceleratorType(AcceleratorType type) {
+        if (type == acceleratorType) return;
+        acceleratorType = type;
+        std::vector<std::shared_ptr<MeshGeometry>> alive;
+        std::vector<MeshGeometry*> geometries;
+        for (Mesh& mesh : meshes) {
+            if (mesh.geometry->accelerator) {
+                std::atomic_store(&mesh.geometry->accelerator, std::shared_ptr<SpatialAccelerator>());
+                geometries.push_back(mesh.geometry.get());
+                alive.push_back(mesh.geometry);
+            }
+        }
+        buildGeometryAccelerators(geometries);
+        logMessage(LOG_INFO, std::string("Accelerator set to ") + acceleratorTypeName(type));
+    }
+
+    // Build the accelerators of geometry that does not have one yet.
+    // Meshes sharing a geometry share its accelerator, so adding another copy of a primitive builds nothing.
     void buildAccelerator() {
-        if (accelerator) {
-            accelerator->build(meshes);
+        PROFILE_SCOPE("model.build_accelerators");
+        std::vector<MeshGeometry*> geometries;
+        for (Mesh& mesh : meshes) {
+            geometries.push_back(mesh.geometry.get());
+        }
+        pendingGeometry.clear();
+        buildGeometryAccelerators(geometries);
+    }
+
+    // *** Batch Editing ***
+    //
+    // Scripts creating thousands of meshes wrap them in beginBatch()/commitBatch(). Inside a batch,
+    // creates only record geometry that still needs an accelerator; every such accelerator is built
+    // once at commit. Batches nest, the outermost commit does the work.
+
+    void beginBatch(size_t expectedMeshes = 0) {
+        if (batchDepth++ == 0) {
+            meshes.reserve(meshes.size() + expectedMeshes);
+        }
+    }
+
+    void commitBatch() {
+        if (batchDepth > 0 && --batchDepth == 0) {
+            buildPendingAccelerators();
+        }
     }
+
+    bool isBatching() const {
+        return batchDepth > 0;
     }
 
 	// Get Projection Matrix
@@ -49,61 +111,33 @@ public:
 
     // Call this whenever screen size or camera mode changes
     void updateProjection(int width, int height) {
-        // Update the aspect ratio based on the window size
-        float aspect = float(width) / float(height);
-        
-        if (camera.mode == PERSPECTIVE_MODE) {
-            projectionMethod = std::make_unique<PerspectiveProj>(
-                camera.zoom, aspect, camera.nearPlane, camera.farPlane);
-        }
-        else {
-            float orthoZoom = 1.0f / camera.zoom;
-            
-            // For orthographic projection, we need to ensure the near and far planes 
-            // are set appropriately to prevent depth clipping issues
-            float nearOrtho = -camera.farPlane;  // Use a negative near plane for orthographic to ensure objects aren't clipped
-            float farOrtho = camera.farPlane;    // Keep far plane the same
-            
-            projectionMethod = std::make_unique<OrthoProj>(
-                -aspect * orthoZoom, aspect * orthoZoom,
-                -orthoZoom, orthoZoom,
-                nearOrtho, farOrtho);
-        }
+        projectionMethod = createCameraProjection(camera, width, height);
     }
 
-	void draw(int width, int height) {
-		// Clear the color and depth buffer
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		// Set Projection Matrix
-		glMatrixMode(GL_PROJECTION);
-		glLoadIdentity();
-        if (projectionMethod) {
-            glm::mat4 proj = projectionMethod->getComposedProjectionMatrix();
-        glLoadMatrixf(glm::value_ptr(proj));
+    // Hand every mesh changed since the last publish, and the camera, to the render thread.
+    // Called by the UI thread once it has finished handling a message.
+    // Only the meshes on the change list are visited, which Mesh::markChanged() fills, so a message
+    // that changed nothing costs nothing per mesh and pushes nothing.
+    void publishChanges() {
+        PROFILE_SCOPE("model.publish");
+        for (MeshHandle handle : changedMeshes) {
+            Mesh* mesh = meshes.get(handle);
+            if (!mesh || mesh->publishedRevision == mesh->revision) continue; // Deleted since
+            mesh->publishedRevision = mesh->revision;
+            publishBuffer.push_back(SceneCommand(SceneCommand::UPSERT_MESH, handle, std::make_shared<const Mesh>(*mesh)));
         }
-
-		// Set Model View Matrix
-		glMatrixMode(GL_MODELVIEW);
-		glLoadIdentity();
-		glLoadMatrixf(glm::value_ptr(camera.getViewMatrix()));
-
-		// Draw the plane grid
-        grid.drawXZGrid();
-
-		// Draw the meshes
-		for (const auto& mesh : meshes) {
-			mesh.draw();
-			mesh.drawLocalAxis(); // Draw local axis for each mesh
-		}
-
+        changedMeshes.clear();
+        renderCommands.push(publishBuffer);
+        renderCommands.pushCamera(camera);
+        recorder.recordCamera(camera);
     }
 
-    // Update mesh properties and rebuild spatial accelerator
-    void updateMeshProperties(int meshIndex, float rotX, float rotY, float rotZ, 
+    // Update mesh rotation and position, the accelerator works in object space and stays valid
+    void updateMeshProperties(MeshHandle meshHandle, float rotX, float rotY, float rotZ, 
                               float posX, float posY, float posZ) {
-        if (meshIndex >= 0 && meshIndex < static_cast<int>(meshes.size())) {
-            Mesh& mesh = meshes[meshIndex];
+        recorder.recordUpdateTransform(meshHandle, rotX, rotY, rotZ, posX, posY, posZ);
+        if (Mesh* meshPtr = meshes.get(meshHandle)) {
+            Mesh& mesh = *meshPtr;
             
             // Update mesh properties
             mesh.rotationX = rotX;
@@ -113,24 +147,23 @@ public:
             mesh.centerY = posY;
             mesh.centerZ = posZ;
             
-            // Update the mesh geometry
+            // Update the mesh transform, the accelerator works in object space and stays valid
             mesh.updateMesh();
-            
-            // Rebuild spatial accelerator because mesh geometry changed
-            buildAccelerator();
         }
     }
     
     // Comprehensive update of mesh properties including scale, color, etc.
-    void updateMeshAllProperties(int meshIndex, 
+    void updateMeshAllProperties(MeshHandle meshHandle, 
                                float rotX, float rotY, float rotZ,
                                float posX, float posY, float posZ,
                                float scaleX, float scaleY, float scaleZ,
                                float colorR, float colorG, float colorB, 
                                float transparency, float shininess, int materialType,
                                bool wireframe, bool visible) {
-        if (meshIndex >= 0 && meshIndex < static_cast<int>(meshes.size())) {
-            Mesh& mesh = meshes[meshIndex];
+        recorder.recordUpdateProperties(meshHandle, rotX, rotY, rotZ, posX, posY, posZ, scaleX, scaleY, scaleZ,
+                                        colorR, colorG, colorB, transparency, shininess, materialType, wireframe, visible);
+        if (Mesh* meshPtr = meshes.get(meshHandle)) {
+            Mesh& mesh = *meshPtr;
             
             // First, handle color and material changes
             if (mesh.colorR != colorR || mesh.colorG != colorG || mesh.colorB != colorB) {
@@ -170,64 +203,115 @@ public:
                 mesh.centerZ = posZ;
             }
             
-            // Always update the mesh to apply all changes
+            // Always update the mesh to apply all changes, the accelerator stays valid
             mesh.updateMesh();
-            
-            // Rebuild spatial accelerator because mesh geometry changed
-            buildAccelerator();
         }
     }
 
-    void createCube(int x, int y, int z) {
-        Mesh mesh;
+    // *** Geometry Editing ***
+    //
+    // Buffers of a mesh in the model are replaced through these, not through the Mesh setters
+    // directly: the mesh copies geometry it shares first (Mesh::editGeometry), then the model
+    // queues the new faces for an accelerator like a new mesh's, so a batch builds it at commit.
+    // New colors leave the faces as they are, the accelerator is kept.
+
+    void setMeshVertices(MeshHandle handle, std::vector<float>&& vertices) {
+        if (Mesh* mesh = meshes.get(handle)) {
+            mesh->setVertices(std::move(vertices));
+            mesh->updateMesh(); // World bounds follow the new vertices
+            queueAcceleratorBuild(mesh->geometry);
+        }
+    }
 
-        float halfSize = 0.5f; // Default size is 1 unit
+    void setMeshIndices(MeshHandle handle, std::vector<unsigned int>&& indices) {
+        if (Mesh* mesh = meshes.get(handle)) {
+            mesh->setIndices(std::move(indices));
+            queueAcceleratorBuild(mesh->geometry);
+        }
+    }
 
-        // Define vertices for a cube centered at (x, y, z)
-        std::vector<GLfloat> vertices = {
-            // Front face
-            x - halfSize, y - halfSize, z + halfSize, // Bottom-left
-            x + halfSize, y - halfSize, z + halfSize, // Bottom-right
-            x + halfSize, y + halfSize, z + halfSize, // Top-right
-            x - halfSize, y + halfSize, z + halfSize, // Top-left
+    void setMeshColors(MeshHandle handle, std::vector<float>&& colors) {
+        if (Mesh* mesh = meshes.get(handle)) {
+            std::shared_ptr<MeshGeometry> previous = mesh->geometry;
+            mesh->setColors(std::move(colors));
+            // A copy has the same faces at other addresses, its accelerator is the original's re-pointed.
+            // Inside a batch the original may still be waiting for its own, the copy then queues one.
+            if (mesh->geometry != previous) {
+                if (previous->accelerator) {
+                    std::atomic_store(&mesh->geometry->accelerator, std::shared_ptr<SpatialAccelerator>(
+                        previous->accelerator->clone(previous->faces, mesh->geometry->faces)));
+                } else {
+                    queueAcceleratorBuild(mesh->geometry);
+                }
+            }
+        }
+    }
 
-            // Back face
-            x - halfSize, y - halfSize, z - halfSize, // Bottom-left
-            x + halfSize, y - halfSize, z - halfSize, // Bottom-right
-            x + halfSize, y + halfSize, z - halfSize, // Top-right
-            x - halfSize, y + halfSize, z - halfSize  // Top-left
-        };
+    // Add a mesh referencing the geometry, with the geometry's origin placed at (x, y, z)
+    MeshHandle createInstance(const std::shared_ptr<MeshGeometry>& geometry, int x, int y, int z) {
+        MeshHandle handle = addMesh();
+        Mesh& mesh = *meshes.get(handle);
+        mesh.setGeometry(geometry, glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)));
+        queueAcceleratorBuild(geometry);
+        return handle;
+    }
 
-        std::vector<GLfloat> colors = {
-            // Front face (red)
-            1.0f, 0.0f, 0.0f, // Bottom-left
-            1.0f, 0.0f, 0.0f, // Bottom-right
-            1.0f, 0.0f, 0.0f, // Top-right
-            1.0f, 0.0f, 0.0f, // Top-left
-
-            // Back face (blue)
-            0.0f, 0.0f, 1.0f, // Bottom-left
-            0.0f, 0.0f, 1.0f, // Bottom-right
-            0.0f, 0.0f, 1.0f, // Top-right
-            0.0f, 0.0f, 1.0f  // Top-left
-        };
+    // Primitives are generated once around the origin and shared through the geometry cache,
+    // each create call only adds a mesh that places the shared geometry at (x, y, z).
+
+    MeshHandle createCube(int x, int y, int z) {
+        const float halfSize = 0.5f; // Default size is 1 unit
+
+        std::shared_ptr<MeshGeometry> geometry = geometryCache.acquire(PrimitiveKey(PRIMITIVE_CUBE, 0, 0, halfSize, 0.0f), [&]() {
+            // Define vertices for a cube centered at the origin
+            std::vector<float> vertices = {
+                // Front face
+                -halfSize, -halfSize,  halfSize, // Bottom-left
+                 halfSize, -halfSize,  halfSize, // Bottom-right
+                 halfSize,  halfSize,  halfSize, // Top-right
+                -halfSize,  halfSize,  halfSize, // Top-left
+
+                // Back face
+                -halfSize, -halfSize, -halfSize, // Bottom-left
+                 halfSize, -halfSize, -halfSize, // Bottom-right
+                 halfSize,  halfSize, -halfSize, // Top-right
+                -halfSize,  halfSize, -halfSize  // Top-left
+            };
+
+            std::vector<float> colors = {
+                // Front face (red)
+                1.0f, 0.0f, 0.0f, // Bottom-left
+                1.0f, 0.0f, 0.0f, // Bottom-right
+                1.0f, 0.0f, 0.0f, // Top-right
+                1.0f, 0.0f, 0.0f, // Top-left
+
+                // Back face (blue)
+                0.0f, 0.0f, 1.0f, // Bottom-left
+                0.0f, 0.0f, 1.0f, // Bottom-right
+                0.0f, 0.0f, 1.0f, // Top-right
+                0.0f, 0.0f, 1.0f  // Top-left
+            };
+
+            std::vector<unsigned int> indices = {
+                // Front face
+                0, 1, 2, 0, 2, 3,
+                // Back face
+                4, 5, 6, 4, 6, 7,
+                // Left face
+                4, 0, 3, 4, 3, 7,
+                // Right face
+                1, 5, 6, 1, 6, 2,
+                // Top face
+                3, 2, 6, 3, 6, 7,
+                // Bottom face
+                4, 5, 1, 4, 1, 0
+            };
 
-        std::vector<unsigned int> indices = {
-            // Front face
-            0, 1, 2, 0, 2, 3,
-            // Back face
-            4, 5, 6, 4, 6, 7,
-            // Left face
-            4, 0, 3, 4, 3, 7,
-            // Right face
-            1, 5, 6, 1, 6, 2,
-            // Top face
-            3, 2, 6, 3, 6, 7,
-            // Bottom face
-            4, 5, 1, 4, 1, 0
-        };
+            return MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+        });
 
-		mesh.init(vertices, colors, indices);
+        MeshHandle handle = createInstance(geometry, x, y, z);
+        Mesh& mesh = *meshes.get(handle);
         
         // Set cube-specific properties
         mesh.objectName = "Cube";
@@ -236,94 +320,92 @@ public:
         mesh.colorG = 0.0f;
         mesh.colorB = 0.0f;
         
-        meshes.push_back(mesh);
-		buildAccelerator();
-    }
-
-
-    void createPyramid(int x, int y, int z) {
-        Mesh mesh;
-        float halfSize = 0.5f; // Default size is 1 unit
-        // Define vertices for a pyramid centered at (x, y, z)
-        std::vector<GLfloat> vertices = {
-            // Base
-            static_cast<float>(x) - halfSize, static_cast<float>(y) - halfSize, static_cast<float>(z) - halfSize,
-            static_cast<float>(x) + halfSize, static_cast<float>(y) - halfSize, static_cast<float>(z) - halfSize,
-            static_cast<float>(x) + halfSize, static_cast<float>(y) - halfSize, static_cast<float>(z) + halfSize,
-            static_cast<float>(x) - halfSize, static_cast<float>(y) - halfSize, static_cast<float>(z) + halfSize,
-            // Apex
-            static_cast<float>(x), static_cast<float>(y) + halfSize, static_cast<float>(z)
-       };
-       std::vector<GLfloat> colors = {
-           // Base (green)
-           0.0f, 1.0f, 0.0f,
-           0.0f, 1.0f, 0.0f,
-           0.0f, 1.0f, 0.0f,
-           0.0f, 1.0f, 0.0f,
-           // Apex (yellow)
-           1.0f, 1.0f, 0.0f
-       };
-       std::vector<unsigned int> indices = {
-           // Base
-           0, 1, 2, 2, 3, 0,
-           // Sides
-           4, 1, 2,
-           4, 2, 3,
-           4, 3, 0,
-           4, 0, 1
-       };
-       mesh.init(vertices, colors, indices);
+        recorder.recordCreatePrimitive(PRIMITIVE_CUBE, x, y, z, handle);
+        return handle;
+    }
+
+    MeshHandle createPyramid(int x, int y, int z) {
+        const float halfSize = 0.5f; // Default size is 1 unit
+
+        std::shared_ptr<MeshGeometry> geometry = geometryCache.acquire(PrimitiveKey(PRIMITIVE_PYRAMID, 0, 0, halfSize, 0.0f), [&]() {
+            // Define vertices for a pyramid centered at the origin
+            std::vector<float> vertices = {
+                // Base
+                -halfSize, -halfSize, -halfSize,
+                 halfSize, -halfSize, -halfSize,
+                 halfSize, -halfSize,  halfSize,
+                -halfSize, -halfSize,  halfSize,
+                // Apex
+                0.0f, halfSize, 0.0f
+            };
+            std::vector<float> colors = {
+                // Base (green)
+                0.0f, 1.0f, 0.0f,
+                0.0f, 1.0f, 0.0f,
+                0.0f, 1.0f, 0.0f,
+                0.0f, 1.0f, 0.0f,
+                // Apex (yellow)
+                1.0f, 1.0f, 0.0f
+            };
+            std::vector<unsigned int> indices = {
+                // Base
+                0, 1, 2, 2, 3, 0,
+                // Sides
+                4, 1, 2,
+                4, 2, 3,
+                4, 3, 0,
+                4, 0, 1
+            };
+            return MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+        });
+
+        MeshHandle handle = createInstance(geometry, x, y, z);
+        Mesh& mesh = *meshes.get(handle);
        
-       // Set pyramid-specific properties
-       mesh.objectName = "Pyramid";
-       mesh.objectType = "Pyramid";
-       mesh.colorR = 0.0f;
-       mesh.colorG = 1.0f;
-       mesh.colorB = 0.0f;
+        // Set pyramid-specific properties
+        mesh.objectName = "Pyramid";
+        mesh.objectType = "Pyramid";
+        mesh.colorR = 0.0f;
+        mesh.colorG = 1.0f;
+        mesh.colorB = 0.0f;
        
-       meshes.push_back(mesh);
-       buildAccelerator();
+        recorder.recordCreatePrimitive(PRIMITIVE_PYRAMID, x, y, z, handle);
+        return handle;
     }
 
-    void createCircle(int x, int y, int z) {
-        Mesh mesh;
+    MeshHandle createCircle(int x, int y, int z) {
         const int segments = 36; // Number of segments for the circle
         const float radius = 0.5f; // Default radius is 0.5 units
 
-        std::vector<GLfloat> vertices;
-        std::vector<GLfloat> colors;
-        std::vector<unsigned int> indices;
-
-        // Center vertex
-        vertices.push_back(x);
-        vertices.push_back(y);
-        vertices.push_back(z);
-        colors.push_back(1.0f);
-        colors.push_back(1.0f);
-        colors.push_back(0.0f); // Yellow center
-
-        // Generate circle vertices
-        for (int i = 0; i <= segments; ++i) {
-            float angle = 2.0f * 3.14159265358979323846 * i / segments;
-            float vx = x + radius * cos(angle);
-            float vz = z + radius * sin(angle);
-
-            vertices.push_back(vx);
-            vertices.push_back(y);
-            vertices.push_back(vz);
-
-            colors.push_back(0.0f);
-            colors.push_back(0.0f);
-            colors.push_back(1.0f); // Blue circle
-
-            if (i > 0) {
-                indices.push_back(0);
-                indices.push_back(i);
-                indices.push_back(i + 1);
+        std::shared_ptr<MeshGeometry> geometry = geometryCache.acquire(PrimitiveKey(PRIMITIVE_CIRCLE, segments, 0, radius, 0.0f), [&]() {
+            SinCosTable angles(segments, 2.0 * 3.14159265358979323846);
+
+            std::vector<float> vertices;
+            std::vector<float> colors;
+            std::vector<unsigned int> indices;
+            vertices.reserve((segments + 2) * 3);
+            colors.reserve((segments + 2) * 3);
+            indices.reserve(segments * 3);
+
+            // Center vertex
+            vertices.insert(vertices.end(), { 0.0f, 0.0f, 0.0f });
+            colors.insert(colors.end(), { 1.0f, 1.0f, 0.0f }); // Yellow center
+
+            // Generate circle vertices
+            for (int i = 0; i <= segments; ++i) {
+                vertices.insert(vertices.end(), { radius * angles.cosValues[i], 0.0f, radius * angles.sinValues[i] });
+                colors.insert(colors.end(), { 0.0f, 0.0f, 1.0f }); // Blue circle
+
+                if (i > 0) {
+                    indices.insert(indices.end(), { 0u, static_cast<unsigned int>(i), static_cast<unsigned int>(i + 1) });
+                }
             }
-        }
 
-        mesh.init(vertices, colors, indices);
+            return MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+        });
+
+        MeshHandle handle = createInstance(geometry, x, y, z);
+        Mesh& mesh = *meshes.get(handle);
         
         // Set circle-specific properties
         mesh.objectName = "Circle";
@@ -332,65 +414,59 @@ public:
         mesh.colorG = 0.0f;
         mesh.colorB = 1.0f;
         
-        meshes.push_back(mesh);
-        buildAccelerator();
+        recorder.recordCreatePrimitive(PRIMITIVE_CIRCLE, x, y, z, handle);
+        return handle;
     }
 
-    void createCylinder(int x, int y, int z) {
-        Mesh mesh;
+    MeshHandle createCylinder(int x, int y, int z) {
         const int segments = 36; // Number of segments for the cylinder
         const float radius = 0.5f; // Default radius is 0.5 units
         const float height = 1.0f; // Default height is 1 unit
 
-        std::vector<GLfloat> vertices;
-        std::vector<GLfloat> colors;
-        std::vector<unsigned int> indices;
-
-        // Generate top and bottom circle vertices
-        for (int i = 0; i <= segments; ++i) {
-            float angle = 2.0f * 3.14159265358979323846 * i / segments;
-            float vx = radius * cos(angle);
-            float vz = radius * sin(angle);
-
-            // Bottom circle
-            vertices.push_back(x + vx);
-            vertices.push_back(y);
-            vertices.push_back(z + vz);
-            colors.push_back(1.0f);
-            colors.push_back(0.0f);
-            colors.push_back(0.0f); // Red bottom
-
-            // Top circle
-            vertices.push_back(x + vx);
-            vertices.push_back(y + height);
-            vertices.push_back(z + vz);
-            colors.push_back(0.0f);
-            colors.push_back(1.0f);
-            colors.push_back(0.0f); // Green top
-
-            if (i > 0) {
-                // Side faces
-                indices.push_back(2 * (i - 1));
-                indices.push_back(2 * i);
-                indices.push_back(2 * (i - 1) + 1);
-
-                indices.push_back(2 * (i - 1) + 1);
-                indices.push_back(2 * i);
-                indices.push_back(2 * i + 1);
+        std::shared_ptr<MeshGeometry> geometry = geometryCache.acquire(PrimitiveKey(PRIMITIVE_CYLINDER, segments, 0, radius, height), [&]() {
+            SinCosTable angles(segments, 2.0 * 3.14159265358979323846);
 
-                // Bottom face
-                indices.push_back(0);
-                indices.push_back(2 * (i - 1));
-                indices.push_back(2 * i);
+            std::vector<float> vertices;
+            std::vector<float> colors;
+            std::vector<unsigned int> indices;
+            vertices.reserve((segments + 1) * 6);
+            colors.reserve((segments + 1) * 6);
+            indices.reserve(segments * 12);
 
-                // Top face
-                indices.push_back(1);
-                indices.push_back(2 * (i - 1) + 1);
-                indices.push_back(2 * i + 1);
+            // Generate top and bottom circle vertices
+            for (int i = 0; i <= segments; ++i) {
+                float vx = radius * angles.cosValues[i];
+                float vz = radius * angles.sinValues[i];
+
+                // Bottom circle
+                vertices.insert(vertices.end(), { vx, 0.0f, vz });
+                colors.insert(colors.end(), { 1.0f, 0.0f, 0.0f }); // Red bottom
+
+                // Top circle
+                vertices.insert(vertices.end(), { vx, height, vz });
+                colors.insert(colors.end(), { 0.0f, 1.0f, 0.0f }); // Green top
+
+                if (i > 0) {
+                    unsigned int prevBottom = 2 * (i - 1);
+                    unsigned int bottom = 2 * i;
+
+                    // Side faces
+                    indices.insert(indices.end(), { prevBottom, bottom, prevBottom + 1 });
+                    indices.insert(indices.end(), { prevBottom + 1, bottom, bottom + 1 });
+
+                    // Bottom face
+                    indices.insert(indices.end(), { 0u, prevBottom, bottom });
+
+                    // Top face
+                    indices.insert(indices.end(), { 1u, prevBottom + 1, bottom + 1 });
+                }
             }
-        }
 
-        mesh.init(vertices, colors, indices);
+            return MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+        });
+
+        MeshHandle handle = createInstance(geometry, x, y, z);
+        Mesh& mesh = *meshes.get(handle);
         
         // Set cylinder-specific properties
         mesh.objectName = "Cylinder";
@@ -399,52 +475,51 @@ public:
         mesh.colorG = 0.0f;
         mesh.colorB = 0.0f;
         
-        meshes.push_back(mesh);
-        buildAccelerator();
+        recorder.recordCreatePrimitive(PRIMITIVE_CYLINDER, x, y, z, handle);
+        return handle;
     }
 
-    void createSphere(int x, int y, int z) {
-        Mesh mesh;
+    MeshHandle createSphere(int x, int y, int z) {
         const int segments = 36; // Number of segments for the sphere
         const int rings = 18;   // Number of rings for the sphere
         const float radius = 0.5f; // Default radius is 0.5 units
 
-        std::vector<GLfloat> vertices;
-        std::vector<GLfloat> colors;
-        std::vector<unsigned int> indices;
-
-        for (int i = 0; i <= rings; ++i) {
-            float phi = 3.14159265358979323846 * i / rings;
-            for (int j = 0; j <= segments; ++j) {
-                float theta = 2.0f * 3.14159265358979323846 * j / segments;
-                float vx = radius * sin(phi) * cos(theta);
-                float vy = radius * cos(phi);
-                float vz = radius * sin(phi) * sin(theta);
-
-                vertices.push_back(x + vx);
-                vertices.push_back(y + vy);
-                vertices.push_back(z + vz);
-
-                colors.push_back(0.5f);
-                colors.push_back(0.5f);
-                colors.push_back(0.5f); // Gray sphere
-
-                if (i < rings && j < segments) {
-                    int first = i * (segments + 1) + j;
-                    int second = first + segments + 1;
-
-                    indices.push_back(first);
-                    indices.push_back(second);
-                    indices.push_back(first + 1);
-
-                    indices.push_back(second);
-                    indices.push_back(second + 1);
-                    indices.push_back(first + 1);
+        std::shared_ptr<MeshGeometry> geometry = geometryCache.acquire(PrimitiveKey(PRIMITIVE_SPHERE, segments, rings, radius, 0.0f), [&]() {
+            SinCosTable phiTable(rings, 3.14159265358979323846);
+            SinCosTable thetaTable(segments, 2.0 * 3.14159265358979323846);
+
+            std::vector<float> vertices;
+            std::vector<float> colors;
+            std::vector<unsigned int> indices;
+            vertices.reserve((rings + 1) * (segments + 1) * 3);
+            colors.reserve((rings + 1) * (segments + 1) * 3);
+            indices.reserve(rings * segments * 6);
+
+            for (int i = 0; i <= rings; ++i) {
+                float sinPhi = phiTable.sinValues[i];
+                float cosPhi = phiTable.cosValues[i];
+                for (int j = 0; j <= segments; ++j) {
+                    vertices.insert(vertices.end(), {
+                        radius * sinPhi * thetaTable.cosValues[j],
+                        radius * cosPhi,
+                        radius * sinPhi * thetaTable.sinValues[j] });
+                    colors.insert(colors.end(), { 0.5f, 0.5f, 0.5f }); // Gray sphere
+
+                    if (i < rings && j < segments) {
+                        unsigned int first = i * (segments + 1) + j;
+                        unsigned int second = first + segments + 1;
+
+                        indices.insert(indices.end(), { first, second, first + 1 });
+                        indices.insert(indices.end(), { second, second + 1, first + 1 });
+                    }
                 }
             }
-        }
 
-        mesh.init(vertices, colors, indices);
+            return MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+        });
+
+        MeshHandle handle = createInstance(geometry, x, y, z);
+        Mesh& mesh = *meshes.get(handle);
         
         // Set sphere-specific properties
         mesh.objectName = "Sphere";
@@ -453,55 +528,50 @@ public:
         mesh.colorG = 0.5f;
         mesh.colorB = 0.5f;
         
-        meshes.push_back(mesh);
-        buildAccelerator();
+        recorder.recordCreatePrimitive(PRIMITIVE_SPHERE, x, y, z, handle);
+        return handle;
     }
 
-    void createCone(int x, int y, int z) {
-        Mesh mesh;
+    MeshHandle createCone(int x, int y, int z) {
         const int segments = 36; // Number of segments for the cone
         const float radius = 0.5f; // Default radius is 0.5 units
         const float height = 1.0f; // Default height is 1 unit
 
-        std::vector<GLfloat> vertices;
-        std::vector<GLfloat> colors;
-        std::vector<unsigned int> indices;
-
-        // Apex vertex
-        vertices.push_back(x);
-        vertices.push_back(y + height);
-        vertices.push_back(z);
-        colors.push_back(1.0f);
-        colors.push_back(0.5f);
-        colors.push_back(0.0f); // Orange apex
-
-        // Base vertices
-        for (int i = 0; i <= segments; ++i) {
-            float angle = 2.0f * 3.14159265358979323846 * i / segments;
-            float vx = radius * cos(angle);
-            float vz = radius * sin(angle);
-
-            vertices.push_back(x + vx);
-            vertices.push_back(y);
-            vertices.push_back(z + vz);
-            colors.push_back(0.0f);
-            colors.push_back(0.0f);
-            colors.push_back(1.0f); // Blue base
-
-            if (i > 0) {
-                // Side faces
-                indices.push_back(0);
-                indices.push_back(i);
-                indices.push_back(i + 1);
-
-                // Base face
-                indices.push_back(1);
-                indices.push_back(i);
-                indices.push_back(i + 1);
+        std::shared_ptr<MeshGeometry> geometry = geometryCache.acquire(PrimitiveKey(PRIMITIVE_CONE, segments, 0, radius, height), [&]() {
+            SinCosTable angles(segments, 2.0 * 3.14159265358979323846);
+
+            std::vector<float> vertices;
+            std::vector<float> colors;
+            std::vector<unsigned int> indices;
+            vertices.reserve((segments + 2) * 3);
+            colors.reserve((segments + 2) * 3);
+            indices.reserve(segments * 6);
+
+            // Apex vertex
+            vertices.insert(vertices.end(), { 0.0f, height, 0.0f });
+            colors.insert(colors.end(), { 1.0f, 0.5f, 0.0f }); // Orange apex
+
+            // Base vertices
+            for (int i = 0; i <= segments; ++i) {
+                vertices.insert(vertices.end(), { radius * angles.cosValues[i], 0.0f, radius * angles.sinValues[i] });
+                colors.insert(colors.end(), { 0.0f, 0.0f, 1.0f }); // Blue base
+
+                if (i > 0) {
+                    unsigned int current = static_cast<unsigned int>(i);
+
+                    // Side faces
+                    indices.insert(indices.end(), { 0u, current, current + 1 });
+
+                    // Base face
+                    indices.insert(indices.end(), { 1u, current, current + 1 });
+                }
             }
-        }
 
-        mesh.init(vertices, colors, indices);
+            return MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+        });
+
+        MeshHandle handle = createInstance(geometry, x, y, z);
+        Mesh& mesh = *meshes.get(handle);
         
         // Set cone-specific properties
         mesh.objectName = "Cone";
@@ -510,53 +580,51 @@ public:
         mesh.colorG = 0.5f;
         mesh.colorB = 0.0f;
         
-        meshes.push_back(mesh);
-        buildAccelerator();
+        recorder.recordCreatePrimitive(PRIMITIVE_CONE, x, y, z, handle);
+        return handle;
     }
 
-    void createTorus(int x, int y, int z) {
-        Mesh mesh;
+    MeshHandle createTorus(int x, int y, int z) {
         const int segments = 36; // Number of segments for the torus
         const int rings = 18;   // Number of rings for the torus
         const float majorRadius = 0.5f; // Default major radius
         const float minorRadius = 0.2f; // Default minor radius
 
-        std::vector<GLfloat> vertices;
-        std::vector<GLfloat> colors;
-        std::vector<unsigned int> indices;
-
-        for (int i = 0; i <= rings; ++i) {
-            float phi = 2.0f * 3.14159265358979323846 * i / rings;
-            for (int j = 0; j <= segments; ++j) {
-                float theta = 2.0f * 3.14159265358979323846 * j / segments;
-                float vx = (majorRadius + minorRadius * cos(theta)) * cos(phi);
-                float vy = minorRadius * sin(theta);
-                float vz = (majorRadius + minorRadius * cos(theta)) * sin(phi);
-
-                vertices.push_back(x + vx);
-                vertices.push_back(y + vy);
-                vertices.push_back(z + vz);
-
-                colors.push_back(1.0f);
-                colors.push_back(1.0f);
-                colors.push_back(0.0f); // Yellow torus
-
-                if (i < rings && j < segments) {
-                    int first = i * (segments + 1) + j;
-                    int second = first + segments + 1;
-
-                    indices.push_back(first);
-                    indices.push_back(second);
-                    indices.push_back(first + 1);
-
-                    indices.push_back(second);
-                    indices.push_back(second + 1);
-                    indices.push_back(first + 1);
+        std::shared_ptr<MeshGeometry> geometry = geometryCache.acquire(PrimitiveKey(PRIMITIVE_TORUS, segments, rings, majorRadius, minorRadius), [&]() {
+            SinCosTable phiTable(rings, 2.0 * 3.14159265358979323846);
+            SinCosTable thetaTable(segments, 2.0 * 3.14159265358979323846);
+
+            std::vector<float> vertices;
+            std::vector<float> colors;
+            std::vector<unsigned int> indices;
+            vertices.reserve((rings + 1) * (segments + 1) * 3);
+            colors.reserve((rings + 1) * (segments + 1) * 3);
+            indices.reserve(rings * segments * 6);
+
+            for (int i = 0; i <= rings; ++i) {
+                for (int j = 0; j <= segments; ++j) {
+                    float tube = majorRadius + minorRadius * thetaTable.cosValues[j];
+                    vertices.insert(vertices.end(), {
+                        tube * phiTable.cosValues[i],
+                        minorRadius * thetaTable.sinValues[j],
+                        tube * phiTable.sinValues[i] });
+                    colors.insert(colors.end(), { 1.0f, 1.0f, 0.0f }); // Yellow torus
+
+                    if (i < rings && j < segments) {
+                        unsigned int first = i * (segments + 1) + j;
+                        unsigned int second = first + segments + 1;
+
+                        indices.insert(indices.end(), { first, second, first + 1 });
+                        indices.insert(indices.end(), { second, second + 1, first + 1 });
+                    }
                 }
             }
-        }
 
-        mesh.init(vertices, colors, indices);
+            return MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+        });
+
+        MeshHandle handle = createInstance(geometry, x, y, z);
+        Mesh& mesh = *meshes.get(handle);
         
         // Set torus-specific properties
         mesh.objectName = "Torus";
@@ -565,34 +633,38 @@ public:
         mesh.colorG = 1.0f;
         mesh.colorB = 0.0f;
         
-        meshes.push_back(mesh);
-        buildAccelerator();
+        recorder.recordCreatePrimitive(PRIMITIVE_TORUS, x, y, z, handle);
+        return handle;
     }
 
-    void createPlane(int x, int y, int z) {
-        Mesh mesh;
+    MeshHandle createPlane(int x, int y, int z) {
         const float size = 1.0f; // Default size is 1 unit
 
-        std::vector<GLfloat> vertices = {
-            static_cast<float>(x) - size / 2, static_cast<float>(y), static_cast<float>(z) - size / 2,
-            static_cast<float>(x) + size / 2, static_cast<float>(y), static_cast<float>(z) - size / 2,
-            static_cast<float>(x) + size / 2, static_cast<float>(y), static_cast<float>(z) + size / 2,
-            static_cast<float>(x) - size / 2, static_cast<float>(y), static_cast<float>(z) + size / 2
-        };
-
-        std::vector<GLfloat> colors = {
-            0.0f, 1.0f, 0.0f, // Green plane
-            0.0f, 1.0f, 0.0f,
-            0.0f, 1.0f, 0.0f,
-            0.0f, 1.0f, 0.0f
-        };
-
-        std::vector<unsigned int> indices = {
-            0, 1, 2,
-            0, 2, 3
-        };
-
-        mesh.init(vertices, colors, indices);
+        std::shared_ptr<MeshGeometry> geometry = geometryCache.acquire(PrimitiveKey(PRIMITIVE_PLANE, 0, 0, size, 0.0f), [&]() {
+            std::vector<float> vertices = {
+                -size / 2, 0.0f, -size / 2,
+                 size / 2, 0.0f, -size / 2,
+                 size / 2, 0.0f,  size / 2,
+                -size / 2, 0.0f,  size / 2
+            };
+
+            std::vector<float> colors = {
+                0.0f, 1.0f, 0.0f, // Green plane
+                0.0f, 1.0f, 0.0f,
+                0.0f, 1.0f, 0.0f,
+                0.0f, 1.0f, 0.0f
+            };
+
+            std::vector<unsigned int> indices = {
+                0, 1, 2,
+                0, 2, 3
+            };
+
+            return MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+        });
+
+        MeshHandle handle = createInstance(geometry, x, y, z);
+        Mesh& mesh = *meshes.get(handle);
         
         // Set plane-specific properties
         mesh.objectName = "Plane";
@@ -601,26 +673,354 @@ public:
         mesh.colorG = 1.0f;
         mesh.colorB = 0.0f;
         
-        meshes.push_back(mesh);
-        buildAccelerator();
+        recorder.recordCreatePrimitive(PRIMITIVE_PLANE, x, y, z, handle);
+        return handle;
+    }
+
+    // Files are hashed before parsing. Importing content that is already loaded only adds a mesh
+    // referencing the existing geometry, so repeated parts are parsed and stored once. Files of one
+    // import with the same key are also compared byte for byte before they share geometry.
+    // Returns a null handle if the file could not be loaded.
+    MeshHandle createFromFile(const std::string& filePath) {
+        return createFromFiles(std::vector<std::string>(1, filePath))[0];
     }
 
-    void createFromFile(std::wstring filePath) {
-		Mesh mesh;
-		if (mesh.loadFromSTL(std::string(filePath.begin(), filePath.end()))) {
-			meshes.push_back(mesh);
-			buildAccelerator();
-			MessageBox(NULL, L"File loaded successfully!", L"Info", MB_OK);
-		} 
-		else {
-			MessageBox(NULL, L"Failed to load the file.", L"Error", MB_OK);
-		}
+    // Paths from the Win32 file dialog
+    MeshHandle createFromFile(const std::wstring& filePath) {
+        return createFromFile(std::string(filePath.begin(), filePath.end()));
+    }
+
+    // Import several files at once. Reading and hashing, then parsing and accelerator builds of
+    // content not loaded yet, run as jobs; only the cache lookups and mesh creation stay on this thread.
+    // Returns one handle per path, null for files that failed to load.
+    std::vector<MeshHandle> createFromFiles(const std::vector<std::string>& filePaths) {
+        PROFILE_SCOPE("import.files");
+        struct ImportFile {
+            std::string path;
+            MeshHandle handle;
+            glm::vec3 color;
+            std::vector<char> bytes;
+            bool read;
+            ContentKey key;
+            bool uncached; // Same key as an earlier file of this import but other bytes
+            std::shared_ptr<MeshGeometry> cached; // Found in the cache, held so the entry cannot expire meanwhile
+            std::shared_ptr<MeshGeometry> parsed; // Only for the first file of content not in the cache
+            ImportFile() : read(false), key(0, 0, 0), uncached(false) {}
+        };
+
+        beginBatch(filePaths.size());
+        std::vector<ImportFile> files(filePaths.size());
+        for (size_t i = 0; i < files.size(); ++i) {
+            files[i].path = filePaths[i];
+            files[i].handle = addMesh();
+            Mesh& mesh = *meshes.get(files[i].handle);
+            mesh.setImportedName(files[i].path);
+            files[i].color = glm::vec3(mesh.colorR, mesh.colorG, mesh.colorB);
+        }
+
+        JobSystem& jobs = JobSystem::instance();
+        jobs.parallelFor(0, files.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                files[i].read = Mesh::readFile(files[i].path, files[i].bytes);
+                if (files[i].read) files[i].key = ContentKey::fromBytes(files[i].bytes);
+            }
+        });
+
+        // Content that is neither cached nor already claimed by an earlier file in this import.
+        // Both files' bytes are still here, so a key match is confirmed before they share geometry.
+        std::vector<size_t> toParse;
+        std::map<ContentKey, size_t> firstFile;
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (!files[i].read) continue;
+            files[i].cached = geometryCache.find(files[i].key);
+            if (files[i].cached) continue;
+            std::pair<std::map<ContentKey, size_t>::iterator, bool> first = firstFile.insert(std::make_pair(files[i].key, i));
+            if (first.second) {
+                toParse.push_back(i);
+            }
+            else if (files[first.first->second].bytes != files[i].bytes) {
+                // Colliding keys: parsed on its own and kept out of the cache
+                logMessage(LOG_WARNING, "Content hash collision, " + files[i].path + " is not shared");
+                files[i].uncached = true;
+                toParse.push_back(i);
+            }
+        }
+
+        jobs.parallelFor(0, toParse.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t p = begin; p < end; ++p) {
+                ImportFile& file = files[toParse[p]];
+                std::vector<float> vertices;
+                std::vector<float> colors;
+                std::vector<unsigned int> indices;
+                // Baked files from meshbake are already welded, everything else is STL
+                bool parsed = MeshCache::isCacheFile(file.bytes)
+                    ? MeshCache::parse(file.bytes, file.color, vertices, colors, indices)
+                    : Mesh::parseSTL(file.bytes, file.color, vertices, colors, indices);
+                if (parsed) {
+                    file.parsed = MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+                    buildGeometryAccelerator(*file.parsed); // Nothing else references it yet
+                }
+                std::vector<char>().swap(file.bytes);
+            }
+        });
+
+        std::vector<MeshHandle> handles(files.size());
+        for (size_t i = 0; i < files.size(); ++i) {
+            ImportFile& file = files[i];
+            std::shared_ptr<MeshGeometry> geometry;
+            if (file.cached) {
+                geometry = file.cached;
+            }
+            else if (file.uncached) {
+                geometry = file.parsed;
+            }
+            else if (file.read) {
+                // The first file of this content parsed it, a later one finds it cached by then
+                std::map<ContentKey, size_t>::const_iterator first = firstFile.find(file.key);
+                if (first != firstFile.end()) {
+                    geometry = geometryCache.acquire(file.key, [&]() { return files[first->second].parsed; });
+                }
+            }
+
+            if (geometry) {
+                meshes.get(file.handle)->setGeometry(geometry);
+                queueAcceleratorBuild(geometry);
+                handles[i] = file.handle;
+            }
+            else {
+                meshes.erase(file.handle);
+                logMessage(LOG_ERROR, "Failed to load " + file.path);
+            }
+        }
+        commitBatch();
+        recorder.recordImport(filePaths, handles);
+        return handles;
     }
     
-    void deleteMesh(int index) {
-        if (index >= 0 && index < static_cast<int>(meshes.size())) {
-            meshes.erase(meshes.begin() + index);
-            buildAccelerator();
+    // O(1) removal: the last mesh is moved into the freed slot, other meshes keep their buffers
+    void deleteMesh(MeshHandle handle) {
+        recorder.recordDelete(handle);
+        // The geometry and its accelerator are released with the last mesh using them,
+        // which may be the render thread's copy
+        if (meshes.erase(handle)) {
+            renderCommands.push(SceneCommand(SceneCommand::REMOVE_MESH, handle));
+        }
+    }
+
+    // Closest mesh and face hit by a world-space ray, null handle and -1 if nothing is hit.
+    // Hidden meshes are skipped, as by the hover pick and rectangle selection. Tests each visible
+    // mesh's world AABB, then walks its geometry's accelerator in object space for the closest face,
+    // the ray clipped to the closest hit so far. Allocates nothing, so it can run for every mouse
+    // move. One pick in ACCELERATOR_QUERY_SAMPLE_INTERVAL times its queries for the
+    // accelerator selector, the others take no clock reads or locks.
+    void findRayIntersection(const Ray& ray, MeshHandle& outMesh, int& outFaceIndex) const {
+        PROFILE_SCOPE("pick");
+        outMesh = MeshHandle();
+        outFaceIndex = -1;
+        float closestDistance = ray.tMax;
+        bool timed = acceleratorSelector.sampleQuery();
+
+        for (size_t m = 0; m < meshes.size(); ++m) {
+            const Mesh& mesh = meshes[m];
+            const MeshGeometry& geometry = *mesh.geometry;
+            if (!mesh.isVisible || !geometry.accelerator || !mesh.aabb.isIntersectingRay(ray.origin, ray.direction, ray.tMin, closestDistance)) {
+                continue;
+            }
+
+            RayHit hit;
+            if (timed) {
+                std::chrono::steady_clock::time_point queryStart = std::chrono::steady_clock::now();
+                findClosestMeshHit(mesh, *geometry.accelerator, ray, closestDistance, hit);
+                acceleratorSelector.recordQuery(geometry.accelerator->getType(), geometry.faces.size(),
+                    std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - queryStart).count());
+            } else {
+                findClosestMeshHit(mesh, *geometry.accelerator, ray, closestDistance, hit);
+            }
+
+            if (hit.face) {
+                closestDistance = hit.t;
+                outMesh = meshes.handleAt(m);
+                outFaceIndex = static_cast<int>(hit.face - geometry.faces.data());
+            }
+        }
+    }
+
+    // Closest mesh, face and distance of every world-space ray: hits[i] for rays[i].
+    // For headless analyses over millions of rays. Pieces of RAYCAST_BATCH_GRAIN rays run on the job
+    // system, each going mesh by mesh and tracing the rays that reach the mesh's bounds in packets
+    // (raypacket.h), clipped to the closest hit so far. Hidden meshes are skipped, like in
+    // findRayIntersection(). Rays in coherent order trace fastest. Allocates nothing once each
+    // thread's scratch buffers have grown. The model must not change meanwhile.
+    void findRayIntersections(const Ray* rays, size_t count, RayIntersection* hits) const {
+        PROFILE_SCOPE("raycast.batch");
+        PROFILE_COUNT("raycast.rays", count);
+        JobSystem::instance().parallelFor(0, count, RAYCAST_BATCH_GRAIN, [&](size_t begin, size_t end) {
+            RaycastScratch& scratch = raycastScratch();
+            for (size_t i = begin; i < end; ++i) {
+                hits[i].mesh = MeshHandle();
+                hits[i].faceIndex = -1;
+                hits[i].distance = rays[i].tMax;
+            }
+
+            for (size_t m = 0; m < meshes.size(); ++m) {
+                const Mesh& mesh = meshes[m];
+                const MeshGeometry& geometry = *mesh.geometry;
+                if (!mesh.isVisible || !geometry.accelerator) continue;
+
+                // Object-space rays reaching the mesh, unnormalized so t values match the world rays
+                scratch.localRays.clear();
+                scratch.rayIndices.clear();
+                for (size_t i = begin; i < end; ++i) {
+                    const Ray& ray = rays[i];
+                    if (!mesh.aabb.isIntersectingRay(ray.origin, ray.direction, ray.tMin, hits[i].distance)) continue;
+                    glm::vec3 localDirection = glm::vec3(mesh.inverseModelMatrix * glm::vec4(ray.direction, 0.0f));
+                    scratch.localRays.push_back(Ray(glm::vec3(mesh.inverseModelMatrix * glm::vec4(ray.origin, 1.0f)),
+                                                    localDirection, ray.tMin, hits[i].distance));
+                    scratch.localRays.back().direction = localDirection;
+                    scratch.rayIndices.push_back(i);
+                }
+                if (scratch.localRays.empty()) continue;
+
+                scratch.hits.resize(scratch.localRays.size());
+                findClosestHits(*geometry.accelerator, scratch.localRays.data(), scratch.localRays.size(), scratch.hits.data());
+                for (size_t k = 0; k < scratch.hits.size(); ++k) {
+                    const RayHit& hit = scratch.hits[k];
+                    if (!hit.face) continue;
+                    RayIntersection& closest = hits[scratch.rayIndices[k]];
+                    closest.mesh = meshes.handleAt(m);
+                    closest.faceIndex = static_cast<int>(hit.face - geometry.faces.data());
+                    closest.distance = hit.t;
+                }
+            }
+        });
+    }
+
+    // Visible meshes with faces wholly or partly inside the screen rectangle [ndcMin, ndcMax] of the
+    // image of viewProjection (normalized device coordinates). depthLimited also bounds the volume by
+    // the near and far planes, as perspective picking is; without it the volume runs through the
+    // whole scene like orthographic picking rays.
+    // The volume culls each mesh's world AABB, a mesh wholly inside takes all its faces untested.
+    // Others walk their accelerator with the volume moved into object space: subtrees are accepted
+    // or rejected by their boxes, only faces in boxes crossing the volume's sides are clipped.
+    void findFacesInRectangle(const glm::mat4& viewProjection, const glm::vec2& ndcMin, const glm::vec2& ndcMax,
+                              bool depthLimited, std::vector<RectangleHit>& hits) const {
+        PROFILE_SCOPE("select.rectangle");
+        hits.clear();
+        Frustum worldFrustum = Frustum::fromRectangle(viewProjection, ndcMin, ndcMax, depthLimited);
+
+        for (size_t m = 0; m < meshes.size(); ++m) {
+            const Mesh& mesh = meshes[m];
+            const MeshGeometry& geometry = *mesh.geometry;
+            unsigned int planes = worldFrustum.activePlanes;
+            if (!mesh.isVisible || geometry.faces.empty() || !worldFrustum.cullBox(mesh.aabb, planes)) continue;
+
+            RectangleHit hit;
+            hit.mesh = meshes.handleAt(m);
+            if (!planes) {
+                hit.faces.resize(geometry.faces.size());
+                for (size_t i = 0; i < hit.faces.size(); ++i) hit.faces[i] = static_cast<int>(i);
+            }
+            else if (geometry.accelerator) {
+                // Faces are marked rather than listed: KD-tree leaves share faces, and reading the
+                // marks back in order sorts them
+                Frustum localFrustum = Frustum::fromRectangle(viewProjection * mesh.modelMatrix, ndcMin, ndcMax, depthLimited);
+                const Face* firstFace = geometry.faces.data();
+                std::vector<char> inside(geometry.faces.size(), 0);
+                size_t insideCount = 0;
+                visitAccelerator(*geometry.accelerator, [&](const auto& accelerator) {
+                    accelerator.forEachInFrustum(localFrustum, [&](Face* face) {
+                        char& mark = inside[face - firstFace];
+                        insideCount += !mark;
+                        mark = 1;
+                    });
+                });
+                hit.faces.reserve(insideCount);
+                for (size_t i = 0; i < inside.size(); ++i) {
+                    if (inside[i]) hit.faces.push_back(static_cast<int>(i));
+                }
+            }
+            if (!hit.faces.empty()) hits.push_back(std::move(hit));
+        }
+        PROFILE_COUNT("select.meshes", hits.size());
+    }
+
+private:
+    // Per thread buffers of findRayIntersections(), kept between calls
+    struct RaycastScratch {
+        std::vector<Ray> localRays;
+        std::vector<size_t> rayIndices;
+        std::vector<RayHit> hits;
+    };
+
+    static RaycastScratch& raycastScratch() {
+        thread_local RaycastScratch scratch;
+        return scratch;
+    }
+
+    int batchDepth;                                          // Nesting depth of beginBatch()
+    AcceleratorType acceleratorType;                         // For geometry built from now on
+    std::vector<std::weak_ptr<MeshGeometry>> pendingGeometry; // Geometry added since the last build
+    std::vector<SceneCommand> publishBuffer;                 // Reused by publishChanges()
+    std::vector<MeshHandle> changedMeshes;                   // Meshes to publish, filled by Mesh::markChanged()
+
+    // Empty mesh tracked by publishChanges(): it knows its handle and reports its edits to changedMeshes
+    MeshHandle addMesh() {
+        MeshHandle handle = meshes.emplace();
+        Mesh& mesh = *meshes.get(handle);
+        mesh.handle = handle;
+        mesh.changedMeshes = &changedMeshes;
+        changedMeshes.push_back(handle);
+        return handle;
+    }
+
+    // Thread safe for distinct geometries
+    void buildGeometryAccelerator(MeshGeometry& geometry) {
+        if (!geometry.accelerator && !geometry.faces.empty()) {
+            PROFILE_SCOPE("model.build_accelerator");
+            PROFILE_COUNT("model.accelerator_triangles", geometry.faces.size());
+            AcceleratorType type = acceleratorType == ACCELERATOR_AUTO
+                ? acceleratorSelector.choose(geometry.faces.size()) : acceleratorType;
+            std::shared_ptr<SpatialAccelerator> accelerator(SpatialAcceleratorFactory::createAccelerator(type));
+            accelerator->build(geometry.faces);
+            acceleratorSelector.recordBuild(type, accelerator->getStats());
+            std::atomic_store(&geometry.accelerator, accelerator);
+        }
+    }
+
+    // Build accelerators only for geometry added since the last build, not for the whole scene
+    void buildPendingAccelerators() {
+        std::vector<std::shared_ptr<MeshGeometry>> alive; // Keeps the geometry alive during the build
+        std::vector<MeshGeometry*> geometries;
+        for (const std::weak_ptr<MeshGeometry>& pending : pendingGeometry) {
+            // Geometry created and deleted again inside a batch has expired, skip it
+            if (std::shared_ptr<MeshGeometry> geometry = pending.lock()) {
+                geometries.push_back(geometry.get());
+                alive.push_back(std::move(geometry));
+            }
+        }
+        pendingGeometry.clear();
+        buildGeometryAccelerators(geometries);
+    }
+
+    // Build on the job system, one geometry per job. Each geometry is built once even if it is listed
+    // several times (several instances created in one batch).
+    void buildGeometryAccelerators(std::vector<MeshGeometry*>& geometries) {
+        std::sort(geometries.begin(), geometries.end());
+        geometries.erase(std::unique(geometries.begin(), geometries.end()), geometries.end());
+        JobSystem::instance().parallelFor(0, geometries.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                buildGeometryAccelerator(*geometries[i]);
+            }
+        });
+    }
+
+    // Called for every mesh added; builds right away unless a batch is open
+    void queueAcceleratorBuild(const std::shared_ptr<MeshGeometry>& geometry) {
+        if (!geometry->accelerator) {
+            pendingGeometry.push_back(geometry);
+        }
+        if (batchDepth == 0) {
+            buildPendingAccelerators();
         }
     }
 };
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "tracerecorder.h"
+
+/*
+* Scoped timers and counters for finding where frame and edit time goes.
+*
+*   PROFILE_SCOPE("render.frame");          // Times the rest of the enclosing scope
+*   PROFILE_COUNT("render.triangles", n);   // Adds n to a counter
+*
+* Each timer keeps its lifetime count and total, plus the last PROFILE_WINDOW samples for the rolling
+* min/avg/p99/max. Profiler::writeCSV() exports everything. Timers may run on any thread; a sample
+* costs two clock reads and an uncontended lock. While a TraceRecorder capture runs, every timed
+* scope is also added to the timeline.
+*
+* Build with PROFILING_ENABLED=0 and both macros expand to nothing.
+*/
+
+#ifndef PROFILING_ENABLED
+#define PROFILING_ENABLED 1
+#endif
+
+#define PROFILE_WINDOW 1024
+
+class ProfileStat {
+public:
+    struct Summary {
+        uint64_t count;    // Samples since the start
+        double totalMs;    // Time since the start
+        size_t window;     // Samples the rolling values are taken over
+        double minUs, avgUs, p99Us, maxUs; // Rolling, microseconds
+    };
+
+    // The window is allocated up front, adding samples never allocates
+    explicit ProfileStat(const std::string& name) : name(name), next(0), count(0), totalUs(0.0) {
+        window.reserve(PROFILE_WINDOW);
+    }
+
+    const std::string name;
+
+    void addSample(double microseconds) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (window.size() < PROFILE_WINDOW) window.push_back(static_cast<float>(microseconds));
+        else window[next] = static_cast<float>(microseconds);
+        next = (next + 1) % PROFILE_WINDOW;
+        count++;
+        totalUs += microseconds;
+    }
+
+    Summary summarize() const {
+        std::vector<float> samples;
+        Summary summary;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            samples = window;
+            summary.count = count;
+            summary.totalMs = totalUs / 1000.0;
+        }
+        summary.window = samples.size();
+        summary.minUs = summary.avgUs = summary.p99Us = summary.maxUs = 0.0;
+        if (samples.empty()) return summary;
+
+        double sum = 0.0;
+        for (float sample : samples) sum += sample;
+        summary.avgUs = sum / samples.size();
+        summary.minUs = *std::min_element(samples.begin(), samples.end());
+        summary.maxUs = *std::max_element(samples.begin(), samples.end());
+        size_t rank = std::min(samples.size() - 1, samples.size() * 99 / 100);
+        std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+        summary.p99Us = samples[rank];
+        return summary;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        window.clear();
+        next = 0;
+        count = 0;
+        totalUs = 0.0;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::vector<float> window; // Ring buffer of the latest samples, microseconds
+    size_t next;               // Slot the next sample overwrites
+    uint64_t count;
+    double totalUs;
+};
+
+class ProfileCounter {
+public:
+    explicit ProfileCounter(const std::string& name) : name(name), value(0) {}
+
+    const std::string name;
+
+    void add(uint64_t amount) {
+        value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint64_t get() const {
+        return value.load(std::memory_order_relaxed);
+    }
+
+    void reset() {
+        value.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> value;
+};
+
+// Registry of every timer and counter. Entries are created on first use and never move.
+class Profiler {
+public:
+    static Profiler& instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    ProfileStat& stat(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (ProfileStat& existing : stats) {
+            if (existing.name == name) return existing;
+        }
+        stats.emplace_back(name);
+        return stats.back();
+    }
+
+    ProfileCounter& counter(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (ProfileCounter& existing : counters) {
+            if (existing.name == name) return existing;
+        }
+        counters.emplace_back(name);
+        return counters.back();
+    }
+
+    // One row per timer and counter. Counters only fill count.
+    void writeCSV(std::ostream& out) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        out << "name,kind,count,total_ms,window,min_us,avg_us,p99_us,max_us\n";
+        for (const ProfileStat& stat : stats) {
+            ProfileStat::Summary summary = stat.summarize();
+            out << stat.name << ",timer," << summary.count << ',' << summary.totalMs << ',' << summary.window << ','
+                << summary.minUs << ',' << summary.avgUs << ',' << summary.p99Us << ',' << summary.maxUs << '\n';
+        }
+        for (const ProfileCounter& counter : counters) {
+            out << counter.name << ",counter," << counter.get() << ",,,,,,\n";
+        }
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (ProfileStat& stat : stats) stat.reset();
+        for (ProfileCounter& counter : counters) counter.reset();
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::deque<ProfileStat> stats;       // deque: references stay valid as entries are added
+    std::deque<ProfileCounter> counters;
+
+    Profiler() {}
+};
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(ProfileStat& stat) : stat(stat), start(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        stat.addSample(std::chrono::duration<double, std::micro>(end - start).count());
+#if TRACING_ENABLED
+        TraceRecorder& recorder = TraceRecorder::instance();
+        if (recorder.isCapturing()) {
+            recorder.record(stat.name.c_str(), start, end);
+        }
+#endif
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    ProfileStat& stat;
+    std::chrono::steady_clock::time_point start;
+};
+
+#if PROFILING_ENABLED
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// The registry lookup happens once per call site, later calls use the cached reference
+#define PROFILE_SCOPE(name) \
+    static ProfileStat& PROFILE_CONCAT(profileStat, __LINE__) = Profiler::instance().stat(name); \
+    ScopedTimer PROFILE_CONCAT(profileTimer, __LINE__)(PROFILE_CONCAT(profileStat, __LINE__))
+#define PROFILE_COUNT(name, amount) \
+    do { \
+        static ProfileCounter& profileCounter = Profiler::instance().counter(name); \
+        profileCounter.add(amount); \
+    } while (0)
+#else
+#define PROFILE_SCOPE(name) do {} while (0)
+#define PROFILE_COUNT(name, amount) do {} while (0)
+#endif
@@ -1,4 +1,4 @@
-#include "ProjectionSystem.h"
+#include "projectionsystem.h"
 #include <glm/gtc/matrix_transform.hpp>
 
 PerspectiveProj::PerspectiveProj(float fov, float aspect, float nearPlane, float farPlane)
@@ -0,0 +1,444 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <glm/glm.hpp>
+#include "Mesh.h"
+#include "acceleratortraversal.h"
+#include "ray.h"
+#include "spacialaccelerator.h"
+
+/*
+* Closest-hit queries for batches of rays, traced in packets of 4, 8 or 16.
+*
+*   std::vector<RayHit> hits(rays.size());
+*   findClosestHits(*geometry.accelerator, rays.data(), rays.size(), hits.data());
+*
+* A packet walks the accelerator's box hierarchy once for all its rays: every node box is tested
+* against four rays at a time with SSE slab tests, and every leaf triangle against four rays at a time.
+* Each stack entry carries the mask of rays that reached it, so rays that left the packet's path cost
+* nothing further. Each ray's tMax shrinks to its closest hit so far, and the child nearer along the
+* packet's mean direction is visited first.
+*
+* Packets only pay off for coherent rays: neighbouring pixels of a camera, a region pick, thickness
+* samples along one direction. Rays should come in that order. A packet whose directions do not agree
+* in sign on every axis, or spread wider than RAY_PACKET_COHERENCE, is traced one ray at a time. While
+* tracing, a node or leaf only one ray still reaches is tested with the single ray code.
+*
+* The packet is bounded by the interval of its origins and inverse directions. A node box that this
+* frustum misses is skipped with one scalar test instead of a test per ray. The bound is conservative:
+* packets find the same closest distances as single rays.
+*
+* Packets walk box hierarchies (BVH, LBVH). KD-tree batches are traced ray by ray: its traversal clips
+* each ray at the split planes, which the packet's box tests do not.
+*/
+
+// SSE is part of every x64 target and enabled by default for x86 by MSVC
+#ifndef RAY_PACKET_SSE
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define RAY_PACKET_SSE 1
+#else
+#define RAY_PACKET_SSE 0
+#endif
+#endif
+
+#if RAY_PACKET_SSE
+#include <xmmintrin.h>
+#endif
+
+#define RAY_PACKET_SIZE 8          // Default rays per packet: 1 (no packets), 4, 8 or 16
+#define RAY_PACKET_COHERENCE 0.9f  // Smallest cosine between a ray and the packet's mean direction
+
+// Closest hit of one ray. face is null, and t the ray's tMax, if nothing is hit.
+struct RayHit {
+    Face* face = nullptr;
+    float t = FLT_MAX; // Distance along the ray, in units of its direction
+};
+
+#if RAY_PACKET_SSE
+
+// Four float lanes and the comparison masks over them
+struct Lane4 {
+    __m128 v;
+
+    Lane4() {}
+    explicit Lane4(__m128 v) : v(v) {}
+    explicit Lane4(float value) : v(_mm_set1_ps(value)) {}
+    static Lane4 load(const float* values) { return Lane4(_mm_loadu_ps(values)); }
+    void store(float* values) const { _mm_storeu_ps(values, v); }
+
+    friend Lane4 operator+(Lane4 a, Lane4 b) { return Lane4(_mm_add_ps(a.v, b.v)); }
+    friend Lane4 operator-(Lane4 a, Lane4 b) { return Lane4(_mm_sub_ps(a.v, b.v)); }
+    friend Lane4 operator*(Lane4 a, Lane4 b) { return Lane4(_mm_mul_ps(a.v, b.v)); }
+    friend Lane4 operator/(Lane4 a, Lane4 b) { return Lane4(_mm_div_ps(a.v, b.v)); }
+    friend Lane4 min(Lane4 a, Lane4 b) { return Lane4(_mm_min_ps(a.v, b.v)); }
+    friend Lane4 max(Lane4 a, Lane4 b) { return Lane4(_mm_max_ps(a.v, b.v)); }
+
+    // One bit per lane
+    friend int lessEqual(Lane4 a, Lane4 b) { return _mm_movemask_ps(_mm_cmple_ps(a.v, b.v)); }
+    friend int less(Lane4 a, Lane4 b) { return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v)); }
+};
+
+#else
+
+struct Lane4 {
+    float v[4];
+
+    Lane4() {}
+    explicit Lane4(float value) { v[0] = v[1] = v[2] = v[3] = value; }
+    static Lane4 load(const float* values) { Lane4 lanes; std::copy(values, values + 4, lanes.v); return lanes; }
+    void store(float* values) const { std::copy(v, v + 4, values); }
+
+    template <typename Op>
+    static Lane4 apply(Lane4 a, Lane4 b, Op op) {
+        Lane4 lanes;
+        for (int i = 0; i < 4; ++i) lanes.v[i] = op(a.v[i], b.v[i]);
+        return lanes;
+    }
+    friend Lane4 operator+(Lane4 a, Lane4 b) { return apply(a, b, [](float x, float y) { return x + y; }); }
+    friend Lane4 operator-(Lane4 a, Lane4 b) { return apply(a, b, [](float x, float y) { return x - y; }); }
+    friend Lane4 operator*(Lane4 a, Lane4 b) { return apply(a, b, [](float x, float y) { return x * y; }); }
+    friend Lane4 operator/(Lane4 a, Lane4 b) { return apply(a, b, [](float x, float y) { return x / y; }); }
+    friend Lane4 min(Lane4 a, Lane4 b) { return apply(a, b, [](float x, float y) { return x < y ? x : y; }); }
+    friend Lane4 max(Lane4 a, Lane4 b) { return apply(a, b, [](float x, float y) { return x > y ? x : y; }); }
+
+    friend int lessEqual(Lane4 a, Lane4 b) {
+        int mask = 0;
+        for (int i = 0; i < 4; ++i) mask |= (a.v[i] <= b.v[i]) << i;
+        return mask;
+    }
+    friend int less(Lane4 a, Lane4 b) {
+        int mask = 0;
+        for (int i = 0; i < 4; ++i) mask |= (a.v[i] < b.v[i]) << i;
+        return mask;
+    }
+};
+
+#endif
+
+// Up to N rays in structure of arrays form. Lanes past count never hit anything.
+template <int N>
+class RayPacket {
+public:
+    static_assert(N == 4 || N == 8 || N == 16, "Packets hold 4, 8 or 16 rays");
+    static const int groups = N / 4;
+
+    float origin[3][N];
+    float direction[3][N];
+    float inverse[3][N];  // 1 / direction, FLT_MAX for zero components like AABB::isIntersectingRay
+    float tMin[N];
+    float tMax[N];        // Lowered to the closest hit found so far
+    Face* hit[N];
+    int count;
+
+    RayPacket(const Ray* rays, int count) : count(count) {
+        for (int lane = 0; lane < N; ++lane) {
+            hit[lane] = nullptr;
+            if (lane >= count) {
+                for (int axis = 0; axis < 3; ++axis) origin[axis][lane] = direction[axis][lane] = inverse[axis][lane] = 0.0f;
+                tMin[lane] = 1.0f;
+                tMax[lane] = 0.0f;
+                continue;
+            }
+            const Ray& ray = rays[lane];
+            for (int axis = 0; axis < 3; ++axis) {
+                origin[axis][lane] = ray.origin[axis];
+                direction[axis][lane] = ray.direction[axis];
+                inverse[axis][lane] = ray.direction[axis] != 0.0f ? 1.0f / ray.direction[axis] : FLT_MAX;
+            }
+            tMin[lane] = ray.tMin;
+            tMax[lane] = ray.tMax;
+        }
+    }
+
+    int laneMask() const {
+        return static_cast<int>((1u << count) - 1);
+    }
+
+    glm::vec3 laneOrigin(int lane) const { return glm::vec3(origin[0][lane], origin[1][lane], origin[2][lane]); }
+    glm::vec3 laneDirection(int lane) const { return glm::vec3(direction[0][lane], direction[1][lane], direction[2][lane]); }
+
+    // Directions agree in sign on every axis and lie in a narrow cone. Also sets up the frustum bounds.
+    bool isCoherent() {
+        glm::vec3 mean(0.0f);
+        for (int lane = 0; lane < count; ++lane) mean += glm::normalize(laneDirection(lane));
+        if (glm::length(mean) == 0.0f) return false;
+        mean = glm::normalize(mean);
+        meanDirection = mean;
+        for (int lane = 0; lane < count; ++lane) {
+            if (!(glm::dot(glm::normalize(laneDirection(lane)), mean) >= RAY_PACKET_COHERENCE)) return false;
+        }
+
+        frustumTMin = FLT_MAX;
+        frustumTMax = -FLT_MAX;
+        for (int lane = 0; lane < count; ++lane) {
+            frustumTMin = std::min(frustumTMin, tMin[lane]);
+            frustumTMax = std::max(frustumTMax, tMax[lane]);
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            positive[axis] = inverse[axis][0] > 0.0f;
+            originLow[axis] = inverseLow[axis] = FLT_MAX;
+            originHigh[axis] = inverseHigh[axis] = -FLT_MAX;
+            for (int lane = 0; lane < count; ++lane) {
+                if ((inverse[axis][lane] > 0.0f) != positive[axis]) return false;
+                originLow[axis] = std::min(originLow[axis], origin[axis][lane]);
+                originHigh[axis] = std::max(originHigh[axis], origin[axis][lane]);
+                inverseLow[axis] = std::min(inverseLow[axis], inverse[axis][lane]);
+                inverseHigh[axis] = std::max(inverseHigh[axis], inverse[axis][lane]);
+            }
+        }
+        return true;
+    }
+
+    // True if no ray of a coherent packet can hit the box: bounds of every ray's slab entry and exit
+    // from the corners of the origin and inverse direction intervals
+    bool frustumMisses(const AABB& box) const {
+        float enter = frustumTMin;
+        float exit = frustumTMax;
+        for (int axis = 0; axis < 3; ++axis) {
+            float nearPlane = positive[axis] ? box.min[axis] : box.max[axis];
+            float farPlane = positive[axis] ? box.max[axis] : box.min[axis];
+            float nearLow = nearPlane - originHigh[axis], nearHigh = nearPlane - originLow[axis];
+            float farLow = farPlane - originHigh[axis], farHigh = farPlane - originLow[axis];
+            enter = std::max(enter, std::min({ nearLow * inverseLow[axis], nearLow * inverseHigh[axis],
+                                               nearHigh * inverseLow[axis], nearHigh * inverseHigh[axis] }));
+            exit = std::min(exit, std::max({ farLow * inverseLow[axis], farLow * inverseHigh[axis],
+                                             farHigh * inverseLow[axis], farHigh * inverseHigh[axis] }));
+        }
+        return enter > exit;
+    }
+
+    // Rays of lanes that hit the box, four lanes per group, the same test as AABB::isIntersectingRay
+    int boxMask(const AABB& box, int mask) const {
+        int hits = 0;
+        for (int group = 0; group < groups; ++group) {
+            if (((mask >> (group * 4)) & 0xF) == 0) continue;
+            int first = group * 4;
+            Lane4 enter = Lane4::load(tMin + first);
+            Lane4 exit = Lane4::load(tMax + first);
+            for (int axis = 0; axis < 3; ++axis) {
+                Lane4 start = Lane4::load(origin[axis] + first);
+                Lane4 inv = Lane4::load(inverse[axis] + first);
+                Lane4 t1 = (Lane4(box.min[axis]) - start) * inv;
+                Lane4 t2 = (Lane4(box.max[axis]) - start) * inv;
+                enter = max(enter, min(t1, t2));
+                exit = min(exit, max(t1, t2));
+            }
+            hits |= lessEqual(enter, exit) << first;
+        }
+        return hits & mask;
+    }
+
+    // Möller-Trumbore for the masked lanes, keeping hits closer than each lane's tMax. The same steps
+    // as Face::intersectRay, starting with the face's bounding box.
+    void intersect(Face* face, int mask) {
+        mask = boxMask(face->boundingBox, mask);
+        if (mask == 0) return;
+
+        const glm::vec3& a = face->vertices[0];
+        glm::vec3 e1 = face->vertices[1] - a;
+        glm::vec3 e2 = face->vertices[2] - a;
+        Lane4 edge1[3] = { Lane4(e1.x), Lane4(e1.y), Lane4(e1.z) };
+        Lane4 edge2[3] = { Lane4(e2.x), Lane4(e2.y), Lane4(e2.z) };
+        Lane4 zero(0.0f), one(1.0f), epsilon(FLT_EPSILON), negativeEpsilon(-FLT_EPSILON);
+
+        for (int group = 0; group < groups; ++group) {
+            int first = group * 4;
+            int lanes = (mask >> first) & 0xF;
+            if (lanes == 0) continue;
+            Lane4 d[3] = { Lane4::load(direction[0] + first), Lane4::load(direction[1] + first), Lane4::load(direction[2] + first) };
+            Lane4 s[3] = { Lane4::load(origin[0] + first) - Lane4(a.x), Lane4::load(origin[1] + first) - Lane4(a.y),
+                           Lane4::load(origin[2] + first) - Lane4(a.z) };
+
+            Lane4 h[3] = { d[1] * edge2[2] - edge2[1] * d[2], d[2] * edge2[0] - edge2[2] * d[0], d[0] * edge2[1] - edge2[0] * d[1] };
+            Lane4 det = edge1[0] * h[0] + edge1[1] * h[1] + edge1[2] * h[2];
+            lanes &= ~(less(negativeEpsilon, det) & less(det, epsilon));
+            if (lanes == 0) continue;
+
+            Lane4 invDet = one / det;
+            Lane4 u = (s[0] * h[0] + s[1] * h[1] + s[2] * h[2]) * invDet;
+            lanes &= lessEqual(zero, u) & lessEqual(u, one);
+            if (lanes == 0) continue;
+
+            Lane4 q[3] = { s[1] * edge1[2] - edge1[1] * s[2], s[2] * edge1[0] - edge1[2] * s[0], s[0] * edge1[1] - edge1[0] * s[1] };
+            Lane4 v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * invDet;
+            lanes &= lessEqual(zero, v) & lessEqual(u + v, one);
+            if (lanes == 0) continue;
+
+            Lane4 t = (edge2[0] * q[0] + edge2[1] * q[1] + edge2[2] * q[2]) * invDet;
+            Lane4 bestT = Lane4::load(tMax + first);
+            lanes &= lessEqual(Lane4::load(tMin + first), t) & lessEqual(t, bestT);
+            if (lanes == 0) continue;
+
+            float distances[4];
+            t.store(distances);
+            for (int lane = 0; lane < 4; ++lane) {
+                if (lanes & (1 << lane)) accept(first + lane, face, distances[lane]);
+            }
+        }
+    }
+
+    // True if box a lies before box b along the packet's mean direction, set by isCoherent()
+    bool isBefore(const AABB& a, const AABB& b) const {
+        return glm::dot(a.min + a.max, meanDirection) <= glm::dot(b.min + b.max, meanDirection);
+    }
+
+    // Single ray path for a lane the rest of the packet has left
+    bool laneHitsBox(int lane, const AABB& box) const {
+        return box.isIntersectingRay(laneOrigin(lane), laneDirection(lane), tMin[lane], tMax[lane]);
+    }
+
+    void laneIntersect(int lane, Face* face) {
+        float t;
+        if (face->intersectRay(laneOrigin(lane), laneDirection(lane), tMin[lane], tMax[lane], t)) accept(lane, face, t);
+    }
+
+private:
+    // Frustum bounds, set by isCoherent()
+    bool positive[3];
+    float originLow[3], originHigh[3];
+    float inverseLow[3], inverseHigh[3];
+    float frustumTMin, frustumTMax;
+    glm::vec3 meanDirection;
+
+    // The first hit at a distance is kept, like the single ray query
+    void accept(int lane, Face* face, float t) {
+        if (hit[lane] && t >= tMax[lane]) return;
+        hit[lane] = face;
+        tMax[lane] = t;
+    }
+};
+
+inline int lowestLane(int mask) {
+    int lane = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        lane++;
+    }
+    return lane;
+}
+
+// Walk a box hierarchy with a coherent packet, see traverseBoxTree for the Layout
+template <int N, typename Layout>
+inline void tracePacket(const Layout& layout, RayPacket<N>& packet) {
+    static_assert(Layout::maxDepth + 2 <= TRAVERSAL_STACK_SIZE, "Tree deeper than the traversal stack");
+    typedef typename Layout::NodeRef NodeRef;
+    struct StackEntry {
+        NodeRef node;
+        int mask; // Lanes that reached the node
+    };
+
+    if (layout.empty()) return;
+
+    StackEntry stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = StackEntry{ layout.root(), packet.laneMask() };
+    while (top > 0) {
+        StackEntry entry = stack[--top];
+        const AABB& box = layout.box(entry.node);
+        int mask;
+        if ((entry.mask & (entry.mask - 1)) == 0) {
+            mask = packet.laneHitsBox(lowestLane(entry.mask), box) ? entry.mask : 0;
+        }
+        else {
+            if (packet.frustumMisses(box)) continue;
+            mask = packet.boxMask(box, entry.mask);
+        }
+        if (mask == 0) continue;
+
+        if (layout.isLeaf(entry.node)) {
+            Face* const* end = layout.leafEnd(entry.node);
+            bool single = (mask & (mask - 1)) == 0;
+            int lane = single ? lowestLane(mask) : 0;
+            for (Face* const* face = layout.leafBegin(entry.node); face != end; ++face) {
+                if (single) packet.laneIntersect(lane, *face);
+                else packet.intersect(*face, mask);
+            }
+            continue;
+        }
+
+        NodeRef first, second;
+        layout.children(entry.node, first, second);
+        // Nearer child first, its hits lower tMax before the other child is tested
+        if (!packet.isBefore(layout.box(first), layout.box(second))) std::swap(first, second);
+        stack[top++] = StackEntry{ second, mask };
+        stack[top++] = StackEntry{ first, mask };
+    }
+}
+
+// Closest hit of one ray through the accelerator's forEachHit(), the hit distance bounding the rest
+// of the walk. Returns false if nothing is hit.
+template <typename Accelerator>
+inline bool findClosestHit(const Accelerator& accelerator, const Ray& ray, RayHit& hit) {
+    Ray clipped = ray; // tMax lowered as hits are found, the traversal reads it for every test
+    float t = 0.0f;
+    hit = RayHit();
+    accelerator.forEachHit(clipped,
+        [&t](const Face& face, const Ray& query) { return face.intersectRay(query.origin, query.direction, query.tMin, query.tMax, t); },
+        [&](Face* face) {
+            if (hit.face && t >= hit.t) return;
+            hit.face = face;
+            hit.t = t;
+            clipped.tMax = t;
+        });
+    if (!hit.face) hit.t = ray.tMax;
+    return hit.face != nullptr;
+}
+
+// Closest face of a mesh hit by a world-space ray closer than maxDistance. accelerator is the one
+// built over the mesh's geometry; it is walked in object space with the ray left unnormalized, so
+// hit.t is a distance along the world ray.
+inline bool findClosestMeshHit(const Mesh& mesh, const SpatialAccelerator& accelerator, const Ray& ray, float maxDistance,
+                               RayHit& hit) {
+    hit = RayHit();
+    if (!mesh.aabb.isIntersectingRay(ray.origin, ray.direction, ray.tMin, maxDistance)) return false;
+    glm::vec3 localDirection = glm::vec3(mesh.inverseModelMatrix * glm::vec4(ray.direction, 0.0f));
+    Ray localRay(glm::vec3(mesh.inverseModelMatrix * glm::vec4(ray.origin, 1.0f)), localDirection, ray.tMin, maxDistance);
+    localRay.direction = localDirection;
+    bool found = false;
+    visitAccelerator(accelerator, [&](const auto& typed) { found = findClosestHit(typed, localRay, hit); });
+    return found;
+}
+
+template <int N, typename Accelerator>
+inline void findClosestHitsInPackets(const Accelerator& accelerator, const Ray* rays, size_t count, RayHit* hits) {
+    typename Accelerator::Layout layout(accelerator);
+    for (size_t first = 0; first < count; first += N) {
+        int packetCount = static_cast<int>(std::min<size_t>(N, count - first));
+        RayPacket<N> packet(rays + first, packetCount);
+        if (packetCount == 1 || !packet.isCoherent()) {
+            for (int lane = 0; lane < packetCount; ++lane) findClosestHit(accelerator, rays[first + lane], hits[first + lane]);
+            continue;
+        }
+        tracePacket(layout, packet);
+        for (int lane = 0; lane < packetCount; ++lane) {
+            hits[first + lane].face = packet.hit[lane];
+            hits[first + lane].t = packet.tMax[lane];
+        }
+    }
+}
+
+// Closest hit of rays[i] in hits[i], rays taken packetSize at a time (4, 8 or 16; 1 traces every ray
+// on its own)
+template <typename Accelerator>
+inline void findClosestHits(const Accelerator& accelerator, const Ray* rays, size_t count, RayHit* hits,
+                            int packetSize = RAY_PACKET_SIZE) {
+    switch (packetSize) {
+        case 4: findClosestHitsInPackets<4>(accelerator, rays, count, hits); break;
+        case 8: findClosestHitsInPackets<8>(accelerator, rays, count, hits); break;
+        case 16: findClosestHitsInPackets<16>(accelerator, rays, count, hits); break;
+        default:
+            for (size_t i = 0; i < count; ++i) findClosestHit(accelerator, rays[i], hits[i]);
+            break;
+    }
+}
+
+inline void findClosestHits(const KDTree& tree, const Ray* rays, size_t count, RayHit* hits, int = RAY_PACKET_SIZE) {
+    for (size_t i = 0; i < count; ++i) findClosestHit(tree, rays[i], hits[i]);
+}
+
+// For callers holding the base class: one type switch per batch
+inline void findClosestHits(const SpatialAccelerator& accelerator, const Ray* rays, size_t count, RayHit* hits,
+                            int packetSize = RAY_PACKET_SIZE) {
+    visitAccelerator(accelerator, [&](const auto& typed) { findClosestHits(typed, rays, count, hits, packetSize); });
+}
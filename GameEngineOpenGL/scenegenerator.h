@@ -0,0 +1,234 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "jobsystem.h"
+#include "model.h"
+
+/*
+* Deterministic synthetic scenes for benchmarks and scaling tests.
+*
+* A scene is an assembly of built-in primitive instances plus procedural high resolution
+* heightfield meshes (each placed several times, sharing its geometry). The same options and seed
+* always give the same scene. Random numbers come from std::mt19937, whose output is fixed by the
+* standard, and are turned into floats here instead of through the library's distributions, whose
+* output is not; so placements are the same with every compiler. Heights go through std::sin and may
+* differ in the last bit between C runtimes.
+*
+* Distributions:
+*   UNIFORM   instances spread evenly through a cube
+*   CLUSTERED instances packed around a few centres, leaving most of the cube empty
+*   THIN      uniform placement, but heightfield cells are stretched so every procedural triangle
+*             is long and thin (the hard case for both accelerators)
+*
+* Procedural geometry is shared between its instances, so 100 million triangles is e.g. ten
+* 1M triangle meshes placed ten times each, and costs memory for ten meshes.
+*/
+
+enum SceneDistribution {
+    SCENE_UNIFORM,
+    SCENE_CLUSTERED,
+    SCENE_THIN
+};
+
+struct SceneGeneratorOptions {
+    uint32_t seed = 1;
+    SceneDistribution distribution = SCENE_UNIFORM;
+    float extent = 100.0f;             // Scene cube half size
+    size_t primitiveInstances = 1000;  // Cubes, spheres, tori...
+    size_t proceduralMeshes = 0;       // Distinct heightfield geometries
+    size_t proceduralTriangles = 100000; // Triangles in each heightfield
+    size_t proceduralInstances = 1;    // Placements of each heightfield
+    size_t clusterCount = 8;           // CLUSTERED only
+    float thinAspect = 200.0f;         // THIN only, length:width of a heightfield cell
+};
+
+class SceneGenerator {
+public:
+    // Add the scene to the model. Runs as one batch, every new accelerator is built once at the end.
+    // Returns the number of triangles added.
+    static uint64_t generate(Model& model, const SceneGeneratorOptions& options) {
+        Random random(options.seed);
+        uint64_t triangles = 0;
+
+        std::vector<glm::vec3> clusters;
+        for (size_t c = 0; c < options.clusterCount; ++c) {
+            clusters.push_back(random.pointInCube(options.extent * 0.8f));
+        }
+
+        model.beginBatch(options.primitiveInstances + options.proceduralMeshes * options.proceduralInstances);
+
+        typedef MeshHandle (Model::*PrimitiveCreate)(int, int, int);
+        static const PrimitiveCreate primitives[] = {
+            &Model::createCube, &Model::createPyramid, &Model::createCylinder, &Model::createSphere,
+            &Model::createCone, &Model::createTorus, &Model::createPlane, &Model::createCircle
+        };
+        const size_t primitiveKinds = sizeof(primitives) / sizeof(primitives[0]);
+
+        for (size_t i = 0; i < options.primitiveInstances; ++i) {
+            PrimitiveCreate create = primitives[random.next() % primitiveKinds];
+            MeshHandle handle = (model.*create)(0, 0, 0);
+            Mesh& mesh = *model.meshes.get(handle);
+            float scale = 0.5f + random.uniform() * 2.5f;
+            place(mesh, placement(random, options, clusters), random, glm::vec3(scale));
+            triangles += mesh.geometry->indices.size() / 3;
+        }
+
+        for (size_t p = 0; p < options.proceduralMeshes; ++p) {
+            uint32_t meshSeed = random.next();
+            float aspect = options.distribution == SCENE_THIN ? options.thinAspect : 1.0f;
+            std::shared_ptr<MeshGeometry> geometry = createHeightfield(options.proceduralTriangles, meshSeed, aspect);
+            for (size_t i = 0; i < options.proceduralInstances; ++i) {
+                MeshHandle handle = model.createInstance(geometry, 0, 0, 0);
+                Mesh& mesh = *model.meshes.get(handle);
+                mesh.objectName = "Heightfield " + std::to_string(p);
+                mesh.objectType = "Procedural";
+                float scale = options.extent * (0.05f + random.uniform() * 0.15f);
+                place(mesh, placement(random, options, clusters), random, glm::vec3(scale));
+                triangles += geometry->indices.size() / 3;
+            }
+        }
+
+        model.commitBatch();
+        return triangles;
+    }
+
+    // Unit square heightfield in XZ with roughly the requested number of triangles.
+    // aspect > 1 makes the cells that much longer along X than along Z.
+    // Heights are a seeded sum of sine waves evaluated per vertex, so rows are generated in parallel.
+    static std::shared_ptr<MeshGeometry> createHeightfield(size_t triangles, uint32_t seed, float aspect = 1.0f) {
+        // cells = triangles / 2, columns / rows = 1 / aspect
+        size_t cells = std::max<size_t>(1, triangles / 2);
+        size_t rows = std::max<size_t>(1, static_cast<size_t>(std::sqrt(cells * static_cast<double>(aspect))));
+        size_t columns = std::max<size_t>(1, cells / rows);
+
+        Random random(seed);
+        const int waveCount = 6;
+        float frequencyX[waveCount], frequencyZ[waveCount], phase[waveCount], amplitude[waveCount];
+        for (int w = 0; w < waveCount; ++w) {
+            frequencyX[w] = 1.0f + random.uniform() * 12.0f;
+            frequencyZ[w] = 1.0f + random.uniform() * 12.0f;
+            phase[w] = random.uniform() * 6.2831853f;
+            amplitude[w] = 0.1f / (w + 1);
+        }
+
+        size_t vertexColumns = columns + 1;
+        size_t vertexCount = (rows + 1) * vertexColumns;
+        std::vector<float> vertices(vertexCount * 3);
+        std::vector<float> colors(vertexCount * 3);
+        std::vector<unsigned int> indices(rows * columns * 6);
+
+        JobSystem::instance().parallelFor(0, rows + 1, 64, [&](size_t firstRow, size_t lastRow) {
+            for (size_t r = firstRow; r < lastRow; ++r) {
+                float z = static_cast<float>(r) / rows - 0.5f;
+                for (size_t c = 0; c < vertexColumns; ++c) {
+                    float x = static_cast<float>(c) / columns - 0.5f;
+                    float y = 0.0f;
+                    for (int w = 0; w < waveCount; ++w) {
+                        y += amplitude[w] * std::sin(frequencyX[w] * x + frequencyZ[w] * z + phase[w]);
+                    }
+                    size_t v = (r * vertexColumns + c) * 3;
+                    vertices[v] = x;
+                    vertices[v + 1] = y;
+                    vertices[v + 2] = z;
+                    colors[v] = 0.4f + y;
+                    colors[v + 1] = 0.6f;
+                    colors[v + 2] = 0.4f - y;
+                }
+                if (r == rows) continue;
+                for (size_t c = 0; c < columns; ++c) {
+                    unsigned int a = static_cast<unsigned int>(r * vertexColumns + c);
+                    unsigned int b = a + 1;
+                    unsigned int d = static_cast<unsigned int>(a + vertexColumns);
+                    unsigned int e = d + 1;
+                    unsigned int* cell = &indices[(r * columns + c) * 6];
+                    cell[0] = a; cell[1] = d; cell[2] = b;
+                    cell[3] = b; cell[4] = d; cell[5] = e;
+                }
+            }
+        });
+
+        return MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+    }
+
+    static const char* distributionName(SceneDistribution distribution) {
+        switch (distribution) {
+            case SCENE_CLUSTERED: return "clustered";
+            case SCENE_THIN: return "thin";
+            default: return "uniform";
+        }
+    }
+
+    static bool parseDistribution(const std::string& name, SceneDistribution& distribution) {
+        if (name == "uniform") distribution = SCENE_UNIFORM;
+        else if (name == "clustered") distribution = SCENE_CLUSTERED;
+        else if (name == "thin") distribution = SCENE_THIN;
+        else return false;
+        return true;
+    }
+
+private:
+    // Platform independent random numbers on top of mt19937
+    class Random {
+    public:
+        explicit Random(uint32_t seed) : engine(seed) {}
+
+        uint32_t next() {
+            return static_cast<uint32_t>(engine());
+        }
+
+        // [0, 1) with 24 bits, exactly representable as float
+        float uniform() {
+            return (next() >> 8) * (1.0f / 16777216.0f);
+        }
+
+        float symmetric() {
+            return uniform() * 2.0f - 1.0f;
+        }
+
+        // Standard normal (Box-Muller)
+        float normal() {
+            float u = std::max(uniform(), 1e-7f);
+            float v = uniform();
+            return std::sqrt(-2.0f * std::log(u)) * std::cos(6.2831853f * v);
+        }
+
+        glm::vec3 pointInCube(float halfSize) {
+            float x = symmetric() * halfSize;
+            float y = symmetric() * halfSize;
+            float z = symmetric() * halfSize;
+            return glm::vec3(x, y, z);
+        }
+
+    private:
+        std::mt19937 engine;
+    };
+
+    static glm::vec3 placement(Random& random, const SceneGeneratorOptions& options, const std::vector<glm::vec3>& clusters) {
+        if (options.distribution != SCENE_CLUSTERED || clusters.empty()) {
+            return random.pointInCube(options.extent);
+        }
+        const glm::vec3& centre = clusters[random.next() % clusters.size()];
+        float spread = options.extent * 0.05f;
+        float x = random.normal() * spread;
+        float y = random.normal() * spread;
+        float z = random.normal() * spread;
+        return centre + glm::vec3(x, y, z);
+    }
+
+    static void place(Mesh& mesh, const glm::vec3& position, Random& random, const glm::vec3& scale) {
+        mesh.centerX = position.x;
+        mesh.centerY = position.y;
+        mesh.centerZ = position.z;
+        mesh.rotationX = random.uniform() * 360.0f;
+        mesh.rotationY = random.uniform() * 360.0f;
+        mesh.rotationZ = random.uniform() * 360.0f;
+        mesh.applyScale(scale.x, scale.y, scale.z);
+        mesh.updateMesh();
+    }
+};
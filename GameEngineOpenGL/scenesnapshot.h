@@ -0,0 +1,323 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "camera.h"
+#include "Mesh.h"
+#include "projectionsystem.h"
+#include "raypacket.h"
+
+/*
+* Scene hand-off between the UI thread and the render thread.
+*
+* The UI thread owns Model and edits it freely. After handling a message it publishes what changed
+* as commands: a mesh copy for every mesh whose revision moved, a removal for every deleted mesh,
+* and the latest camera. Published meshes are immutable (shared_ptr<const Mesh>) and a mesh copy
+* only copies transforms and flags, the vertex buffers stay shared with the UI's mesh. If the UI
+* later edits those buffers, Mesh::editGeometry sees the extra reference and copies first (copy-on-write),
+* so the render thread never observes a half written buffer.
+*
+* The render thread takes the pending commands at the start of a frame and applies them to its
+* SceneSnapshot, then draws only from the snapshot. The two threads share nothing but the queue.
+*
+* Frames are drawn on demand. The render thread sleeps in waitForFrame() until something that
+* changes the image is published: a mesh edit, a camera that renders differently, a new window
+* size, a cursor move over the view or an explicit redraw request (e.g. WM_PAINT). An idle editor
+* draws nothing.
+*
+* Hover pre-selection is picked on the render thread from the snapshot: the UI thread only pushes
+* the latest cursor position, and each frame picks once for it. Any number of mouse moves between
+* two frames costs one pick, and the UI thread never waits for one. The rectangle of a rectangle
+* selection in progress is handed over the same way, as the latest corners only.
+*/
+
+// Projection for a camera and window size, shared by Model (picking) and the render thread
+inline std::unique_ptr<ViewProjMethodGLM> createCameraProjection(const Camera& camera, int width, int height) {
+    // Update the aspect ratio based on the window size
+    float aspect = float(width) / float(height);
+
+    if (camera.mode == PERSPECTIVE_MODE) {
+        return std::make_unique<PerspectiveProj>(camera.zoom, aspect, camera.nearPlane, camera.farPlane);
+    }
+
+    float orthoZoom = 1.0f / camera.zoom;
+
+    // For orthographic projection, we need to ensure the near and far planes
+    // are set appropriately to prevent depth clipping issues
+    float nearOrtho = -camera.farPlane;  // Use a negative near plane for orthographic to ensure objects aren't clipped
+    float farOrtho = camera.farPlane;    // Keep far plane the same
+
+    return std::make_unique<OrthoProj>(
+        -aspect * orthoZoom, aspect * orthoZoom,
+        -orthoZoom, orthoZoom,
+        nearOrtho, farOrtho);
+}
+
+// One recorded scene edit
+struct SceneCommand {
+    enum Type {
+        UPSERT_MESH, // Add the mesh, or replace the previous copy published for the handle
+        REMOVE_MESH  // The mesh was deleted
+    };
+
+    Type type;
+    MeshHandle handle;
+    std::shared_ptr<const Mesh> mesh; // Only for UPSERT_MESH
+
+    SceneCommand(Type type, MeshHandle handle, std::shared_ptr<const Mesh> mesh = nullptr)
+        : type(type), handle(handle), mesh(std::move(mesh)) {}
+};
+
+// State drawn by the render thread. Only the render thread touches it.
+class SceneSnapshot {
+public:
+    Camera camera;
+    int width, height; // Window size published by the UI thread
+    bool hovering;     // The cursor is over the view, at hoverX, hoverY (client pixels)
+    int hoverX, hoverY;
+    bool selectingRectangle; // A selection rectangle is being dragged between these corners (client pixels)
+    int rectangleX0, rectangleY0, rectangleX1, rectangleY1;
+
+    SceneSnapshot() : width(0), height(0), hovering(false), hoverX(0), hoverY(0),
+        selectingRectangle(false), rectangleX0(0), rectangleY0(0), rectangleX1(0), rectangleY1(0),
+        hoveredSlot(NO_SLOT), hoveredFace(-1), projectionWidth(0), projectionHeight(0) {}
+
+    void apply(const SceneCommand& command) {
+        // Meshes are stored by slot index. A slot only gets a new mesh after the old one was
+        // removed, and commands arrive in order, so the index alone identifies the mesh here.
+        size_t slot = command.handle.index;
+        if (command.type == SceneCommand::UPSERT_MESH) {
+            if (slot >= meshes.size()) {
+                meshes.resize(slot + 1);
+            }
+            meshes[slot] = command.mesh;
+        }
+        else if (slot < meshes.size()) {
+            meshes[slot].reset();
+        }
+    }
+
+    void setCamera(const Camera& latest) {
+        camera = latest;
+    }
+
+    // Published meshes by slot, empty slots belong to deleted meshes
+    const std::vector<std::shared_ptr<const Mesh>>& getMeshes() const {
+        return meshes;
+    }
+
+    // Find the visible mesh and face under a world-space ray through the cursor
+    void pickHover(const Ray& ray) {
+        clearHover();
+        float closestDistance = ray.tMax;
+        for (size_t slot = 0; slot < meshes.size(); ++slot) {
+            const Mesh* mesh = meshes[slot].get();
+            if (!mesh || !mesh->isVisible) continue;
+            // The UI thread may replace the accelerator meanwhile, the copy keeps this one alive
+            std::shared_ptr<SpatialAccelerator> accelerator = std::atomic_load(&mesh->geometry->accelerator);
+            RayHit hit;
+            if (accelerator && findClosestMeshHit(*mesh, *accelerator, ray, closestDistance, hit)) {
+                closestDistance = hit.t;
+                hoveredSlot = slot;
+                hoveredFace = static_cast<int>(hit.face - mesh->geometry->faces.data());
+            }
+        }
+    }
+
+    void clearHover() {
+        hoveredSlot = NO_SLOT;
+        hoveredFace = -1;
+    }
+
+    // Mesh under the cursor and its face there, null if none
+    const Mesh* getHoveredMesh(int& faceIndex) const {
+        faceIndex = hoveredFace;
+        return hoveredSlot < meshes.size() ? meshes[hoveredSlot].get() : nullptr;
+    }
+
+    // Projection for the snapshot's camera and window size.
+    // Rebuilt only when the window or the camera's lens changed.
+    glm::mat4 getProjectionMatrix() {
+        if (width > 0 && height > 0 && !(projection && width == projectionWidth && height == projectionHeight &&
+            camera.mode == projectionCamera.mode && camera.zoom == projectionCamera.zoom &&
+            camera.nearPlane == projectionCamera.nearPlane && camera.farPlane == projectionCamera.farPlane)) {
+            projection = createCameraProjection(camera, width, height);
+            projectionWidth = width;
+            projectionHeight = height;
+            projectionCamera = camera;
+        }
+        return projection ? projection->getComposedProjectionMatrix() : glm::mat4(1.0f);
+    }
+
+private:
+    static const size_t NO_SLOT = static_cast<size_t>(-1);
+
+    std::vector<std::shared_ptr<const Mesh>> meshes; // Indexed by the slot of the mesh's handle
+    size_t hoveredSlot; // Result of the last pickHover()
+    int hoveredFace;
+    std::unique_ptr<ViewProjMethodGLM> projection;
+    int projectionWidth, projectionHeight;
+    Camera projectionCamera; // Camera the projection was built for
+};
+
+// Commands recorded by the UI thread, waiting for the next frame
+class SceneCommandQueue {
+public:
+    // The first frame is always drawn
+    SceneCommandQueue() : hasCamera(false), redrawRequested(true), closed(false), width(0), height(0),
+        hovering(false), hoverX(0), hoverY(0), hoverChanged(false),
+        selectingRectangle(false), rectangleX0(0), rectangleY0(0), rectangleX1(0), rectangleY1(0) {}
+
+    void push(SceneCommand&& command) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(std::move(command));
+        }
+        ready.notify_one();
+    }
+
+    // Several commands under one lock and one wake-up
+    void push(std::vector<SceneCommand>& commands) {
+        if (commands.empty()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (SceneCommand& command : commands) {
+                pending.push_back(std::move(command));
+            }
+        }
+        commands.clear();
+        ready.notify_one();
+    }
+
+    // Only the latest camera matters, earlier ones are overwritten.
+    // A camera that renders like the last one pushed does not cause a frame.
+    void pushCamera(const Camera& latest) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (camera.rendersSameAs(latest)) return;
+            camera = latest;
+            hasCamera = true;
+        }
+        ready.notify_one();
+    }
+
+    void pushWindowSize(int newWidth, int newHeight) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (newWidth == width && newHeight == height) return;
+            width = newWidth;
+            height = newHeight;
+            redrawRequested = true;
+        }
+        ready.notify_one();
+    }
+
+    // Latest cursor position over the view, or hovering false once it left. Only the latest matters.
+    void pushHover(bool isHovering, int x, int y) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (isHovering == hovering && (!isHovering || (x == hoverX && y == hoverY))) return;
+            hovering = isHovering;
+            hoverX = x;
+            hoverY = y;
+            hoverChanged = true;
+        }
+        ready.notify_one();
+    }
+
+    // Latest corners of the selection rectangle being dragged, or selecting false once it ended
+    void pushSelectionRectangle(bool selecting, int x0, int y0, int x1, int y1) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (selecting == selectingRectangle && (!selecting ||
+                (x0 == rectangleX0 && y0 == rectangleY0 && x1 == rectangleX1 && y1 == rectangleY1))) return;
+            selectingRectangle = selecting;
+            rectangleX0 = x0;
+            rectangleY0 = y0;
+            rectangleX1 = x1;
+            rectangleY1 = y1;
+            redrawRequested = true;
+        }
+        ready.notify_one();
+    }
+
+    // Redraw without any scene change, e.g. the window was uncovered
+    void requestRedraw() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            redrawRequested = true;
+        }
+        ready.notify_one();
+    }
+
+    // Wake the render thread for good, waitForFrame() returns false from now on
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        ready.notify_all();
+    }
+
+    // Render thread: block until there is something to draw. Returns false once closed.
+    bool waitForFrame() {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this]() { return closed || redrawRequested || hasCamera || hoverChanged || !pending.empty(); });
+        return !closed;
+    }
+
+    // Called by the render thread at a frame boundary.
+    // The pending list is swapped out under the lock and applied outside it, so the UI thread
+    // is only ever blocked for a swap, never for the time it takes to apply the edits.
+    void applyTo(SceneSnapshot& snapshot) {
+        bool cameraChanged;
+        Camera latestCamera;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            applying.swap(pending);
+            cameraChanged = hasCamera;
+            if (hasCamera) {
+                latestCamera = camera;
+                hasCamera = false;
+            }
+            snapshot.width = width;
+            snapshot.height = height;
+            snapshot.hovering = hovering;
+            snapshot.hoverX = hoverX;
+            snapshot.hoverY = hoverY;
+            snapshot.selectingRectangle = selectingRectangle;
+            snapshot.rectangleX0 = rectangleX0;
+            snapshot.rectangleY0 = rectangleY0;
+            snapshot.rectangleX1 = rectangleX1;
+            snapshot.rectangleY1 = rectangleY1;
+            redrawRequested = false;
+            hoverChanged = false;
+        }
+
+        for (const SceneCommand& command : applying) {
+            snapshot.apply(command);
+        }
+        applying.clear(); // Keeps the capacity, the next swap hands it back to the UI thread
+        if (cameraChanged) {
+            snapshot.setCamera(latestCamera);
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;      // Signalled whenever a frame becomes necessary
+    std::vector<SceneCommand> pending;  // Written by the UI thread
+    std::vector<SceneCommand> applying; // Drained by the render thread
+    Camera camera;                      // Latest camera pushed
+    bool hasCamera;                     // camera not yet applied
+    bool redrawRequested;
+    bool closed;
+    int width, height;                  // Latest window size pushed
+    bool hovering;                      // Latest cursor position pushed
+    int hoverX, hoverY;
+    bool hoverChanged;                  // Cursor moved since the last frame
+    bool selectingRectangle;            // Latest selection rectangle pushed
+    int rectangleX0, rectangleY0, rectangleX1, rectangleY1;
+};
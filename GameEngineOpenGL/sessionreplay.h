@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include "model.h"
+#include "sessiontrace.h"
+
+// Applies recorded session operations to a Model, see sessiontrace.h for the format
+class SessionReplayer {
+public:
+    explicit SessionReplayer(Model& model) : model(model) {}
+
+    // Apply one operation. Returns false if it could not be decoded or failed (e.g. an import whose
+    // file is missing); operations on meshes that do not exist are applied and do nothing, as they did.
+    bool apply(const SessionOp& op) {
+        TraceReader reader(op.payload);
+        switch (op.type) {
+            case SESSION_CREATE_PRIMITIVE: {
+                int primitive = reader.get<uint8_t>();
+                int x = reader.get<int32_t>();
+                int y = reader.get<int32_t>();
+                int z = reader.get<int32_t>();
+                SlotHandle recorded = reader.getHandle();
+                if (!reader.ok()) return false;
+                MeshHandle handle = createPrimitive(primitive, x, y, z);
+                handles[key(recorded)] = handle;
+                return !handle.isNull();
+            }
+            case SESSION_IMPORT: {
+                uint32_t count = reader.get<uint32_t>();
+                std::vector<std::string> paths;
+                std::vector<SlotHandle> recorded;
+                for (uint32_t i = 0; i < count && reader.ok(); ++i) {
+                    paths.push_back(reader.getString());
+                    recorded.push_back(reader.getHandle());
+                }
+                if (!reader.ok()) return false;
+                std::vector<MeshHandle> created = model.createFromFiles(paths);
+                bool allLoaded = true;
+                for (size_t i = 0; i < created.size(); ++i) {
+                    handles[key(recorded[i])] = created[i];
+                    allLoaded = allLoaded && (created[i].isNull() == recorded[i].isNull());
+                }
+                return allLoaded;
+            }
+            case SESSION_UPDATE_TRANSFORM: {
+                SlotHandle recorded = reader.getHandle();
+                glm::vec3 rotation = reader.getVec3();
+                glm::vec3 position = reader.getVec3();
+                if (!reader.ok()) return false;
+                model.updateMeshProperties(map(recorded), rotation.x, rotation.y, rotation.z, position.x, position.y, position.z);
+                return true;
+            }
+            case SESSION_UPDATE_PROPERTIES: {
+                SlotHandle recorded = reader.getHandle();
+                glm::vec3 rotation = reader.getVec3();
+                glm::vec3 position = reader.getVec3();
+                glm::vec3 scale = reader.getVec3();
+                glm::vec3 color = reader.getVec3();
+                float transparency = reader.get<float>();
+                float shininess = reader.get<float>();
+                int materialType = reader.get<int32_t>();
+                bool wireframe = reader.get<uint8_t>() != 0;
+                bool visible = reader.get<uint8_t>() != 0;
+                if (!reader.ok()) return false;
+                model.updateMeshAllProperties(map(recorded), rotation.x, rotation.y, rotation.z,
+                                              position.x, position.y, position.z, scale.x, scale.y, scale.z,
+                                              color.x, color.y, color.z, transparency, shininess, materialType,
+                                              wireframe, visible);
+                return true;
+            }
+            case SESSION_DELETE: {
+                SlotHandle recorded = reader.getHandle();
+                if (!reader.ok()) return false;
+                model.deleteMesh(map(recorded));
+                return true;
+            }
+            case SESSION_PICK: {
+                glm::vec3 origin = reader.getVec3();
+                glm::vec3 direction = reader.getVec3();
+                float tMin = reader.get<float>();
+                float tMax = reader.get<float>();
+                if (!reader.ok()) return false;
+                MeshHandle hitMesh;
+                int faceIndex;
+                model.findRayIntersection(Ray(origin, direction, tMin, tMax), hitMesh, faceIndex);
+                return true;
+            }
+            case SESSION_CAMERA: {
+                readTraceCamera(reader, model.camera);
+                return reader.ok();
+            }
+            case SESSION_SELECT_RECTANGLE: {
+                glm::mat4 viewProjection = reader.get<glm::mat4>();
+                glm::vec2 ndcMin = reader.get<glm::vec2>();
+                glm::vec2 ndcMax = reader.get<glm::vec2>();
+                bool depthLimited = reader.get<uint8_t>() != 0;
+                if (!reader.ok()) return false;
+                std::vector<RectangleHit> hits;
+                model.findFacesInRectangle(viewProjection, ndcMin, ndcMax, depthLimited, hits);
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+private:
+    Model& model;
+    std::unordered_map<uint64_t, MeshHandle> handles; // Recorded handle -> handle in this model
+
+    static uint64_t key(SlotHandle handle) {
+        return (static_cast<uint64_t>(handle.index) << 32) | handle.generation;
+    }
+
+    MeshHandle map(SlotHandle recorded) const {
+        std::unordered_map<uint64_t, MeshHandle>::const_iterator it = handles.find(key(recorded));
+        return it != handles.end() ? it->second : MeshHandle();
+    }
+
+    MeshHandle createPrimitive(int primitive, int x, int y, int z) {
+        switch (primitive) {
+            case PRIMITIVE_CUBE: return model.createCube(x, y, z);
+            case PRIMITIVE_PYRAMID: return model.createPyramid(x, y, z);
+            case PRIMITIVE_CIRCLE: return model.createCircle(x, y, z);
+            case PRIMITIVE_CYLINDER: return model.createCylinder(x, y, z);
+            case PRIMITIVE_SPHERE: return model.createSphere(x, y, z);
+            case PRIMITIVE_CONE: return model.createCone(x, y, z);
+            case PRIMITIVE_TORUS: return model.createTorus(x, y, z);
+            case PRIMITIVE_PLANE: return model.createPlane(x, y, z);
+            default: return MeshHandle();
+        }
+    }
+};
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "camera.h"
+#include "log.h"
+#include "ray.h"
+#include "slotmap.h"
+
+/*
+* Record and replay of editor sessions.
+*
+* While recording, every scene operation the editor performs is appended to a trace file: primitive
+* creates, imports, property edits, deletes, picks, rectangle selections and camera moves. The trace holds the operation's
+* arguments only, not its result, so replaying it against the current code measures the current code.
+*
+* File layout, little endian:
+*   "CADTRACE" uint32 version
+*   records: uint8 type, uint32 payload size, payload
+*
+* Meshes are referred to by the handle they had while recording. The replayer maps those to the
+* handles its own creates return, so replay does not depend on handle allocation staying the same.
+* Imports store the file path; the files must exist where the trace is replayed.
+* Version 2 added rectangle selections, version 1 traces still load.
+*/
+
+enum SessionOpType {
+    SESSION_CREATE_PRIMITIVE = 1, // PrimitiveType, x, y, z, handle
+    SESSION_IMPORT,               // count, then path and handle per file
+    SESSION_UPDATE_TRANSFORM,     // handle, rotation, position
+    SESSION_UPDATE_PROPERTIES,    // handle, every argument of updateMeshAllProperties
+    SESSION_DELETE,               // handle
+    SESSION_PICK,                 // ray origin, direction, tMin, tMax
+    SESSION_CAMERA,               // camera state
+    SESSION_SELECT_RECTANGLE,     // view projection, ndc min, ndc max, depth limited
+    SESSION_OP_END
+};
+
+inline const char* sessionOpName(int type) {
+    static const char* const names[] = { "invalid", "create", "import", "update_transform",
+                                         "update_properties", "delete", "pick", "camera", "select_rectangle" };
+    return type > 0 && type < SESSION_OP_END ? names[type] : names[0];
+}
+
+static const char SESSION_TRACE_MAGIC[8] = { 'C', 'A', 'D', 'T', 'R', 'A', 'C', 'E' };
+static const uint32_t SESSION_TRACE_VERSION = 2;
+
+// Little endian field packing for trace records
+class TraceWriter {
+public:
+    std::vector<char> bytes;
+
+    template <typename T>
+    void put(const T& value) {
+        const char* raw = reinterpret_cast<const char*>(&value);
+        bytes.insert(bytes.end(), raw, raw + sizeof(T));
+    }
+
+    void putHandle(SlotHandle handle) {
+        put(handle.index);
+        put(handle.generation);
+    }
+
+    void putVec3(const glm::vec3& value) {
+        put(value.x);
+        put(value.y);
+        put(value.z);
+    }
+
+    void putString(const std::string& value) {
+        put(static_cast<uint32_t>(value.size()));
+        bytes.insert(bytes.end(), value.begin(), value.end());
+    }
+};
+
+class TraceReader {
+public:
+    TraceReader(const std::vector<char>& bytes) : bytes(bytes), offset(0), failed(false) {}
+
+    template <typename T>
+    T get() {
+        T value = T();
+        if (offset + sizeof(T) > bytes.size()) {
+            failed = true;
+            return value;
+        }
+        std::memcpy(&value, bytes.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    SlotHandle getHandle() {
+        uint32_t index = get<uint32_t>();
+        uint32_t generation = get<uint32_t>();
+        return SlotHandle(index, generation);
+    }
+
+    glm::vec3 getVec3() {
+        float x = get<float>();
+        float y = get<float>();
+        float z = get<float>();
+        return glm::vec3(x, y, z);
+    }
+
+    std::string getString() {
+        uint32_t size = get<uint32_t>();
+        if (failed || offset + size > bytes.size()) {
+            failed = true;
+            return std::string();
+        }
+        std::string value(bytes.data() + offset, size);
+        offset += size;
+        return value;
+    }
+
+    bool ok() const {
+        return !failed;
+    }
+
+private:
+    const std::vector<char>& bytes;
+    size_t offset;
+    bool failed;
+};
+
+inline void writeTraceCamera(TraceWriter& writer, const Camera& camera) {
+    writer.putVec3(camera.position);
+    writer.putVec3(camera.target);
+    writer.putVec3(camera.angle);
+    writer.put(camera.nearPlane);
+    writer.put(camera.farPlane);
+    writer.put(camera.zoom);
+    writer.put(static_cast<uint32_t>(camera.mode));
+    writer.put(static_cast<uint8_t>(camera.orbitMode));
+    writer.putVec3(camera.orbitTarget);
+    writer.put(camera.orbitDistance);
+    writer.put(camera.viewMatrix);
+}
+
+inline void readTraceCamera(TraceReader& reader, Camera& camera) {
+    camera.position = reader.getVec3();
+    camera.target = reader.getVec3();
+    camera.angle = reader.getVec3();
+    camera.nearPlane = reader.get<float>();
+    camera.farPlane = reader.get<float>();
+    camera.zoom = reader.get<float>();
+    camera.mode = reader.get<uint32_t>();
+    camera.orbitMode = reader.get<uint8_t>() != 0;
+    camera.orbitTarget = reader.getVec3();
+    camera.orbitDistance = reader.get<float>();
+    camera.viewMatrix = reader.get<glm::mat4>();
+}
+
+// Appends operations to a trace file. Inactive until start(); the record calls are cheap no-ops then.
+class SessionRecorder {
+public:
+    ~SessionRecorder() {
+        stop();
+    }
+
+    bool start(const std::string& filePath) {
+        stop();
+        file.open(filePath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            logMessage(LOG_ERROR, "Failed to create session trace: " + filePath);
+            return false;
+        }
+        file.write(SESSION_TRACE_MAGIC, sizeof(SESSION_TRACE_MAGIC));
+        file.write(reinterpret_cast<const char*>(&SESSION_TRACE_VERSION), sizeof(SESSION_TRACE_VERSION));
+        hasCamera = false;
+        logMessage(LOG_INFO, "Recording session to " + filePath);
+        return true;
+    }
+
+    void stop() {
+        if (file.is_open()) {
+            file.close();
+        }
+    }
+
+    bool isRecording() const {
+        return file.is_open();
+    }
+
+    void recordCreatePrimitive(int primitive, int x, int y, int z, SlotHandle handle) {
+        if (!isRecording()) return;
+        TraceWriter writer;
+        writer.put(static_cast<uint8_t>(primitive));
+        writer.put(static_cast<int32_t>(x));
+        writer.put(static_cast<int32_t>(y));
+        writer.put(static_cast<int32_t>(z));
+        writer.putHandle(handle);
+        append(SESSION_CREATE_PRIMITIVE, writer);
+    }
+
+    void recordImport(const std::vector<std::string>& filePaths, const std::vector<SlotHandle>& handles) {
+        if (!isRecording()) return;
+        TraceWriter writer;
+        writer.put(static_cast<uint32_t>(filePaths.size()));
+        for (size_t i = 0; i < filePaths.size(); ++i) {
+            writer.putString(filePaths[i]);
+            writer.putHandle(handles[i]);
+        }
+        append(SESSION_IMPORT, writer);
+    }
+
+    void recordUpdateTransform(SlotHandle handle, float rotX, float rotY, float rotZ, float posX, float posY, float posZ) {
+        if (!isRecording()) return;
+        TraceWriter writer;
+        writer.putHandle(handle);
+        writer.putVec3(glm::vec3(rotX, rotY, rotZ));
+        writer.putVec3(glm::vec3(posX, posY, posZ));
+        append(SESSION_UPDATE_TRANSFORM, writer);
+    }
+
+    void recordUpdateProperties(SlotHandle handle,
+                                float rotX, float rotY, float rotZ,
+                                float posX, float posY, float posZ,
+                                float scaleX, float scaleY, float scaleZ,
+                                float colorR, float colorG, float colorB,
+                                float transparency, float shininess, int materialType,
+                                bool wireframe, bool visible) {
+        if (!isRecording()) return;
+        TraceWriter writer;
+        writer.putHandle(handle);
+        writer.putVec3(glm::vec3(rotX, rotY, rotZ));
+        writer.putVec3(glm::vec3(posX, posY, posZ));
+        writer.putVec3(glm::vec3(scaleX, scaleY, scaleZ));
+        writer.putVec3(glm::vec3(colorR, colorG, colorB));
+        writer.put(transparency);
+        writer.put(shininess);
+        writer.put(static_cast<int32_t>(materialType));
+        writer.put(static_cast<uint8_t>(wireframe));
+        writer.put(static_cast<uint8_t>(visible));
+        append(SESSION_UPDATE_PROPERTIES, writer);
+    }
+
+    void recordDelete(SlotHandle handle) {
+        if (!isRecording()) return;
+        TraceWriter writer;
+        writer.putHandle(handle);
+        append(SESSION_DELETE, writer);
+    }
+
+    void recordPick(const Ray& ray) {
+        if (!isRecording()) return;
+        TraceWriter writer;
+        writer.putVec3(ray.origin);
+        writer.putVec3(ray.direction);
+        writer.put(ray.tMin);
+        writer.put(ray.tMax);
+        append(SESSION_PICK, writer);
+    }
+
+    void recordSelectRectangle(const glm::mat4& viewProjection, const glm::vec2& ndcMin, const glm::vec2& ndcMax, bool depthLimited) {
+        if (!isRecording()) return;
+        TraceWriter writer;
+        writer.put(viewProjection);
+        writer.put(ndcMin);
+        writer.put(ndcMax);
+        writer.put(static_cast<uint8_t>(depthLimited));
+        append(SESSION_SELECT_RECTANGLE, writer);
+    }
+
+    // Only cameras that render differently from the last one recorded are written
+    void recordCamera(const Camera& camera) {
+        if (!isRecording() || (hasCamera && lastCamera.rendersSameAs(camera))) return;
+        lastCamera = camera;
+        hasCamera = true;
+        TraceWriter writer;
+        writeTraceCamera(writer, camera);
+        append(SESSION_CAMERA, writer);
+    }
+
+private:
+    std::ofstream file;
+    Camera lastCamera;
+    bool hasCamera = false;
+
+    void append(SessionOpType type, const TraceWriter& writer) {
+        uint8_t tag = static_cast<uint8_t>(type);
+        uint32_t size = static_cast<uint32_t>(writer.bytes.size());
+        file.write(reinterpret_cast<const char*>(&tag), sizeof(tag));
+        file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        file.write(writer.bytes.data(), writer.bytes.size());
+    }
+};
+
+// One recorded operation, payload still packed
+struct SessionOp {
+    int type;
+    std::vector<char> payload;
+};
+
+// Read a whole trace. Returns false for a missing, foreign or truncated file.
+inline bool loadSessionTrace(const std::string& filePath, std::vector<SessionOp>& ops) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        logMessage(LOG_ERROR, "Failed to open session trace: " + filePath);
+        return false;
+    }
+
+    char magic[sizeof(SESSION_TRACE_MAGIC)];
+    uint32_t version = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (!file || std::memcmp(magic, SESSION_TRACE_MAGIC, sizeof(magic)) != 0 || version == 0 || version > SESSION_TRACE_VERSION) {
+        logMessage(LOG_ERROR, "Not a session trace, or an unsupported version: " + filePath);
+        return false;
+    }
+
+    ops.clear();
+    for (;;) {
+        uint8_t tag;
+        uint32_t size;
+        if (!file.read(reinterpret_cast<char*>(&tag), sizeof(tag))) break; // End of trace
+        SessionOp op;
+        op.type = tag;
+        op.payload.resize(file.read(reinterpret_cast<char*>(&size), sizeof(size)) ? size : 0);
+        if (!file || (size > 0 && !file.read(op.payload.data(), size))) {
+            logMessage(LOG_ERROR, "Session trace is truncated: " + filePath);
+            return false;
+        }
+        ops.push_back(std::move(op));
+    }
+    return true;
+}
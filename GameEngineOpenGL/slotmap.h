@@ -0,0 +1,172 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+/*
+* Slot map container used for scene storage.
+*
+* Items live in a dense array so iteration (e.g. rendering) is a linear walk with no holes.
+* Callers never hold dense indices, they hold a handle: the index of a slot plus the generation
+* that slot had when the item was inserted. The slot maps the handle to the item's current dense index.
+*
+* Insert: take a slot from the free list (or add one), append the item to the dense array.  O(1)
+* Erase:  move the last dense item into the hole, patch its slot, bump the erased slot's generation. O(1)
+*
+* Bumping the generation on erase makes every outstanding handle to that item stale, so a lookup
+* with an old handle fails instead of silently returning whatever item reused the slot.
+*/
+
+// Handle to an item stored in a SlotMap
+struct SlotHandle {
+    static const uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+
+    uint32_t index;      // Slot index
+    uint32_t generation; // Generation of the slot when the handle was issued
+
+    // Default constructor - creates a null handle
+    SlotHandle() : index(INVALID_INDEX), generation(0) {}
+    SlotHandle(uint32_t index, uint32_t generation) : index(index), generation(generation) {}
+
+    bool isNull() const {
+        return index == INVALID_INDEX;
+    }
+
+    bool operator==(const SlotHandle& other) const {
+        return index == other.index && generation == other.generation;
+    }
+
+    bool operator!=(const SlotHandle& other) const {
+        return !(*this == other);
+    }
+};
+
+template <typename T>
+class SlotMap {
+private:
+    struct Slot {
+        uint32_t denseIndex; // Index into dense array, or next free slot when the slot is unused
+        uint32_t generation; // Incremented every time the slot's item is erased
+    };
+
+    std::vector<T> dense;             // Tightly packed items
+    std::vector<uint32_t> denseToSlot; // Slot owning each dense item (parallel to dense)
+    std::vector<Slot> slots;          // Indirection table addressed by handles
+    uint32_t freeHead;                // First unused slot, INVALID_INDEX if none
+
+    SlotHandle allocateSlot() {
+        uint32_t slotIndex;
+        if (freeHead != SlotHandle::INVALID_INDEX) {
+            slotIndex = freeHead;
+            freeHead = slots[slotIndex].denseIndex;
+        }
+        else {
+            slotIndex = static_cast<uint32_t>(slots.size());
+            Slot slot;
+            slot.denseIndex = SlotHandle::INVALID_INDEX;
+            slot.generation = 1; // Generation 0 is never issued, so default handles never resolve
+            slots.push_back(slot);
+        }
+        slots[slotIndex].denseIndex = static_cast<uint32_t>(dense.size());
+        denseToSlot.push_back(slotIndex);
+        return SlotHandle(slotIndex, slots[slotIndex].generation);
+    }
+
+public:
+    typedef typename std::vector<T>::iterator iterator;
+    typedef typename std::vector<T>::const_iterator const_iterator;
+
+    SlotMap() : freeHead(SlotHandle::INVALID_INDEX) {}
+
+    // Construct a new item in place and return its handle
+    template <typename... Args>
+    SlotHandle emplace(Args&&... args) {
+        SlotHandle handle = allocateSlot();
+        dense.emplace_back(std::forward<Args>(args)...);
+        return handle;
+    }
+
+    SlotHandle insert(T&& item) {
+        return emplace(std::move(item));
+    }
+
+    // Erase the item referenced by the handle, returns false for stale or null handles
+    bool erase(SlotHandle handle) {
+        if (!contains(handle)) return false;
+
+        uint32_t hole = slots[handle.index].denseIndex;
+        uint32_t last = static_cast<uint32_t>(dense.size() - 1);
+
+        // Fill the hole with the last item so the dense array stays packed
+        if (hole != last) {
+            dense[hole] = std::move(dense[last]);
+            denseToSlot[hole] = denseToSlot[last];
+            slots[denseToSlot[hole]].denseIndex = hole;
+        }
+        dense.pop_back();
+        denseToSlot.pop_back();
+
+        // Invalidate outstanding handles and return the slot to the free list
+        Slot& slot = slots[handle.index];
+        slot.generation++;
+        if (slot.generation == 0) slot.generation = 1;
+        slot.denseIndex = freeHead;
+        freeHead = handle.index;
+        return true;
+    }
+
+    bool contains(SlotHandle handle) const {
+        return handle.index < slots.size() &&
+               slots[handle.index].generation == handle.generation &&
+               slots[handle.index].denseIndex < dense.size() &&
+               denseToSlot[slots[handle.index].denseIndex] == handle.index;
+    }
+
+    // Resolve a handle, returns nullptr if the item has been erased
+    T* get(SlotHandle handle) {
+        return contains(handle) ? &dense[slots[handle.index].denseIndex] : nullptr;
+    }
+
+    const T* get(SlotHandle handle) const {
+        return contains(handle) ? &dense[slots[handle.index].denseIndex] : nullptr;
+    }
+
+    // Handle of the item at a dense position (as seen while iterating)
+    SlotHandle handleAt(size_t denseIndex) const {
+        if (denseIndex >= dense.size()) return SlotHandle();
+        uint32_t slotIndex = denseToSlot[denseIndex];
+        return SlotHandle(slotIndex, slots[slotIndex].generation);
+    }
+
+    // Dense position of an item, -1 for stale or null handles
+    int denseIndexOf(SlotHandle handle) const {
+        return contains(handle) ? static_cast<int>(slots[handle.index].denseIndex) : -1;
+    }
+
+    void reserve(size_t count) {
+        dense.reserve(count);
+        denseToSlot.reserve(count);
+        slots.reserve(count);
+    }
+
+    void clear() {
+        // Erase item by item so every outstanding handle goes stale
+        while (!dense.empty()) {
+            erase(handleAt(dense.size() - 1));
+        }
+    }
+
+    size_t size() const { return dense.size(); }
+    bool empty() const { return dense.empty(); }
+
+    // Dense access, positions change when items are erased so do not store them
+    T& operator[](size_t denseIndex) { return dense[denseIndex]; }
+    const T& operator[](size_t denseIndex) const { return dense[denseIndex]; }
+
+    iterator begin() { return dense.begin(); }
+    iterator end() { return dense.end(); }
+    const_iterator begin() const { return dense.begin(); }
+    const_iterator end() const { return dense.end(); }
+};
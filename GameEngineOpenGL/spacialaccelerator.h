@@ -2,21 +2,43 @@
 
 #include <vector>
 #include <glm/glm.hpp>
+#include <chrono>
+#include <cstdint>
 #include <limits>
 #include <algorithm>
-#include <stack>
+#include <cmath>
+#include <mutex>
+#include <atomic>
+#include <string>
 #include <queue>
-#include "mesh.h"
+#include "Mesh.h"
+#include "acceleratortraversal.h"
 #include "ray.h"
 
-// Define optimization macros to choose between memory or performance optimization
-#define SPACIAL_OPT_MEMORY 0
-#define SPACIAL_OPT_PERFORMANCE 1
+// Accelerator built for new geometry, chosen at runtime. AUTO lets AcceleratorSelector decide per geometry.
+enum AcceleratorType {
+    ACCELERATOR_AUTO,
+    ACCELERATOR_BVH,
+    ACCELERATOR_KDTREE,
+    ACCELERATOR_LBVH,
+    ACCELERATOR_TYPE_COUNT
+};
 
-// Default to performance optimization if not specified
-#ifndef SPACIAL_OPT_MODE
-#define SPACIAL_OPT_MODE SPACIAL_OPT_PERFORMANCE
-#endif
+inline const char* acceleratorTypeName(AcceleratorType type) {
+    static const char* const names[] = { "auto", "bvh", "kdtree", "lbvh" };
+    return type >= 0 && type < ACCELERATOR_TYPE_COUNT ? names[type] : names[0];
+}
+
+// Accepts the names acceleratorTypeName() returns
+inline bool parseAcceleratorType(const std::string& name, AcceleratorType& type) {
+    for (int candidate = 0; candidate < ACCELERATOR_TYPE_COUNT; ++candidate) {
+        if (name == acceleratorTypeName(static_cast<AcceleratorType>(candidate))) {
+            type = static_cast<AcceleratorType>(candidate);
+            return true;
+        }
+    }
+    return false;
+}
 
 /*
 * Bounding Volume Hierarchy (BVH) is a tree structure on a set of geometric objects.
@@ -63,18 +85,87 @@
 * - In BVH, an object is only in one node, but in KD-Tree, objects can be in multiple nodes
 * - BVH is more memory-efficient but can have overlapping bounding boxes
 * - KD-Tree is typically faster for ray tracing but requires more memory and preprocessing time
+*
+* Linear BVH (LBVH):
+* Sorts the triangles along a Morton (Z-order) curve of their centroids and splits each range where
+* the codes first differ. No cost function is evaluated, so it builds far faster than the SAH BVH,
+* at the price of looser boxes and more work per query. Suited to large geometry queried rarely.
+* 
+* Two levels:
+* An accelerator is built over the object-space faces of one MeshGeometry and shared by every mesh using it.
+* Picking tests the ray against each mesh's world AABB first, then walks the geometry's accelerator
+* with the ray moved into that mesh's object space. Moving a mesh never rebuilds anything.
 */
 
 #define BVH_MAX_DEPTH 10
 #define KDT_MAX_DEPTH 16
+#define LBVH_MAX_DEPTH 48
+#define LBVH_LEAF_SIZE 4
+
+// Relative costs of a node visit and a triangle test in the SAH cost reported by getStats()
+#define SAH_TRAVERSAL_COST 1.0
+#define SAH_INTERSECTION_COST 1.0
+
+/*
+* Shape of a built accelerator, for tuning the builders.
+*
+* sahCost is the expected work of a ray that hits the root box: every node costs its surface area
+* relative to the root's times SAH_TRAVERSAL_COST, leaves add SAH_INTERSECTION_COST per triangle.
+* depthLimitedLeaves counts leaves that were only made leaves because BVH_MAX_DEPTH / KDT_MAX_DEPTH
+* was reached; many of them on a real scene mean the limit costs query time.
+*/
+struct AcceleratorStats {
+    const char* type = "";
+    size_t triangles = 0;           // Triangles the accelerator was built over
+    size_t nodes = 0;               // Internal and leaf nodes
+    size_t leaves = 0;
+    size_t emptyLeaves = 0;
+    size_t depthLimitedLeaves = 0;
+    int maxDepth = 0;               // Of the leaves, the root is depth 0
+    double averageDepth = 0.0;
+    double averageLeafTriangles = 0.0; // Over the leaves holding triangles
+    double duplication = 0.0;       // Triangle references in leaves per triangle, KD-tree leaves share triangles
+    double sahCost = 0.0;
+    size_t memoryBytes = 0;         // Nodes and triangle lists
+    double buildMilliseconds = 0.0;
+};
 
 // Base class for spatial acceleration structures
 class SpatialAccelerator {
 public:
     virtual ~SpatialAccelerator() {}
-    virtual void build(const std::vector<Mesh>& meshes) = 0;
-    virtual void traverse(void* node, const Ray& ray, std::vector<Face*>& hitFaces) = 0;
-    virtual void drawDebug() const = 0;
+    virtual void build(const std::vector<Face>& faces) = 0;
+    // Appends every face the ray hits. counters is optional, traversal without it counts nothing.
+    virtual void traverse(const Ray& ray, std::vector<Face*>& hitFaces, TraversalCounters* counters = nullptr) const = 0;
+    virtual AcceleratorType getType() const = 0;
+    // Walks the whole structure, meant for reports rather than per frame use
+    virtual AcceleratorStats getStats() const = 0;
+    // Same structure over a copy of the faces it was built on (same faces, same order), for a
+    // geometry copy whose faces did not change. Copies nodes instead of building them again.
+    virtual SpatialAccelerator* clone(const std::vector<Face>& from, const std::vector<Face>& to) const = 0;
+
+protected:
+    double buildMilliseconds = 0.0;
+
+    // Face pointers into one faces array moved to the same positions in another
+    static std::vector<Face*> rebase(const std::vector<Face*>& faces, const std::vector<Face>& from, const std::vector<Face>& to) {
+        std::vector<Face*> rebased(faces.size());
+        for (size_t i = 0; i < faces.size(); ++i) {
+            rebased[i] = const_cast<Face*>(to.data() + (faces[i] - from.data()));
+        }
+        return rebased;
+    }
+
+    static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Leaf counts and averages, once the walk has added up nodes, leaves and their depths
+    static void finishStats(AcceleratorStats& stats, size_t depthSum, size_t leafReferences, size_t filledLeaves) {
+        stats.averageDepth = stats.leaves ? static_cast<double>(depthSum) / stats.leaves : 0.0;
+        stats.averageLeafTriangles = filledLeaves ? static_cast<double>(leafReferences) / filledLeaves : 0.0;
+        stats.duplication = stats.triangles ? static_cast<double>(leafReferences) / stats.triangles : 0.0;
+    }
 };
 
 // BVH implementation (more memory efficient)
@@ -117,6 +208,15 @@ private:
         node->boundingBox.merge(node->right->boundingBox);
     }
 
+    static BVHNode* cloneNode(const BVHNode* node) {
+        if (!node) return nullptr;
+        BVHNode* copy = new BVHNode(node->startIndex, node->endIndex);
+        copy->boundingBox = node->boundingBox;
+        copy->left = cloneNode(node->left);
+        copy->right = cloneNode(node->right);
+        return copy;
+    }
+
     // Returns the index of the axis to split on
     int splitNode(BVHNode* node, unsigned int start, unsigned int end, int depth = BVH_MAX_DEPTH) {
         unsigned int N = end - start;
@@ -187,8 +287,45 @@ private:
         }
         return box;
     }
-    
+
+    void accumulateStats(const BVHNode* node, int depth, double rootArea, AcceleratorStats& stats,
+                         size_t& depthSum, size_t& leafReferences, size_t& filledLeaves) const {
+        double area = rootArea > 0.0 ? node->boundingBox.getSurfaceArea() / rootArea : 0.0;
+        stats.nodes++;
+        if (node->left == nullptr && node->right == nullptr) {
+            unsigned int count = node->endIndex - node->startIndex;
+            stats.leaves++;
+            stats.maxDepth = std::max(stats.maxDepth, depth);
+            depthSum += depth;
+            leafReferences += count;
+            if (count == 0) stats.emptyLeaves++;
+            else filledLeaves++;
+            if (depth >= BVH_MAX_DEPTH && count > 1) stats.depthLimitedLeaves++;
+            stats.sahCost += area * SAH_INTERSECTION_COST * count;
+            return;
+        }
+        stats.sahCost += area * SAH_TRAVERSAL_COST;
+        if (node->left) accumulateStats(node->left, depth + 1, rootArea, stats, depthSum, leafReferences, filledLeaves);
+        if (node->right) accumulateStats(node->right, depth + 1, rootArea, stats, depthSum, leafReferences, filledLeaves);
+    }
+
 public:
+    // Node access for the traversal core
+    struct Layout {
+        typedef const BVHNode* NodeRef;
+        static const int maxDepth = BVH_MAX_DEPTH;
+        const BVH& tree;
+
+        explicit Layout(const BVH& tree) : tree(tree) {}
+        bool empty() const { return tree.root == nullptr; }
+        NodeRef root() const { return tree.root; }
+        const AABB& box(NodeRef node) const { return node->boundingBox; }
+        bool isLeaf(NodeRef node) const { return node->left == nullptr && node->right == nullptr; }
+        Face* const* leafBegin(NodeRef node) const { return tree.triangles.data() + node->startIndex; }
+        Face* const* leafEnd(NodeRef node) const { return tree.triangles.data() + node->endIndex; }
+        void children(NodeRef node, NodeRef& first, NodeRef& second) const { first = node->left; second = node->right; }
+    };
+
     BVH() : root(nullptr) {}
     ~BVH() {
         delete root;
@@ -198,84 +335,66 @@ public:
         return root;
     }
 
-    void build(const std::vector<Mesh>& meshes) override {
+    void build(const std::vector<Face>& faces) override {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
         triangles.clear();
-        for (const Mesh& mesh : meshes) {
-            for (const Face& face : mesh.faces) {
-                triangles.push_back(const_cast<Face*>(&face));
-            }
+        triangles.reserve(faces.size());
+        for (const Face& face : faces) {
+            triangles.push_back(const_cast<Face*>(&face));
         }
         if (triangles.empty()) {
             root = nullptr;
+            buildMilliseconds = millisecondsSince(start);
             return;
         }
         if (root) delete root;
         root = new BVHNode(0, static_cast<unsigned int>(triangles.size()));
         buildBVH(root, BVH_MAX_DEPTH);
+        buildMilliseconds = millisecondsSince(start);
     }
 
-    void traverse(void* node_ptr, const Ray& ray, std::vector<Face*>& hitFaces) override {
-        BVHNode* node = static_cast<BVHNode*>(node_ptr);
-        if (!node) return;
-        
-        std::stack<BVHNode*> stack;
-        stack.push(node);
-        while (!stack.empty()) {
-            BVHNode* current = stack.top();
-            stack.pop();
-            if (!current || !current->boundingBox.isIntersectingRay(ray.origin, ray.direction, ray.tMin, ray.tMax)) continue;
-            // If it's a leaf node, check for intersections with triangles
-            if (current->left == nullptr && current->right == nullptr) {
-                for (unsigned int i = current->startIndex; i < current->endIndex; ++i) {
-                    if (triangles[i]->isIntersectingRay(ray.origin, ray.direction, ray.tMin, ray.tMax)) {
-                        hitFaces.push_back(triangles[i]);
-                    }
-                }
-                continue;
-            }
-            // Push children onto the stack
-            if (current->left) stack.push(current->left);
-            if (current->right) stack.push(current->right);
-        }
+    SpatialAccelerator* clone(const std::vector<Face>& from, const std::vector<Face>& to) const override {
+        BVH* copy = new BVH();
+        copy->root = cloneNode(root);
+        copy->triangles = rebase(triangles, from, to);
+        copy->buildMilliseconds = buildMilliseconds;
+        return copy;
     }
 
-    void drawDebug() const override {
-        drawBVHNode(root);
+    AcceleratorType getType() const override {
+        return ACCELERATOR_BVH;
     }
 
-    void drawBVHNode(const BVHNode* node) const {
-        if (!node) return;
-
-        // Draw the bounding box of the current node
-        const glm::vec3& min = node->boundingBox.min;
-        const glm::vec3& max = node->boundingBox.max;
-
-        glColor3f(0.0f, 1.0f, 0.0f); // Green color for bounding boxes
-        glBegin(GL_LINES);
-
-        // Bottom face
-        glVertex3f(min.x, min.y, min.z); glVertex3f(max.x, min.y, min.z);
-        glVertex3f(max.x, min.y, min.z); glVertex3f(max.x, min.y, max.z);
-        glVertex3f(max.x, min.y, max.z); glVertex3f(min.x, min.y, max.z);
-        glVertex3f(min.x, min.y, max.z); glVertex3f(min.x, min.y, min.z);
-
-        // Top face
-        glVertex3f(min.x, max.y, min.z); glVertex3f(max.x, max.y, min.z);
-        glVertex3f(max.x, max.y, min.z); glVertex3f(max.x, max.y, max.z);
-        glVertex3f(max.x, max.y, max.z); glVertex3f(min.x, max.y, max.z);
-        glVertex3f(min.x, max.y, max.z); glVertex3f(min.x, max.y, min.z);
+    // Compile-time query: onHit(Face*) for every face intersect accepts, see acceleratortraversal.h
+    template <typename Intersector, typename HitHandler, typename Counting = NoTraversalCounting>
+    void forEachHit(const Ray& ray, const Intersector& intersect, HitHandler&& onHit, Counting counting = Counting()) const {
+        traverseBoxTree(Layout(*this), ray, intersect, onHit, counting);
+    }
 
-        // Vertical edges
-        glVertex3f(min.x, min.y, min.z); glVertex3f(min.x, max.y, min.z);
-        glVertex3f(max.x, min.y, min.z); glVertex3f(max.x, max.y, min.z);
-        glVertex3f(max.x, min.y, max.z); glVertex3f(max.x, max.y, max.z);
-        glVertex3f(min.x, min.y, max.z); glVertex3f(min.x, max.y, max.z);
+    // Compile-time frustum query: onFace(Face*) for every face overlapping the frustum
+    template <typename FaceHandler, typename Counting = NoTraversalCounting>
+    void forEachInFrustum(const Frustum& frustum, FaceHandler&& onFace, Counting counting = Counting()) const {
+        traverseBoxTreeInFrustum(Layout(*this), frustum, onFace, counting);
+    }
 
-        glEnd();
+    void traverse(const Ray& ray, std::vector<Face*>& hitFaces, TraversalCounters* counters = nullptr) const override {
+        FaceCollector collect(hitFaces);
+        if (counters) forEachHit(ray, FaceRayIntersector(), collect, TraversalCounting(*counters));
+        else forEachHit(ray, FaceRayIntersector(), collect);
+    }
 
-        // Recursively draw child nodes if they exist
-        drawBVHNode(node->left);
-        drawBVHNode(node->right);
+    AcceleratorStats getStats() const override {
+        AcceleratorStats stats;
+        stats.type = "BVH";
+        stats.triangles = triangles.size();
+        stats.buildMilliseconds = buildMilliseconds;
+        size_t depthSum = 0, leafReferences = 0, filledLeaves = 0;
+        if (root) {
+            accumulateStats(root, 0, root->boundingBox.getSurfaceArea(), stats, depthSum, leafReferences, filledLeaves);
+        }
+        finishStats(stats, depthSum, leafReferences, filledLeaves);
+        stats.memoryBytes = stats.nodes * sizeof(BVHNode) + triangles.capacity() * sizeof(Face*);
+        return stats;
     }
 };
 
@@ -303,6 +422,19 @@ private:
     KDTreeNode* root; // Root node of the KD-Tree
     std::vector<Face*> triangles; // All faces in the scene
 
+    static KDTreeNode* cloneNode(const KDTreeNode* node, const std::vector<Face>& from, const std::vector<Face>& to) {
+        if (!node) return nullptr;
+        KDTreeNode* copy = new KDTreeNode();
+        copy->boundingBox = node->boundingBox;
+        copy->splitPosition = node->splitPosition;
+        copy->splitAxis = node->splitAxis;
+        copy->isLeaf = node->isLeaf;
+        copy->faces = rebase(node->faces, from, to);
+        copy->left = cloneNode(node->left, from, to);
+        copy->right = cloneNode(node->right, from, to);
+        return copy;
+    }
+
     void buildKDTree(KDTreeNode* node, const std::vector<Face*>& faces, int depth) {
         // Always initialize the bounding box, even for empty face lists
         if (faces.empty()) {
@@ -385,7 +517,49 @@ private:
         return box;
     }
 
+    void accumulateStats(const KDTreeNode* node, int depth, double rootArea, AcceleratorStats& stats,
+                         size_t& depthSum, size_t& leafReferences, size_t& filledLeaves) const {
+        double area = rootArea > 0.0 ? node->boundingBox.getSurfaceArea() / rootArea : 0.0;
+        stats.nodes++;
+        stats.memoryBytes += sizeof(KDTreeNode) + node->faces.capacity() * sizeof(Face*);
+        if (node->isLeaf) {
+            size_t count = node->faces.size();
+            stats.leaves++;
+            stats.maxDepth = std::max(stats.maxDepth, depth);
+            depthSum += depth;
+            leafReferences += count;
+            if (count == 0) stats.emptyLeaves++;
+            else filledLeaves++;
+            if (depth >= KDT_MAX_DEPTH && count > 4) stats.depthLimitedLeaves++;
+            stats.sahCost += area * SAH_INTERSECTION_COST * count;
+            return;
+        }
+        stats.sahCost += area * SAH_TRAVERSAL_COST;
+        if (node->left) accumulateStats(node->left, depth + 1, rootArea, stats, depthSum, leafReferences, filledLeaves);
+        if (node->right) accumulateStats(node->right, depth + 1, rootArea, stats, depthSum, leafReferences, filledLeaves);
+    }
+
 public:
+    // Node access for the traversal core
+    struct Layout {
+        typedef const KDTreeNode* NodeRef;
+        static const int maxDepth = KDT_MAX_DEPTH;
+        const KDTree& tree;
+
+        explicit Layout(const KDTree& tree) : tree(tree) {}
+        bool empty() const { return tree.root == nullptr; }
+        NodeRef root() const { return tree.root; }
+        bool isNull(NodeRef node) const { return node == nullptr; }
+        const AABB& box(NodeRef node) const { return node->boundingBox; }
+        bool isLeaf(NodeRef node) const { return node->isLeaf; }
+        Face* const* leafBegin(NodeRef node) const { return node->faces.data(); }
+        Face* const* leafEnd(NodeRef node) const { return node->faces.data() + node->faces.size(); }
+        int splitAxis(NodeRef node) const { return node->splitAxis; }
+        float splitPosition(NodeRef node) const { return node->splitPosition; }
+        NodeRef left(NodeRef node) const { return node->left; }
+        NodeRef right(NodeRef node) const { return node->right; }
+    };
+
     KDTree() : root(nullptr) {}
     ~KDTree() {
         delete root;
@@ -395,192 +569,413 @@ public:
         return root;
     }
 
-    void build(const std::vector<Mesh>& meshes) override {
+    void build(const std::vector<Face>& faces) override {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
         triangles.clear();
-        for (const Mesh& mesh : meshes) {
-            for (const Face& face : mesh.faces) {
-                triangles.push_back(const_cast<Face*>(&face));
-            }
+        triangles.reserve(faces.size());
+        for (const Face& face : faces) {
+            triangles.push_back(const_cast<Face*>(&face));
         }
         
         if (triangles.empty()) {
             root = nullptr;
+            buildMilliseconds = millisecondsSince(start);
             return;
         }
         
         if (root) delete root;
         root = new KDTreeNode();
         buildKDTree(root, triangles, 0);
+        buildMilliseconds = millisecondsSince(start);
     }
 
-    void traverse(void* node_ptr, const Ray& ray, std::vector<Face*>& hitFaces) override {
-        KDTreeNode* node = static_cast<KDTreeNode*>(node_ptr);
-        if (!node) return;
-        
-        // Non-recursive traversal using a stack
-        struct StackEntry {
-            KDTreeNode* node;
-            float tMin, tMax;
-            StackEntry(KDTreeNode* n, float min, float max) : node(n), tMin(min), tMax(max) {}
-        };
-        
-        std::stack<StackEntry> stack;
-        stack.push(StackEntry(node, ray.tMin, ray.tMax));
-        
-        while (!stack.empty()) {
-            StackEntry entry = stack.top();
-            stack.pop();
-            
-            KDTreeNode* current = entry.node;
-            float tMin = entry.tMin;
-            float tMax = entry.tMax;
-            
-            // Skip if node is null or has invalid bounding box
-            if (!current || glm::any(glm::isnan(current->boundingBox.min)) ||
-                glm::any(glm::isnan(current->boundingBox.max))) {
-                continue;
-            }
-            
-            // Skip if the ray doesn't intersect the node's bounding box
-            if (!current->boundingBox.isIntersectingRay(ray.origin, ray.direction, tMin, tMax)) {
-                continue;
-            }
-            
-            // If it's a leaf node, check for intersections with triangles
-            if (current->isLeaf) {
-                for (Face* face : current->faces) {
-                    if (face && face->isIntersectingRay(ray.origin, ray.direction, ray.tMin, ray.tMax)) {
-                        hitFaces.push_back(face);
-                    }
-                }
-                continue;
-            }
-            
-            // Skip if split axis is invalid
-            if (current->splitAxis < 0 || current->splitAxis > 2) {
-                continue;
-            }
-            
-            // Calculate intersection with the splitting plane
-            int axis = current->splitAxis;
-            float splitPos = current->splitPosition;
-            float tSplit = (splitPos - ray.origin[axis]) / ray.direction[axis];
-            
-            // Determine which child to traverse first based on ray direction
-            KDTreeNode* firstChild = nullptr;
-            KDTreeNode* secondChild = nullptr;
-            
-            if (ray.origin[axis] < splitPos || (ray.origin[axis] == splitPos && ray.direction[axis] <= 0)) {
-                firstChild = current->left;
-                secondChild = current->right;
-            } else {
-                firstChild = current->right;
-                secondChild = current->left;
-            }
-            
-            // Handle parallel rays
-            if (std::abs(ray.direction[axis]) < std::numeric_limits<float>::epsilon()) {
-                if (firstChild) stack.push(StackEntry(firstChild, tMin, tMax));
-            }
-            // Handle general case
-            else if (tSplit >= tMax || tSplit <= 0) {
-                if (firstChild) stack.push(StackEntry(firstChild, tMin, tMax));
-            }
-            else if (tSplit <= tMin) {
-                if (secondChild) stack.push(StackEntry(secondChild, tMin, tMax));
-            }
-            else {
-                // Ray passes through the splitting plane, visit both children
-                if (secondChild) stack.push(StackEntry(secondChild, tSplit, tMax));
-                if (firstChild) stack.push(StackEntry(firstChild, tMin, tSplit));
+    SpatialAccelerator* clone(const std::vector<Face>& from, const std::vector<Face>& to) const override {
+        KDTree* copy = new KDTree();
+        copy->root = cloneNode(root, from, to);
+        copy->triangles = rebase(triangles, from, to);
+        copy->buildMilliseconds = buildMilliseconds;
+        return copy;
+    }
+
+    AcceleratorType getType() const override {
+        return ACCELERATOR_KDTREE;
+    }
+
+    // Compile-time query: onHit(Face*) for every face intersect accepts, see acceleratortraversal.h
+    template <typename Intersector, typename HitHandler, typename Counting = NoTraversalCounting>
+    void forEachHit(const Ray& ray, const Intersector& intersect, HitHandler&& onHit, Counting counting = Counting()) const {
+        traverseSplitTree(Layout(*this), ray, intersect, onHit, counting);
+    }
+
+    // Compile-time frustum query: onFace(Face*) for every face overlapping the frustum
+    template <typename FaceHandler, typename Counting = NoTraversalCounting>
+    void forEachInFrustum(const Frustum& frustum, FaceHandler&& onFace, Counting counting = Counting()) const {
+        traverseSplitTreeInFrustum(Layout(*this), frustum, onFace, counting);
+    }
+
+    void traverse(const Ray& ray, std::vector<Face*>& hitFaces, TraversalCounters* counters = nullptr) const override {
+        FaceCollector collect(hitFaces);
+        if (counters) forEachHit(ray, FaceRayIntersector(), collect, TraversalCounting(*counters));
+        else forEachHit(ray, FaceRayIntersector(), collect);
+    }
+
+    AcceleratorStats getStats() const override {
+        AcceleratorStats stats;
+        stats.type = "KD-tree";
+        stats.triangles = triangles.size();
+        stats.buildMilliseconds = buildMilliseconds;
+        size_t depthSum = 0, leafReferences = 0, filledLeaves = 0;
+        if (root) {
+            accumulateStats(root, 0, root->boundingBox.getSurfaceArea(), stats, depthSum, leafReferences, filledLeaves);
+        }
+        finishStats(stats, depthSum, leafReferences, filledLeaves);
+        stats.memoryBytes += triangles.capacity() * sizeof(Face*);
+        return stats;
+    }
+};
+
+// Linear BVH: Morton ordered triangles, nodes in one array in depth first order
+class LBVH : public SpatialAccelerator {
+public:
+    struct LBVHNode {
+        AABB boundingBox;
+        unsigned int first;  // Leaf: first triangle in triangles
+        unsigned int count;  // Leaf: triangle count, 0 for internal nodes
+        unsigned int right;  // Internal: index of the right child, the left child follows the node
+    };
+
+private:
+    std::vector<LBVHNode> nodes;
+    std::vector<Face*> triangles; // Morton order, leaves refer to ranges of it
+
+    // Spread the low 10 bits of v so that two zero bits follow each of them
+    static uint32_t expandBits(uint32_t v) {
+        v &= 0x3ff;
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    }
+
+    // 30 bit Morton code of a point given relative to the centroid bounds (0..1 per axis)
+    static uint32_t mortonCode(const glm::vec3& relative) {
+        uint32_t x = static_cast<uint32_t>(std::min(std::max(relative.x * 1024.0f, 0.0f), 1023.0f));
+        uint32_t y = static_cast<uint32_t>(std::min(std::max(relative.y * 1024.0f, 0.0f), 1023.0f));
+        uint32_t z = static_cast<uint32_t>(std::min(std::max(relative.z * 1024.0f, 0.0f), 1023.0f));
+        return (expandBits(x) << 2) | (expandBits(y) << 1) | expandBits(z);
+    }
+
+    // First index of the upper half of [start, end): where the highest bit that differs between
+    // the first and last code becomes set. Ranges of equal codes are halved.
+    static unsigned int findSplit(const std::vector<uint32_t>& codes, unsigned int start, unsigned int end) {
+        uint32_t first = codes[start];
+        uint32_t last = codes[end - 1];
+        if (first == last) return (start + end) / 2;
+
+        int bit = 0;
+        for (uint32_t differing = first ^ last; differing > 1; differing >>= 1) bit++;
+        uint32_t upperHalf = ((first >> bit) | 1u) << bit;
+        return static_cast<unsigned int>(std::lower_bound(codes.begin() + start, codes.begin() + end, upperHalf) - codes.begin());
+    }
+
+    unsigned int emitNode(const std::vector<uint32_t>& codes, unsigned int start, unsigned int end, int depth) {
+        unsigned int index = static_cast<unsigned int>(nodes.size());
+        nodes.push_back(LBVHNode());
+        if (end - start <= LBVH_LEAF_SIZE || depth >= LBVH_MAX_DEPTH) {
+            AABB box;
+            box.min = glm::vec3(FLT_MAX);
+            box.max = glm::vec3(-FLT_MAX);
+            for (unsigned int i = start; i < end; ++i) {
+                box.merge(triangles[i]->boundingBox);
             }
+            nodes[index].boundingBox = box;
+            nodes[index].first = start;
+            nodes[index].count = end - start;
+            nodes[index].right = 0;
+            return index;
         }
+
+        unsigned int split = findSplit(codes, start, end);
+        emitNode(codes, start, split, depth + 1);
+        unsigned int right = emitNode(codes, split, end, depth + 1);
+        // nodes may have grown, index again instead of holding a reference across the recursion
+        AABB box = nodes[index + 1].boundingBox;
+        box.merge(nodes[right].boundingBox);
+        nodes[index].boundingBox = box;
+        nodes[index].first = 0;
+        nodes[index].count = 0;
+        nodes[index].right = right;
+        return index;
+    }
+
+public:
+    // Node access for the traversal core
+    struct Layout {
+        typedef unsigned int NodeRef; // Index into nodes
+        static const int maxDepth = LBVH_MAX_DEPTH;
+        const LBVH& tree;
+
+        explicit Layout(const LBVH& tree) : tree(tree) {}
+        bool empty() const { return tree.nodes.empty(); }
+        NodeRef root() const { return 0; }
+        const AABB& box(NodeRef node) const { return tree.nodes[node].boundingBox; }
+        bool isLeaf(NodeRef node) const { return tree.nodes[node].count > 0; }
+        Face* const* leafBegin(NodeRef node) const { return tree.triangles.data() + tree.nodes[node].first; }
+        Face* const* leafEnd(NodeRef node) const { return tree.triangles.data() + tree.nodes[node].first + tree.nodes[node].count; }
+        void children(NodeRef node, NodeRef& first, NodeRef& second) const { first = node + 1; second = tree.nodes[node].right; }
+    };
+
+    const std::vector<LBVHNode>& getNodes() const {
+        return nodes;
     }
 
-    void drawDebug() const override {
-        drawKDTreeNode(root);
+    AcceleratorType getType() const override {
+        return ACCELERATOR_LBVH;
     }
 
-    void drawKDTreeNode(const KDTreeNode* node) const {
-        if (!node) return;
-        
-        // Safety check for invalid or uninitialized bounding boxes
-        if (glm::any(glm::isnan(node->boundingBox.min)) ||
-            glm::any(glm::isnan(node->boundingBox.max)) ||
-            glm::any(glm::isinf(node->boundingBox.min)) ||
-            glm::any(glm::isinf(node->boundingBox.max))) {
+    void build(const std::vector<Face>& faces) override {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        nodes.clear();
+        triangles.clear();
+        if (faces.empty()) {
+            buildMilliseconds = millisecondsSince(start);
             return;
         }
-        
-        // Draw the bounding box
-        const glm::vec3& min = node->boundingBox.min;
-        const glm::vec3& max = node->boundingBox.max;
-        
-        glColor3f(0.0f, 0.0f, 1.0f); // Blue color for KD-Tree
-        glBegin(GL_LINES);
-        
-        // Bottom face
-        glVertex3f(min.x, min.y, min.z); glVertex3f(max.x, min.y, min.z);
-        glVertex3f(max.x, min.y, min.z); glVertex3f(max.x, min.y, max.z);
-        glVertex3f(max.x, min.y, max.z); glVertex3f(min.x, min.y, max.z);
-        glVertex3f(min.x, min.y, max.z); glVertex3f(min.x, min.y, min.z);
-        
-        // Top face
-        glVertex3f(min.x, max.y, min.z); glVertex3f(max.x, max.y, min.z);
-        glVertex3f(max.x, max.y, min.z); glVertex3f(max.x, max.y, max.z);
-        glVertex3f(max.x, max.y, max.z); glVertex3f(min.x, max.y, max.z);
-        glVertex3f(min.x, max.y, max.z); glVertex3f(min.x, max.y, min.z);
-
-        // Vertical edges
-        glVertex3f(min.x, min.y, min.z); glVertex3f(min.x, max.y, min.z);
-        glVertex3f(max.x, min.y, min.z); glVertex3f(max.x, max.y, min.z);
-        glVertex3f(max.x, min.y, max.z); glVertex3f(max.x, max.y, max.z);
-        glVertex3f(min.x, min.y, max.z); glVertex3f(min.x, max.y, max.z);
-
-        glEnd();
-        
-        // Draw the splitting plane if not a leaf
-        if (!node->isLeaf && node->splitAxis >= 0 && node->splitAxis <= 2) {
-            glColor3f(1.0f, 0.0f, 0.0f); // Red color for splitting planes
-            glBegin(GL_QUADS);
-            
-            int axis = node->splitAxis;
-            float pos = node->splitPosition;
-            
-            if (axis == 0) { // X-axis
-                glVertex3f(pos, min.y, min.z);
-                glVertex3f(pos, max.y, min.z);
-                glVertex3f(pos, max.y, max.z);
-                glVertex3f(pos, min.y, max.z);
-            } else if (axis == 1) { // Y-axis
-                glVertex3f(min.x, pos, min.z);
-                glVertex3f(max.x, pos, min.z);
-                glVertex3f(max.x, pos, max.z);
-                glVertex3f(min.x, pos, max.z);
-            } else if (axis == 2) { // Z-axis
-                glVertex3f(min.x, min.y, pos);
-                glVertex3f(max.x, min.y, pos);
-                glVertex3f(max.x, max.y, pos);
-                glVertex3f(min.x, max.y, pos);
+
+        glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+        for (const Face& face : faces) {
+            low = glm::min(low, face.centroid);
+            high = glm::max(high, face.centroid);
+        }
+        glm::vec3 extent = high - low;
+        glm::vec3 scale(extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+                        extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+                        extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+        // Code and face index in one key, so the sort moves 8 bytes per triangle
+        std::vector<uint64_t> keys(faces.size());
+        for (size_t i = 0; i < faces.size(); ++i) {
+            keys[i] = (static_cast<uint64_t>(mortonCode((faces[i].centroid - low) * scale)) << 32) | i;
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<uint32_t> codes(keys.size());
+        triangles.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            codes[i] = static_cast<uint32_t>(keys[i] >> 32);
+            triangles[i] = const_cast<Face*>(&faces[static_cast<uint32_t>(keys[i])]);
+        }
+
+        nodes.reserve(2 * (faces.size() / LBVH_LEAF_SIZE + 1));
+        emitNode(codes, 0, static_cast<unsigned int>(triangles.size()), 0);
+        buildMilliseconds = millisecondsSince(start);
+    }
+
+    SpatialAccelerator* clone(const std::vector<Face>& from, const std::vector<Face>& to) const override {
+        LBVH* copy = new LBVH();
+        copy->nodes = nodes;
+        copy->triangles = rebase(triangles, from, to);
+        copy->buildMilliseconds = buildMilliseconds;
+        return copy;
+    }
+
+    // Compile-time query: onHit(Face*) for every face intersect accepts, see acceleratortraversal.h
+    template <typename Intersector, typename HitHandler, typename Counting = NoTraversalCounting>
+    void forEachHit(const Ray& ray, const Intersector& intersect, HitHandler&& onHit, Counting counting = Counting()) const {
+        traverseBoxTree(Layout(*this), ray, intersect, onHit, counting);
+    }
+
+    // Compile-time frustum query: onFace(Face*) for every face overlapping the frustum
+    template <typename FaceHandler, typename Counting = NoTraversalCounting>
+    void forEachInFrustum(const Frustum& frustum, FaceHandler&& onFace, Counting counting = Counting()) const {
+        traverseBoxTreeInFrustum(Layout(*this), frustum, onFace, counting);
+    }
+
+    void traverse(const Ray& ray, std::vector<Face*>& hitFaces, TraversalCounters* counters = nullptr) const override {
+        FaceCollector collect(hitFaces);
+        if (counters) forEachHit(ray, FaceRayIntersector(), collect, TraversalCounting(*counters));
+        else forEachHit(ray, FaceRayIntersector(), collect);
+    }
+
+    AcceleratorStats getStats() const override {
+        AcceleratorStats stats;
+        stats.type = "LBVH";
+        stats.triangles = triangles.size();
+        stats.buildMilliseconds = buildMilliseconds;
+        size_t depthSum = 0, leafReferences = 0, filledLeaves = 0;
+        if (!nodes.empty()) {
+            double rootArea = nodes[0].boundingBox.getSurfaceArea();
+            // Node index and depth, depth first like the traversal
+            std::vector<std::pair<unsigned int, int>> stack(1, std::make_pair(0u, 0));
+            while (!stack.empty()) {
+                unsigned int index = stack.back().first;
+                int depth = stack.back().second;
+                stack.pop_back();
+                const LBVHNode& node = nodes[index];
+                double area = rootArea > 0.0 ? node.boundingBox.getSurfaceArea() / rootArea : 0.0;
+                stats.nodes++;
+                if (node.count > 0) {
+                    stats.leaves++;
+                    filledLeaves++;
+                    stats.maxDepth = std::max(stats.maxDepth, depth);
+                    depthSum += depth;
+                    leafReferences += node.count;
+                    if (depth >= LBVH_MAX_DEPTH && node.count > LBVH_LEAF_SIZE) stats.depthLimitedLeaves++;
+                    stats.sahCost += area * SAH_INTERSECTION_COST * node.count;
+                    continue;
+                }
+                stats.sahCost += area * SAH_TRAVERSAL_COST;
+                stack.push_back(std::make_pair(node.right, depth + 1));
+                stack.push_back(std::make_pair(index + 1, depth + 1));
             }
-            
-            glEnd();
         }
-        
-        // Recursively draw child nodes with safety checks
-        if (node->left) drawKDTreeNode(node->left);
-        if (node->right) drawKDTreeNode(node->right);
+        finishStats(stats, depthSum, leafReferences, filledLeaves);
+        stats.memoryBytes = nodes.capacity() * sizeof(LBVHNode) + triangles.capacity() * sizeof(Face*);
+        return stats;
     }
 };
 
-// Factory class to create the appropriate accelerator based on optimization mode
+// Call visit() with the accelerator as its concrete type. The switch runs once, every query the
+// visitor makes goes through that type's specialised forEachHit().
+template <typename Visitor>
+inline void visitAccelerator(const SpatialAccelerator& accelerator, Visitor&& visit) {
+    switch (accelerator.getType()) {
+        case ACCELERATOR_BVH: visit(static_cast<const BVH&>(accelerator)); break;
+        case ACCELERATOR_KDTREE: visit(static_cast<const KDTree&>(accelerator)); break;
+        case ACCELERATOR_LBVH: visit(static_cast<const LBVH&>(accelerator)); break;
+        default: break;
+    }
+}
+
+// Queries a geometry is assumed to get before enough have been measured
+#define ACCELERATOR_AUTO_QUERIES 256
+// Largest accelerator the automatic choice builds for one geometry
+#define ACCELERATOR_MEMORY_BUDGET (256u * 1024u * 1024u)
+// Picks that time their queries for the cost model: one in this many
+#define ACCELERATOR_QUERY_SAMPLE_INTERVAL 16
+// Automatic choices that try the least measured type instead: one in this many
+#define ACCELERATOR_EXPLORE_INTERVAL 8
+// Largest geometry an exploring choice is made for, a slow type costs little to try on it
+#define ACCELERATOR_EXPLORE_TRIANGLES 100000
+
+/*
+* Picks the accelerator type for a geometry when the model is set to ACCELERATOR_AUTO.
+*
+* Each type has a cost model: build time per triangle, query time per tree level (log2 of the
+* triangle count) and memory per triangle. The defaults were measured with geometrybench; every
+* build and query the model reports moves them towards what this machine and these scenes measure.
+* The chosen type minimizes build time plus the expected queries times the query time, among the
+* types whose estimated memory fits the budget. Expected queries follow the measured ratio of
+* queries to builds, so a session that picks a lot drifts to structures that query faster.
+* Only one pick in ACCELERATOR_QUERY_SAMPLE_INTERVAL is timed (sampleQuery()), each of its
+* queries counts for that many.
+*
+* Only built types get measured, so left alone the first choice would stay the choice for good.
+* One choice in ACCELERATOR_EXPLORE_INTERVAL, for geometry of at most ACCELERATOR_EXPLORE_TRIANGLES,
+* builds the type with the fewest measured builds instead; the models are per triangle and per
+* level, so what small geometry measures carries over to large.
+*
+* Thread safe, builds report from the job system.
+*/
+class AcceleratorSelector {
+public:
+    AcceleratorSelector() : memoryBudget(ACCELERATOR_MEMORY_BUDGET), builds(0), queries(0), choices(0), picks(0) {
+        // Build ns per triangle, query ns per level, bytes per triangle
+        models[ACCELERATOR_BVH] = CostModel(3000.0, 300.0, 40.0);
+        models[ACCELERATOR_KDTREE] = CostModel(5000.0, 1000.0, 600.0);
+        models[ACCELERATOR_LBVH] = CostModel(150.0, 350.0, 44.0);
+    }
+
+    AcceleratorType choose(size_t triangles) {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool explore = ++choices % ACCELERATOR_EXPLORE_INTERVAL == 0 && triangles <= ACCELERATOR_EXPLORE_TRIANGLES;
+        double levels = std::log2(static_cast<double>(triangles) + 2.0);
+        double expectedQueries = std::max<double>(ACCELERATOR_AUTO_QUERIES, builds > 0 ? static_cast<double>(queries) / builds : 0.0);
+
+        AcceleratorType best = ACCELERATOR_AUTO;
+        double bestCost = 0.0;
+        AcceleratorType smallest = ACCELERATOR_BVH;
+        AcceleratorType leastMeasured = ACCELERATOR_AUTO;
+        for (int candidate = ACCELERATOR_BVH; candidate < ACCELERATOR_TYPE_COUNT; ++candidate) {
+            const CostModel& model = models[candidate];
+            if (model.bytesPerTriangle < models[smallest].bytesPerTriangle) smallest = static_cast<AcceleratorType>(candidate);
+            if (model.bytesPerTriangle * triangles > memoryBudget) continue;
+            if (leastMeasured == ACCELERATOR_AUTO || model.builds < models[leastMeasured].builds) {
+                leastMeasured = static_cast<AcceleratorType>(candidate);
+            }
+
+            double cost = model.buildNsPerTriangle * triangles + expectedQueries * model.queryNsPerLevel * levels;
+            if (best == ACCELERATOR_AUTO || cost < bestCost) {
+                best = static_cast<AcceleratorType>(candidate);
+                bestCost = cost;
+            }
+        }
+        if (explore && leastMeasured != ACCELERATOR_AUTO) return leastMeasured;
+        // Nothing fits, take the least memory
+        return best == ACCELERATOR_AUTO ? smallest : best;
+    }
+
+    void recordBuild(AcceleratorType type, const AcceleratorStats& stats) {
+        if (type <= ACCELERATOR_AUTO || type >= ACCELERATOR_TYPE_COUNT || stats.triangles == 0) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        CostModel& model = models[type];
+        model.buildNsPerTriangle = blend(model.buildNsPerTriangle, stats.buildMilliseconds * 1e6 / stats.triangles);
+        model.bytesPerTriangle = blend(model.bytesPerTriangle, static_cast<double>(stats.memoryBytes) / stats.triangles);
+        model.builds++;
+        builds++;
+    }
+
+    void recordQuery(AcceleratorType type, size_t triangles, double nanoseconds) {
+        if (type <= ACCELERATOR_AUTO || type >= ACCELERATOR_TYPE_COUNT) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        CostModel& model = models[type];
+        model.queryNsPerLevel = blend(model.queryNsPerLevel, nanoseconds / std::log2(static_cast<double>(triangles) + 2.0));
+        queries += ACCELERATOR_QUERY_SAMPLE_INTERVAL;
+    }
+
+    // Whether this pick should time its queries and report them with recordQuery()
+    bool sampleQuery() {
+        return picks.fetch_add(1, std::memory_order_relaxed) % ACCELERATOR_QUERY_SAMPLE_INTERVAL == 0;
+    }
+
+    void setMemoryBudget(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        memoryBudget = bytes;
+    }
+
+private:
+    struct CostModel {
+        double buildNsPerTriangle;
+        double queryNsPerLevel;
+        double bytesPerTriangle;
+        uint64_t builds; // Builds measured
+        CostModel() : buildNsPerTriangle(0.0), queryNsPerLevel(0.0), bytesPerTriangle(0.0), builds(0) {}
+        CostModel(double build, double query, double bytes) : buildNsPerTriangle(build), queryNsPerLevel(query), bytesPerTriangle(bytes), builds(0) {}
+    };
+
+    mutable std::mutex mutex;
+    CostModel models[ACCELERATOR_TYPE_COUNT]; // Indexed by type, AUTO unused
+    size_t memoryBudget;
+    uint64_t builds;
+    uint64_t queries;
+    uint64_t choices;
+    std::atomic<uint32_t> picks; // Lock free, counted on every pick
+
+    // Moving average, recent measurements weigh more than the defaults
+    static double blend(double current, double measured) {
+        return current * 0.8 + measured * 0.2;
+    }
+};
+
+// Creates an accelerator of a concrete type; resolve ACCELERATOR_AUTO with an AcceleratorSelector first
 class SpatialAcceleratorFactory {
 public:
-    static SpatialAccelerator* createAccelerator() {
-#if SPACIAL_OPT_MODE == SPACIAL_OPT_MEMORY
-        return new BVH();
-#else
-        return new KDTree();
-#endif
-    }
-};
\ No newline at end of file
+    static SpatialAccelerator* createAccelerator(AcceleratorType type) {
+        switch (type) {
+            case ACCELERATOR_BVH: return new BVH();
+            case ACCELERATOR_LBVH: return new LBVH();
+            default: return new KDTree();
+        }
+    }
+};
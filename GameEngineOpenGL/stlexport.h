@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "log.h"
+#include "Mesh.h"
+
+/*
+* Binary STL export of a scene.
+*
+* Every visible mesh is written with its world transform applied, so the file reloads in place.
+* Triangles are streamed mesh by mesh through a fixed size buffer; exporting a scene of a hundred
+* million triangles needs memory for one mesh's world vertices, not for the file.
+*/
+
+class STLExport {
+public:
+    // Returns the number of triangles written, 0 on failure (nothing visible also writes 0)
+    static uint64_t writeBinary(const std::string& filePath, const MeshStore& meshes) {
+        uint64_t triangleCount = 0;
+        for (size_t m = 0; m < meshes.size(); ++m) {
+            if (meshes[m].isVisible) triangleCount += meshes[m].geometry->indices.size() / 3;
+        }
+        if (triangleCount > UINT32_MAX) {
+            logMessage(LOG_ERROR, "Scene has more triangles than binary STL can hold");
+            return 0;
+        }
+
+        std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            logMessage(LOG_ERROR, "Failed to create STL file: " + filePath);
+            return 0;
+        }
+
+        char header[80] = {};
+        std::strncpy(header, "Binary STL exported by CAD-Visualizer-Tool", sizeof(header) - 1);
+        uint32_t count = static_cast<uint32_t>(triangleCount);
+        file.write(header, sizeof(header));
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+        const size_t recordSize = 50; // Normal, three vertices, attribute byte count
+        const size_t recordsPerChunk = 4096;
+        std::vector<char> chunk;
+        chunk.reserve(recordSize * recordsPerChunk);
+        std::vector<float> worldVertices;
+
+        for (size_t m = 0; m < meshes.size(); ++m) {
+            const Mesh& mesh = meshes[m];
+            if (!mesh.isVisible) continue;
+            mesh.getWorldVertices(worldVertices);
+
+            const std::vector<unsigned int>& indices = mesh.geometry->indices;
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                glm::vec3 corners[3];
+                for (int c = 0; c < 3; ++c) {
+                    const float* v = &worldVertices[indices[i + c] * 3];
+                    corners[c] = glm::vec3(v[0], v[1], v[2]);
+                }
+                glm::vec3 normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                float length = glm::length(normal);
+                normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+
+                float record[12] = { normal.x, normal.y, normal.z };
+                for (int c = 0; c < 3; ++c) {
+                    record[3 + c * 3] = corners[c].x;
+                    record[4 + c * 3] = corners[c].y;
+                    record[5 + c * 3] = corners[c].z;
+                }
+                const char* bytes = reinterpret_cast<const char*>(record);
+                chunk.insert(chunk.end(), bytes, bytes + sizeof(record));
+                chunk.insert(chunk.end(), 2, '\0');
+
+                if (chunk.size() >= recordSize * recordsPerChunk) {
+                    file.write(chunk.data(), chunk.size());
+                    chunk.clear();
+                }
+            }
+        }
+        file.write(chunk.data(), chunk.size());
+
+        if (!file) {
+            logMessage(LOG_ERROR, "Failed to write STL file: " + filePath);
+            return 0;
+        }
+        return triangleCount;
+    }
+};
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+* Timeline capture in the Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+*
+* Every thread appends to its own ring buffer of the last TRACE_BUFFER_EVENTS events. Only the
+* owning thread writes a buffer, so appending is a few relaxed stores and one release store, with
+* no lock and no allocation. A long session keeps the most recent events of each thread. The ring
+* is allocated by a thread's first event of a capture, so threads that never record while
+* capturing (e.g. idle job system workers) cost no buffer.
+*
+* Every PROFILE_SCOPE (profiler.h) becomes an event while a capture is running, so the render loop,
+* UI message handling, imports, picks and accelerator builds all show up; TRACE_SCOPE adds
+* trace-only scopes, e.g. each job run by the job system. When no capture is running a TRACE_SCOPE
+* costs one atomic load and reads no clock.
+*
+*   TraceRecorder::instance().start();
+*   ...
+*   TraceRecorder::instance().writeChromeJSON(file);
+*
+* writeChromeJSON() may run while other threads keep appending: events overwritten during the copy
+* are detected through the buffer's head counter and left out.
+*/
+
+// Follows PROFILING_ENABLED unless set on its own
+#ifndef TRACING_ENABLED
+#if defined(PROFILING_ENABLED) && !PROFILING_ENABLED
+#define TRACING_ENABLED 0
+#else
+#define TRACING_ENABLED 1
+#endif
+#endif
+
+#define TRACE_BUFFER_EVENTS 65536
+
+class TraceRecorder {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static TraceRecorder& instance() {
+        static TraceRecorder recorder;
+        return recorder;
+    }
+
+    // Events are recorded between start() and stop(). start() drops events of an earlier capture.
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+            buffer->head.store(0, std::memory_order_relaxed);
+        }
+        capturing.store(true, std::memory_order_release);
+    }
+
+    void stop() {
+        capturing.store(false, std::memory_order_release);
+    }
+
+    bool isCapturing() const {
+        return capturing.load(std::memory_order_relaxed);
+    }
+
+    // Name shown for the calling thread's track. Registers the thread without allocating its ring.
+    void setThreadName(const std::string& name) {
+        ThreadBuffer& buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(mutex);
+        buffer.name = name;
+    }
+
+    // name must outlive the capture (string literals, profiler stat names)
+    void record(const char* name, Clock::time_point begin, Clock::time_point end) {
+        if (!isCapturing()) return;
+        ThreadBuffer& buffer = threadBuffer();
+        if (!buffer.events) {
+            // First event of this thread, the ring is published under the lock writeChromeJSON() takes
+            std::lock_guard<std::mutex> lock(mutex);
+            buffer.events.reset(new Event[TRACE_BUFFER_EVENTS]);
+        }
+        uint64_t index = buffer.head.load(std::memory_order_relaxed);
+        Event& event = buffer.events[index % TRACE_BUFFER_EVENTS];
+        event.name.store(name, std::memory_order_relaxed);
+        event.beginNs.store(toNanoseconds(begin), std::memory_order_relaxed);
+        event.endNs.store(toNanoseconds(end), std::memory_order_relaxed);
+        buffer.head.store(index + 1, std::memory_order_release);
+    }
+
+    void writeChromeJSON(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Microseconds with nanosecond digits: default formatting rounds to 6 significant digits,
+        // which merges events microseconds apart after a second of capture
+        std::ios_base::fmtflags flags = out.flags();
+        std::streamsize precision = out.precision();
+        out << std::fixed << std::setprecision(3);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+            if (!buffer->name.empty()) {
+                out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+                    << ",\"args\":{\"name\":\"" << escape(buffer->name) << "\"}}";
+                first = false;
+            }
+            if (!buffer->events) continue;
+
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t oldest = head > TRACE_BUFFER_EVENTS ? head - TRACE_BUFFER_EVENTS : 0;
+            std::vector<std::pair<uint64_t, Snapshot>> copied;
+            copied.reserve(static_cast<size_t>(head - oldest));
+            for (uint64_t index = oldest; index < head; ++index) {
+                const Event& event = buffer->events[index % TRACE_BUFFER_EVENTS];
+                Snapshot snapshot;
+                snapshot.name = event.name.load(std::memory_order_relaxed);
+                snapshot.beginNs = event.beginNs.load(std::memory_order_relaxed);
+                snapshot.endNs = event.endNs.load(std::memory_order_relaxed);
+                copied.push_back(std::make_pair(index, snapshot));
+            }
+
+            // Slots the owner reused while we copied may hold a mix of two events, skip them. The owner
+            // may be part way through writing event headAfter, whose slot is that of headAfter - N.
+            // The fence keeps the copy's loads before the second read of head.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t headAfter = buffer->head.load(std::memory_order_acquire);
+            uint64_t stillValid = headAfter + 1 > TRACE_BUFFER_EVENTS ? headAfter + 1 - TRACE_BUFFER_EVENTS : 0;
+            for (const std::pair<uint64_t, Snapshot>& entry : copied) {
+                if (entry.first < stillValid || !entry.second.name) continue;
+                const Snapshot& event = entry.second;
+                out << (first ? "" : ",\n") << "{\"name\":\"" << escape(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                    << buffer->id << ",\"ts\":" << event.beginNs / 1000.0 << ",\"dur\":" << (event.endNs - event.beginNs) / 1000.0 << "}";
+                first = false;
+            }
+        }
+        out << "\n]}\n";
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+private:
+    struct Event {
+        std::atomic<const char*> name;
+        std::atomic<uint64_t> beginNs;
+        std::atomic<uint64_t> endNs;
+    };
+
+    struct Snapshot {
+        const char* name;
+        uint64_t beginNs;
+        uint64_t endNs;
+    };
+
+    struct ThreadBuffer {
+        int id;
+        std::string name;
+        std::atomic<uint64_t> head; // Events ever appended, the next goes to head % TRACE_BUFFER_EVENTS
+        std::unique_ptr<Event[]> events; // TRACE_BUFFER_EVENTS, allocated by the first record()
+
+        explicit ThreadBuffer(int id) : id(id), head(0) {}
+    };
+
+    std::mutex mutex; // Guards the buffer list and thread names, never taken when appending
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers; // Kept after their thread ends
+    std::atomic<bool> capturing;
+    Clock::time_point epoch;
+
+    TraceRecorder() : capturing(false), epoch(Clock::now()) {}
+
+    uint64_t toNanoseconds(Clock::time_point time) const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch).count());
+    }
+
+    // Created and registered the first time a thread records or is named
+    ThreadBuffer& threadBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            std::lock_guard<std::mutex> lock(mutex);
+            buffers.emplace_back(new ThreadBuffer(static_cast<int>(buffers.size()) + 1));
+            buffer = buffers.back().get();
+        }
+        return *buffer;
+    }
+
+    static std::string escape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') escaped += '\\';
+            if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+        }
+        return escaped;
+    }
+};
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name(name), active(TraceRecorder::instance().isCapturing()) {
+        if (active) begin = TraceRecorder::Clock::now();
+    }
+
+    ~TraceScope() {
+        if (active) {
+            TraceRecorder::instance().record(name, begin, TraceRecorder::Clock::now());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    bool active; // A capture was running when the scope began, only then is the clock read
+    TraceRecorder::Clock::time_point begin;
+};
+
+#if TRACING_ENABLED
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) TraceRecorder::instance().setThreadName(name)
+#else
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_THREAD_NAME(name) do {} while (0)
+#endif
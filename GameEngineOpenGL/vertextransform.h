@@ -0,0 +1,385 @@
+#pragma once
+
+#include <cstddef>
+#include <cfloat>
+#include <algorithm>
+#include <vector>
+#include <glm/glm.hpp>
+#include "jobsystem.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VERTEX_TRANSFORM_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define VERTEX_TRANSFORM_X86 0
+#endif
+
+// MSVC compiles intrinsics for any instruction set, GCC/Clang need the function to opt in
+#if VERTEX_TRANSFORM_X86 && !defined(_MSC_VER)
+#define VERTEX_TRANSFORM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define VERTEX_TRANSFORM_TARGET_AVX2
+#endif
+
+/*
+* Batch vertex transform kernel.
+*
+* Mesh vertices are stored interleaved (x0, y0, z0, x1, y1, z1...). The kernels load a block of
+* vertices, deinterleave it into x/y/z registers (structure of arrays), apply the affine part of the
+* 4x4 model matrix to all lanes at once, track the running min/max for the world AABB and
+* interleave the result back on store. Vertex transform and bounds are a single pass over memory.
+*
+* AVX2: 8 vertices per iteration (24 floats = 6 x 128-bit loads)
+* SSE:  4 vertices per iteration (12 floats = 3 x 128-bit loads)
+* Scalar fallback for the tail and for non-x86 builds.
+*
+* The instruction set is picked once at runtime from CPUID, so one binary runs everywhere.
+* Large meshes are split into vertex ranges that are transformed by the shared job system.
+*/
+
+constexpr size_t VERTEX_TRANSFORM_PARALLEL_MIN = 1 << 18; // Vertices before splitting across workers
+constexpr size_t VERTEX_TRANSFORM_GRAIN = 1 << 16;        // Vertices per job, a multiple of 8
+
+class VertexTransform {
+public:
+    struct Bounds {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    enum Kernel {
+        KERNEL_SCALAR = 0,
+        KERNEL_SSE = 1,
+        KERNEL_AVX2 = 2
+    };
+
+    // Kernel chosen for this CPU
+    static Kernel activeKernel() {
+        static const Kernel kernel = detectKernel();
+        return kernel;
+    }
+
+    static const char* kernelName(Kernel kernel) {
+        switch (kernel) {
+            case KERNEL_AVX2: return "AVX2";
+            case KERNEL_SSE: return "SSE";
+            default: return "Scalar";
+        }
+    }
+
+    // Transform vertexCount xyz vertices from src into dst and return their bounds.
+    // src and dst may be the same buffer.
+    static void transform(const float* src, float* dst, size_t vertexCount, const glm::mat4& matrix,
+                          glm::vec3& outMin, glm::vec3& outMax) {
+        transform(activeKernel(), src, dst, vertexCount, matrix, outMin, outMax);
+    }
+
+    // Same as above with an explicit kernel (used to compare kernels against each other)
+    static void transform(Kernel kernel, const float* src, float* dst, size_t vertexCount, const glm::mat4& matrix,
+                          glm::vec3& outMin, glm::vec3& outMax) {
+        outMin = glm::vec3(FLT_MAX);
+        outMax = glm::vec3(-FLT_MAX);
+        if (vertexCount == 0) return;
+
+        if (vertexCount < VERTEX_TRANSFORM_PARALLEL_MIN) {
+            transformRange(kernel, src, dst, vertexCount, matrix, outMin, outMax);
+            return;
+        }
+
+        // Ranges are aligned to 8 vertices so only the last range has a scalar tail
+        Bounds empty = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+        Bounds bounds = JobSystem::instance().parallelReduce(0, vertexCount, VERTEX_TRANSFORM_GRAIN, empty,
+            [=, &matrix](size_t begin, size_t end) {
+                Bounds range = empty;
+                transformRange(kernel, src + begin * 3, dst + begin * 3, end - begin, matrix, range.min, range.max);
+                return range;
+            },
+            [](const Bounds& a, const Bounds& b) {
+                Bounds merged = { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+                return merged;
+            });
+        outMin = bounds.min;
+        outMax = bounds.max;
+    }
+
+    // Transform a contiguous range on the calling thread
+    static void transformRange(Kernel kernel, const float* src, float* dst, size_t vertexCount, const glm::mat4& m,
+                               glm::vec3& outMin, glm::vec3& outMax) {
+        size_t done = 0;
+#if VERTEX_TRANSFORM_X86
+        if (kernel == KERNEL_AVX2) {
+            done = transformAVX2(src, dst, vertexCount, m, outMin, outMax);
+        }
+        else if (kernel == KERNEL_SSE) {
+            done = transformSSE(src, dst, vertexCount, m, outMin, outMax);
+        }
+#endif
+        transformScalar(src + done * 3, dst + done * 3, vertexCount - done, m, outMin, outMax);
+    }
+
+    // Bounds of vertexCount xyz vertices without transforming them
+    static void computeBounds(const float* src, size_t vertexCount, glm::vec3& outMin, glm::vec3& outMax) {
+        outMin = glm::vec3(FLT_MAX);
+        outMax = glm::vec3(-FLT_MAX);
+        size_t done = 0;
+#if VERTEX_TRANSFORM_X86
+        Kernel kernel = activeKernel();
+        if (kernel == KERNEL_AVX2) {
+            done = boundsAVX2(src, vertexCount, outMin, outMax);
+        }
+        else if (kernel == KERNEL_SSE) {
+            done = boundsSSE(src, vertexCount, outMin, outMax);
+        }
+#endif
+        for (size_t i = done; i < vertexCount; ++i) {
+            glm::vec3 p(src[i * 3], src[i * 3 + 1], src[i * 3 + 2]);
+            outMin = glm::min(outMin, p);
+            outMax = glm::max(outMax, p);
+        }
+    }
+
+    // Reference implementation, also handles the tails of the vector kernels
+    static void transformScalar(const float* src, float* dst, size_t vertexCount, const glm::mat4& m,
+                                glm::vec3& outMin, glm::vec3& outMax) {
+        glm::vec3 bMin = outMin;
+        glm::vec3 bMax = outMax;
+        for (size_t i = 0; i < vertexCount; ++i) {
+            float x = src[i * 3];
+            float y = src[i * 3 + 1];
+            float z = src[i * 3 + 2];
+            // Same summation order as the vector kernels so every kernel gives identical results
+            glm::vec3 p((m[0][0] * x + m[1][0] * y) + (m[2][0] * z + m[3][0]),
+                        (m[0][1] * x + m[1][1] * y) + (m[2][1] * z + m[3][1]),
+                        (m[0][2] * x + m[1][2] * y) + (m[2][2] * z + m[3][2]));
+            dst[i * 3] = p.x;
+            dst[i * 3 + 1] = p.y;
+            dst[i * 3 + 2] = p.z;
+            bMin = glm::min(bMin, p);
+            bMax = glm::max(bMax, p);
+        }
+        outMin = bMin;
+        outMax = bMax;
+    }
+
+private:
+    static Kernel detectKernel() {
+#if VERTEX_TRANSFORM_X86
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5)) return KERNEL_AVX2;
+        }
+        return KERNEL_SSE; // SSE2 is part of the x86-64 baseline and of the /arch:SSE2 default
+#else
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return KERNEL_AVX2;
+        if (__builtin_cpu_supports("sse2")) return KERNEL_SSE;
+        return KERNEL_SCALAR;
+#endif
+#else
+        return KERNEL_SCALAR;
+#endif
+    }
+
+#if VERTEX_TRANSFORM_X86
+    static void storeBounds(__m128 vMinX, __m128 vMinY, __m128 vMinZ, __m128 vMaxX, __m128 vMaxY, __m128 vMaxZ,
+                            glm::vec3& outMin, glm::vec3& outMax) {
+        float lanes[4];
+        _mm_storeu_ps(lanes, vMinX); outMin.x = std::min(outMin.x, std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3])));
+        _mm_storeu_ps(lanes, vMinY); outMin.y = std::min(outMin.y, std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3])));
+        _mm_storeu_ps(lanes, vMinZ); outMin.z = std::min(outMin.z, std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3])));
+        _mm_storeu_ps(lanes, vMaxX); outMax.x = std::max(outMax.x, std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3])));
+        _mm_storeu_ps(lanes, vMaxY); outMax.y = std::max(outMax.y, std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3])));
+        _mm_storeu_ps(lanes, vMaxZ); outMax.z = std::max(outMax.z, std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3])));
+    }
+
+    // Fold per-lane accumulators of interleaved data into xyz bounds. Float k of a block is component k % 3.
+    static void foldInterleaved(const float* lanesMin, const float* lanesMax, size_t floatCount,
+                                glm::vec3& outMin, glm::vec3& outMax) {
+        for (size_t k = 0; k < floatCount; ++k) {
+            int c = static_cast<int>(k % 3);
+            outMin[c] = std::min(outMin[c], lanesMin[k]);
+            outMax[c] = std::max(outMax[c], lanesMax[k]);
+        }
+    }
+
+    // Bounds need no deinterleave: a block of 12 floats is 3 registers whose lanes always hold the
+    // same components, so each register keeps its own min/max and the lanes are folded at the end.
+    // Returns the number of vertices processed (a multiple of 4)
+    static size_t boundsSSE(const float* src, size_t vertexCount, glm::vec3& outMin, glm::vec3& outMax) {
+        size_t blocks = vertexCount / 4;
+        if (blocks == 0) return 0;
+
+        __m128 min0 = _mm_set1_ps(FLT_MAX), min1 = min0, min2 = min0;
+        __m128 max0 = _mm_set1_ps(-FLT_MAX), max1 = max0, max2 = max0;
+        for (size_t b = 0; b < blocks; ++b) {
+            const float* in = src + b * 12;
+            __m128 r0 = _mm_loadu_ps(in);
+            __m128 r1 = _mm_loadu_ps(in + 4);
+            __m128 r2 = _mm_loadu_ps(in + 8);
+            min0 = _mm_min_ps(min0, r0); max0 = _mm_max_ps(max0, r0);
+            min1 = _mm_min_ps(min1, r1); max1 = _mm_max_ps(max1, r1);
+            min2 = _mm_min_ps(min2, r2); max2 = _mm_max_ps(max2, r2);
+        }
+
+        float lanesMin[12], lanesMax[12];
+        _mm_storeu_ps(lanesMin, min0); _mm_storeu_ps(lanesMin + 4, min1); _mm_storeu_ps(lanesMin + 8, min2);
+        _mm_storeu_ps(lanesMax, max0); _mm_storeu_ps(lanesMax + 4, max1); _mm_storeu_ps(lanesMax + 8, max2);
+        foldInterleaved(lanesMin, lanesMax, 12, outMin, outMax);
+        return blocks * 4;
+    }
+
+    // Same as boundsSSE with 24-float blocks. Returns the number of vertices processed (a multiple of 8)
+    VERTEX_TRANSFORM_TARGET_AVX2
+    static size_t boundsAVX2(const float* src, size_t vertexCount, glm::vec3& outMin, glm::vec3& outMax) {
+        size_t blocks = vertexCount / 8;
+        if (blocks == 0) return 0;
+
+        __m256 min0 = _mm256_set1_ps(FLT_MAX), min1 = min0, min2 = min0;
+        __m256 max0 = _mm256_set1_ps(-FLT_MAX), max1 = max0, max2 = max0;
+        for (size_t b = 0; b < blocks; ++b) {
+            const float* in = src + b * 24;
+            __m256 r0 = _mm256_loadu_ps(in);
+            __m256 r1 = _mm256_loadu_ps(in + 8);
+            __m256 r2 = _mm256_loadu_ps(in + 16);
+            min0 = _mm256_min_ps(min0, r0); max0 = _mm256_max_ps(max0, r0);
+            min1 = _mm256_min_ps(min1, r1); max1 = _mm256_max_ps(max1, r1);
+            min2 = _mm256_min_ps(min2, r2); max2 = _mm256_max_ps(max2, r2);
+        }
+
+        float lanesMin[24], lanesMax[24];
+        _mm256_storeu_ps(lanesMin, min0); _mm256_storeu_ps(lanesMin + 8, min1); _mm256_storeu_ps(lanesMin + 16, min2);
+        _mm256_storeu_ps(lanesMax, max0); _mm256_storeu_ps(lanesMax + 8, max1); _mm256_storeu_ps(lanesMax + 16, max2);
+        foldInterleaved(lanesMin, lanesMax, 24, outMin, outMax);
+        return blocks * 8;
+    }
+
+    // Returns the number of vertices processed (a multiple of 4)
+    static size_t transformSSE(const float* src, float* dst, size_t vertexCount, const glm::mat4& m,
+                               glm::vec3& outMin, glm::vec3& outMax) {
+        const __m128 m00 = _mm_set1_ps(m[0][0]), m10 = _mm_set1_ps(m[1][0]), m20 = _mm_set1_ps(m[2][0]), m30 = _mm_set1_ps(m[3][0]);
+        const __m128 m01 = _mm_set1_ps(m[0][1]), m11 = _mm_set1_ps(m[1][1]), m21 = _mm_set1_ps(m[2][1]), m31 = _mm_set1_ps(m[3][1]);
+        const __m128 m02 = _mm_set1_ps(m[0][2]), m12 = _mm_set1_ps(m[1][2]), m22 = _mm_set1_ps(m[2][2]), m32 = _mm_set1_ps(m[3][2]);
+
+        __m128 vMinX = _mm_set1_ps(FLT_MAX), vMinY = vMinX, vMinZ = vMinX;
+        __m128 vMaxX = _mm_set1_ps(-FLT_MAX), vMaxY = vMaxX, vMaxZ = vMaxX;
+
+        size_t blocks = vertexCount / 4;
+        for (size_t b = 0; b < blocks; ++b) {
+            const float* in = src + b * 12;
+            float* out = dst + b * 12;
+
+            // a = x0 y0 z0 x1, c1 = y1 z1 x2 y2, c2 = z2 x3 y3 z3
+            __m128 a = _mm_loadu_ps(in);
+            __m128 c1 = _mm_loadu_ps(in + 4);
+            __m128 c2 = _mm_loadu_ps(in + 8);
+
+            // Deinterleave into x0..x3, y0..y3, z0..z3
+            __m128 x = _mm_shuffle_ps(a, _mm_shuffle_ps(c1, c2, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+            __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, c1, _MM_SHUFFLE(0, 0, 1, 1)),
+                                      _mm_shuffle_ps(c1, c2, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, c1, _MM_SHUFFLE(1, 1, 2, 2)),
+                                      _mm_shuffle_ps(c2, c2, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+            __m128 tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m10, y)), _mm_add_ps(_mm_mul_ps(m20, z), m30));
+            __m128 ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, x), _mm_mul_ps(m11, y)), _mm_add_ps(_mm_mul_ps(m21, z), m31));
+            __m128 tz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, x), _mm_mul_ps(m12, y)), _mm_add_ps(_mm_mul_ps(m22, z), m32));
+
+            vMinX = _mm_min_ps(vMinX, tx); vMaxX = _mm_max_ps(vMaxX, tx);
+            vMinY = _mm_min_ps(vMinY, ty); vMaxY = _mm_max_ps(vMaxY, ty);
+            vMinZ = _mm_min_ps(vMinZ, tz); vMaxZ = _mm_max_ps(vMaxZ, tz);
+
+            // Interleave back to x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+            __m128 o0 = _mm_shuffle_ps(_mm_shuffle_ps(tx, ty, _MM_SHUFFLE(0, 0, 0, 0)),
+                                       _mm_shuffle_ps(tz, tx, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 o1 = _mm_shuffle_ps(_mm_shuffle_ps(ty, tz, _MM_SHUFFLE(1, 1, 1, 1)),
+                                       _mm_shuffle_ps(tx, ty, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 o2 = _mm_shuffle_ps(_mm_shuffle_ps(tz, tx, _MM_SHUFFLE(3, 3, 2, 2)),
+                                       _mm_shuffle_ps(ty, tz, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+            _mm_storeu_ps(out, o0);
+            _mm_storeu_ps(out + 4, o1);
+            _mm_storeu_ps(out + 8, o2);
+        }
+
+        if (blocks > 0) {
+            storeBounds(vMinX, vMinY, vMinZ, vMaxX, vMaxY, vMaxZ, outMin, outMax);
+        }
+        return blocks * 4;
+    }
+
+    // Returns the number of vertices processed (a multiple of 8)
+    VERTEX_TRANSFORM_TARGET_AVX2
+    static size_t transformAVX2(const float* src, float* dst, size_t vertexCount, const glm::mat4& m,
+                                glm::vec3& outMin, glm::vec3& outMax) {
+        const __m256 m00 = _mm256_set1_ps(m[0][0]), m10 = _mm256_set1_ps(m[1][0]), m20 = _mm256_set1_ps(m[2][0]), m30 = _mm256_set1_ps(m[3][0]);
+        const __m256 m01 = _mm256_set1_ps(m[0][1]), m11 = _mm256_set1_ps(m[1][1]), m21 = _mm256_set1_ps(m[2][1]), m31 = _mm256_set1_ps(m[3][1]);
+        const __m256 m02 = _mm256_set1_ps(m[0][2]), m12 = _mm256_set1_ps(m[1][2]), m22 = _mm256_set1_ps(m[2][2]), m32 = _mm256_set1_ps(m[3][2]);
+
+        __m256 vMinX = _mm256_set1_ps(FLT_MAX), vMinY = vMinX, vMinZ = vMinX;
+        __m256 vMaxX = _mm256_set1_ps(-FLT_MAX), vMaxY = vMaxX, vMaxZ = vMaxX;
+
+        size_t blocks = vertexCount / 8;
+        for (size_t b = 0; b < blocks; ++b) {
+            const float* in = src + b * 24;
+            float* out = dst + b * 24;
+
+            // Vertices 0-3 go to the low 128 bits, vertices 4-7 to the high 128 bits
+            __m256 m03 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in)), _mm_loadu_ps(in + 12), 1);
+            __m256 m14 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in + 4)), _mm_loadu_ps(in + 16), 1);
+            __m256 m25 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in + 8)), _mm_loadu_ps(in + 20), 1);
+
+            // Deinterleave. Lanes end up in a fixed permuted vertex order, which is fine because
+            // every lane is transformed independently and the store below applies the inverse.
+            __m256 xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+            __m256 yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+            __m256 x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+            __m256 y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+            __m256 z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+
+            __m256 tx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, x), _mm256_mul_ps(m10, y)), _mm256_add_ps(_mm256_mul_ps(m20, z), m30));
+            __m256 ty = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m01, x), _mm256_mul_ps(m11, y)), _mm256_add_ps(_mm256_mul_ps(m21, z), m31));
+            __m256 tz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m02, x), _mm256_mul_ps(m12, y)), _mm256_add_ps(_mm256_mul_ps(m22, z), m32));
+
+            vMinX = _mm256_min_ps(vMinX, tx); vMaxX = _mm256_max_ps(vMaxX, tx);
+            vMinY = _mm256_min_ps(vMinY, ty); vMaxY = _mm256_max_ps(vMaxY, ty);
+            vMinZ = _mm256_min_ps(vMinZ, tz); vMaxZ = _mm256_max_ps(vMaxZ, tz);
+
+            // Interleave back
+            __m256 rxy = _mm256_shuffle_ps(tx, ty, _MM_SHUFFLE(2, 0, 2, 0));
+            __m256 ryz = _mm256_shuffle_ps(ty, tz, _MM_SHUFFLE(3, 1, 3, 1));
+            __m256 rzx = _mm256_shuffle_ps(tz, tx, _MM_SHUFFLE(3, 1, 2, 0));
+            __m256 r03 = _mm256_shuffle_ps(rxy, rzx, _MM_SHUFFLE(2, 0, 2, 0));
+            __m256 r14 = _mm256_shuffle_ps(ryz, rxy, _MM_SHUFFLE(3, 1, 2, 0));
+            __m256 r25 = _mm256_shuffle_ps(rzx, ryz, _MM_SHUFFLE(3, 1, 3, 1));
+
+            _mm_storeu_ps(out, _mm256_castps256_ps128(r03));
+            _mm_storeu_ps(out + 4, _mm256_castps256_ps128(r14));
+            _mm_storeu_ps(out + 8, _mm256_castps256_ps128(r25));
+            _mm_storeu_ps(out + 12, _mm256_extractf128_ps(r03, 1));
+            _mm_storeu_ps(out + 16, _mm256_extractf128_ps(r14, 1));
+            _mm_storeu_ps(out + 20, _mm256_extractf128_ps(r25, 1));
+        }
+
+        if (blocks > 0) {
+            // Fold the two 128-bit halves, then reduce the remaining 4 lanes
+            storeBounds(_mm_min_ps(_mm256_castps256_ps128(vMinX), _mm256_extractf128_ps(vMinX, 1)),
+                        _mm_min_ps(_mm256_castps256_ps128(vMinY), _mm256_extractf128_ps(vMinY, 1)),
+                        _mm_min_ps(_mm256_castps256_ps128(vMinZ), _mm256_extractf128_ps(vMinZ, 1)),
+                        _mm_max_ps(_mm256_castps256_ps128(vMaxX), _mm256_extractf128_ps(vMaxX, 1)),
+                        _mm_max_ps(_mm256_castps256_ps128(vMaxY), _mm256_extractf128_ps(vMaxY, 1)),
+                        _mm_max_ps(_mm256_castps256_ps128(vMaxZ), _mm256_extractf128_ps(vMaxZ, 1)),
+                        outMin, outMax);
+        }
+        return blocks * 8;
+    }
+#endif
+};
@@ -6,7 +6,9 @@
 #include <GL/glu.h>
 #include <sstream>
 #include <iostream>
+#include <glm/gtc/type_ptr.hpp>
 #include "grid.h"
+#include "meshrenderer.h"
 
 
 // View is responsible for rendering the visual content to the screen
@@ -16,13 +18,15 @@ private:
 	HDC hdc; // Handle to device context
 	HGLRC hglrc; // Handle to OpenGL rendering context
 	Model* model; // Pointer to the model class
-	int screenWidth;
+	int screenWidth;    // Window size as seen by the UI thread
 	int screenHeight;
-	bool isScreenResized;
+	int viewportWidth;  // Viewport last set by the render thread
+	int viewportHeight;
 
 public: 
 	// Constructor to initialize the handles to NULL
-	View(Model* model) : hdc(NULL), hglrc(NULL), screenWidth(0), screenHeight(0), isScreenResized(FALSE), model(model) {
+	View(Model* model) : hdc(NULL), hglrc(NULL), screenWidth(0), screenHeight(0),
+		viewportWidth(0), viewportHeight(0), model(model) {
 		
 	}
 
@@ -129,21 +133,109 @@ public:
 	void setWindowSize(int widht, int height) {
 		screenWidth = widht;
 		screenHeight = height;
-		isScreenResized = TRUE;
 	}
 
-	void preRender() {
-		if (isScreenResized) {
-			glViewport(0, 0, screenWidth, screenHeight);
-			model->updateProjection(screenWidth, screenHeight);
-			isScreenResized = FALSE;
+	// Render thread only, the size is the one published with the snapshot
+	void preRender(int width, int height) {
+		if (width != viewportWidth || height != viewportHeight) {
+			glViewport(0, 0, width, height);
+			viewportWidth = width;
+			viewportHeight = height;
 		}
 	}
 
-	void render() {
-		preRender();
-		if (model) {
-			model->draw(screenWidth, screenHeight);
+	// GL state for the render thread's context
+	void initRenderState() {
+		// To enable depth testing, which can be used to determine which objects, or parts of objects, are visible
+		glEnable(GL_DEPTH_TEST);
+		// Clear the color and depth buffer
+		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
+
+	// Draw the render thread's snapshot, never the live model the UI thread is editing
+	void render(SceneSnapshot& snapshot) {
+		PROFILE_SCOPE("render.frame");
+		preRender(snapshot.width, snapshot.height);
+
+		// Clear the color and depth buffer
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// Set Projection Matrix
+		glMatrixMode(GL_PROJECTION);
+		glLoadMatrixf(glm::value_ptr(snapshot.getProjectionMatrix()));
+
+		// Set Model View Matrix
+		glMatrixMode(GL_MODELVIEW);
+		glLoadMatrixf(glm::value_ptr(snapshot.camera.getViewMatrix()));
+
+		// Draw the plane grid around the snapshot's camera
+		Grid grid(snapshot.camera);
+		grid.drawXZGrid();
+
+		// Draw the meshes
+		{
+			PROFILE_SCOPE("render.mesh_pass");
+			for (const std::shared_ptr<const Mesh>& mesh : snapshot.getMeshes()) {
+				if (mesh) {
+					MeshRenderer::draw(*mesh);
+					MeshRenderer::drawLocalAxis(*mesh);
+				}
+			}
 		}
+
+		// Hover highlight last, over the mesh it outlines
+		int hoveredFace;
+		if (const Mesh* hovered = snapshot.getHoveredMesh(hoveredFace)) {
+			MeshRenderer::drawHover(*hovered, hoveredFace);
+		}
+
+		if (snapshot.selectingRectangle && snapshot.width > 0 && snapshot.height > 0) {
+			drawSelectionRectangle(snapshot);
+		}
+	}
+
+private:
+	// Rectangle selection being dragged, drawn in client pixels over the scene
+	void drawSelectionRectangle(const SceneSnapshot& snapshot) {
+		float x0 = static_cast<float>(snapshot.rectangleX0);
+		float y0 = static_cast<float>(snapshot.rectangleY0);
+		float x1 = static_cast<float>(snapshot.rectangleX1);
+		float y1 = static_cast<float>(snapshot.rectangleY1);
+
+		// Pixel coordinates with y down, like the mouse messages
+		glMatrixMode(GL_PROJECTION);
+		glPushMatrix();
+		glLoadIdentity();
+		glOrtho(0.0, snapshot.width, snapshot.height, 0.0, -1.0, 1.0);
+		glMatrixMode(GL_MODELVIEW);
+		glPushMatrix();
+		glLoadIdentity();
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		glColor4f(0.2f, 0.5f, 1.0f, 0.15f); // Light blue fill
+		glBegin(GL_QUADS);
+		glVertex2f(x0, y0);
+		glVertex2f(x1, y0);
+		glVertex2f(x1, y1);
+		glVertex2f(x0, y1);
+		glEnd();
+
+		glColor4f(0.2f, 0.5f, 1.0f, 0.9f); // Blue outline
+		glBegin(GL_LINE_LOOP);
+		glVertex2f(x0, y0);
+		glVertex2f(x1, y0);
+		glVertex2f(x1, y1);
+		glVertex2f(x0, y1);
+		glEnd();
+
+		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
+		glPopMatrix();
+		glMatrixMode(GL_PROJECTION);
+		glPopMatrix();
+		glMatrixMode(GL_MODELVIEW);
 	}
 };
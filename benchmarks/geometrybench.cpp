@@ -0,0 +1,752 @@
+/*
+* geometrybench: micro-benchmarks for the geometry hot paths of the core.
+*
+*   geometrybench [--sizes 1000,10000,100000] [--rays 10000] [--repeat 5] [--filter text] [--format table|csv|json]
+*                 [--stats]
+*
+* Every benchmark runs once per scene size (triangles per mesh) and is repeated; the median run is
+* reported as throughput (triangles/s, rays/s, tests/s). Setup such as generating the input is not
+* timed. csv and json are meant for scripts comparing two builds, the table for reading.
+*
+*   stl_parse_binary   Mesh::parseSTL on an in-memory binary STL
+*   stl_parse_ascii    Mesh::parseSTL on an in-memory ASCII STL
+*   weld_stl           MeshWeld::weld on a parsed binary STL. Every run welds the same buffers and must
+*                      give the same output as the first; if not, geometrybench exits with status 1.
+*   geometry_create    MeshGeometry::create: bounds and faces (what Mesh::init does)
+*   import_allocations The import path of one STL: Mesh::parseSTL, MeshGeometry::create and placing
+*                      the geometry on a mesh in a Model. Heap allocations and bytes per import are
+*                      printed; more than IMPORT_ALLOCATION_LIMIT allocations, or bytes beyond
+*                      IMPORT_BYTES_SLACK times the buffers the mesh keeps, mean a buffer is copied
+*                      again and geometrybench exits with status 1.
+*   mesh_update        Mesh::updateMesh on 1000 meshes sharing the geometry
+*   bvh_build          BVH::build
+*   kdtree_build       KDTree::build
+*   lbvh_build         LBVH::build
+*   bvh_traverse       BVH::traverse, rays from outside aimed at the mesh
+*   kdtree_traverse    KDTree::traverse, same rays
+*   lbvh_traverse      LBVH::traverse, same rays
+*   *_static           The same rays through forEachHit(), the compile-time specialised traversal
+*                      with a handler counting hits instead of the virtual call filling a vector
+*   *_closest          findClosestHits one ray at a time, camera rays over the mesh in 4x4 tiles
+*   *_packet4/8/16     The same rays in packets (raypacket.h), BVH and LBVH
+*   pick_closest       Model::findRayIntersection over an 8x8 grid of instances. Picking must not
+*                      allocate: heap allocations during the timed runs are reported and geometrybench
+*                      exits with status 1.
+*   pick_hover         SceneSnapshot::pickHover, the render thread's hover pick, over a snapshot of
+*                      the same scene and the same rays; allocations are checked like pick_closest
+*   raycast_batch      Model::findRayIntersections, the same rays as one batch on the job system
+*   select_rectangle   Model::findFacesInRectangle, 16 rectangles of a perspective view over the grid;
+*                      throughput is faces selected
+*   kernel_aabb_ray    AABB::isIntersectingRay, every face box against 16 rays
+*   kernel_triangle_ray Face::isIntersectingRay, every face against 16 rays
+*
+* --stats adds a table of accelerator quality after the results (table format only): the shape of
+* each built BVH and KD-tree, and the nodes visited and triangles tested per traverse ray.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "meshweld.h"
+#include "jobsystem.h"
+#include "model.h"
+#include "raypacket.h"
+#include "spacialaccelerator.h"
+
+// Every heap allocation is counted, per thread: picks run on the calling thread, and job system
+// workers starting up meanwhile must not count against them. All replaceable forms are defined, so each
+// allocation and its release go through this pair. The releases are kept out of line: inlined into
+// a caller, GCC sees free() on a pointer from operator new and warns (-Wmismatched-new-delete).
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+thread_local size_t allocationCount = 0;
+thread_local size_t allocatedBytes = 0;
+
+void* operator new(size_t size) {
+    allocationCount++;
+    allocatedBytes += size;
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+BENCH_NOINLINE void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+BENCH_NOINLINE void operator delete[](void* memory) noexcept {
+    operator delete(memory);
+}
+
+BENCH_NOINLINE void operator delete(void* memory, size_t) noexcept {
+    operator delete(memory);
+}
+
+BENCH_NOINLINE void operator delete[](void* memory, size_t) noexcept {
+    operator delete(memory);
+}
+
+// Budget of import_allocations: the parsed buffers, the geometry and its faces, the mesh slot
+#define IMPORT_ALLOCATION_LIMIT 8
+#define IMPORT_BYTES_SLACK 1.1
+
+namespace {
+
+struct Options {
+    std::vector<size_t> sizes{ 1000, 10000, 100000 };
+    size_t rays = 10000;
+    int repeat = 5;
+    std::string filter;
+    std::string format = "table";
+    bool stats = false;
+};
+
+struct Result {
+    std::string name;
+    size_t size;        // Triangles per mesh
+    size_t items;       // Work items per run
+    const char* unit;   // What an item is
+    double medianSeconds;
+    double minSeconds;
+};
+
+struct ImportRow {
+    size_t size;
+    size_t allocations; // Per import
+    size_t bytes;       // Allocated per import
+    size_t keptBytes;   // Vertex, color, index and face buffers of the imported geometry
+};
+
+struct QualityRow {
+    size_t size;
+    AcceleratorStats stats;
+    TraversalCounters counters;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+// Results are folded in here so the optimizer cannot drop the measured work
+volatile size_t sink = 0;
+
+class Samples {
+public:
+    void start() { begin = Clock::now(); }
+    void stop() { seconds.push_back(std::chrono::duration<double>(Clock::now() - begin).count()); }
+
+    double median() {
+        std::sort(seconds.begin(), seconds.end());
+        return seconds.empty() ? 0.0 : seconds[seconds.size() / 2];
+    }
+    double minimum() {
+        return seconds.empty() ? 0.0 : *std::min_element(seconds.begin(), seconds.end());
+    }
+
+private:
+    Clock::time_point begin;
+    std::vector<double> seconds;
+};
+
+// *** Inputs ***
+
+// Closed UV sphere with roughly the requested number of triangles and some surface noise,
+// so faces are not all the same size and accelerators see a realistic spread
+std::shared_ptr<MeshGeometry> makeSphere(size_t triangles) {
+    size_t rings = std::max<size_t>(2, static_cast<size_t>(std::sqrt(triangles / 4.0)));
+    size_t segments = std::max<size_t>(3, triangles / (2 * rings));
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<float> noise(0.97f, 1.03f);
+
+    std::vector<float> vertices, colors;
+    std::vector<unsigned int> indices;
+    for (size_t r = 0; r <= rings; ++r) {
+        float phi = 3.14159265f * r / rings;
+        for (size_t s = 0; s < segments; ++s) {
+            float theta = 2.0f * 3.14159265f * s / segments;
+            float radius = (r == 0 || r == rings) ? 1.0f : noise(random);
+            vertices.insert(vertices.end(), { radius * std::sin(phi) * std::cos(theta), radius * std::cos(phi),
+                                              radius * std::sin(phi) * std::sin(theta) });
+            colors.insert(colors.end(), { 0.8f, 0.8f, 0.8f });
+        }
+    }
+    for (size_t r = 0; r < rings; ++r) {
+        for (size_t s = 0; s < segments; ++s) {
+            unsigned int a = static_cast<unsigned int>(r * segments + s);
+            unsigned int b = static_cast<unsigned int>(r * segments + (s + 1) % segments);
+            unsigned int c = static_cast<unsigned int>((r + 1) * segments + s);
+            unsigned int d = static_cast<unsigned int>((r + 1) * segments + (s + 1) % segments);
+            indices.insert(indices.end(), { a, c, b, b, c, d });
+        }
+    }
+    return MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+}
+
+std::vector<char> toBinarySTL(const MeshGeometry& geometry) {
+    uint32_t count = static_cast<uint32_t>(geometry.faces.size());
+    std::vector<char> bytes(80 + sizeof(count) + count * 50, 0);
+    std::memcpy(&bytes[80], &count, sizeof(count));
+    char* cursor = &bytes[84];
+    for (const Face& face : geometry.faces) {
+        float triangle[12] = {};
+        for (int v = 0; v < 3; ++v) {
+            triangle[3 + v * 3] = face.vertices[v].x;
+            triangle[4 + v * 3] = face.vertices[v].y;
+            triangle[5 + v * 3] = face.vertices[v].z;
+        }
+        std::memcpy(cursor, triangle, sizeof(triangle));
+        cursor += 50;
+    }
+    return bytes;
+}
+
+std::vector<char> toAsciiSTL(const MeshGeometry& geometry) {
+    std::ostringstream text;
+    text << "solid bench\n";
+    for (const Face& face : geometry.faces) {
+        text << "  facet normal 0 0 0\n    outer loop\n";
+        for (int v = 0; v < 3; ++v) {
+            text << "      vertex " << face.vertices[v].x << ' ' << face.vertices[v].y << ' ' << face.vertices[v].z << '\n';
+        }
+        text << "    endloop\n  endfacet\n";
+    }
+    text << "endsolid bench\n";
+    std::string s = text.str();
+    return std::vector<char>(s.begin(), s.end());
+}
+
+// Rays from a sphere of radius 4 around the origin towards random points inside the unit cube,
+// most of them hit the mesh
+std::vector<Ray> makeRays(size_t count, float spread = 1.0f) {
+    std::mt19937 random(6789);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    while (rays.size() < count) {
+        glm::vec3 direction(unit(random), unit(random), unit(random));
+        if (glm::length(direction) < 0.1f) continue;
+        glm::vec3 origin = glm::normalize(direction) * 4.0f * spread;
+        glm::vec3 target(unit(random) * spread, unit(random) * spread, unit(random) * spread);
+        rays.push_back(Ray(origin, target - origin));
+    }
+    return rays;
+}
+
+// Pinhole camera 4 units out looking at the origin, the view just covering the unit sphere.
+// Pixels come in 4x4 tiles, so neighbouring rays are next to each other like a renderer sends them.
+std::vector<Ray> makeCameraRays(size_t count) {
+    size_t side = std::max<size_t>(4, (static_cast<size_t>(std::sqrt(static_cast<double>(count))) + 3) / 4 * 4);
+    glm::vec3 eye(0.5f, 1.0f, 4.0f);
+    glm::vec3 forward = glm::normalize(-eye);
+    glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+    glm::vec3 up = glm::cross(right, forward);
+    std::vector<Ray> rays;
+    rays.reserve(side * side);
+    for (size_t tileY = 0; tileY < side; tileY += 4) {
+        for (size_t tileX = 0; tileX < side; tileX += 4) {
+            for (size_t y = tileY; y < tileY + 4; ++y) {
+                for (size_t x = tileX; x < tileX + 4; ++x) {
+                    float u = (x + 0.5f) / side * 2.0f - 1.0f;
+                    float v = (y + 0.5f) / side * 2.0f - 1.0f;
+                    rays.push_back(Ray(eye, forward + (right * u + up * v) * 0.3f));
+                }
+            }
+        }
+    }
+    return rays;
+}
+
+// *** Benchmarks ***
+
+class Bench {
+public:
+    Bench(const Options& options) : options(options) {}
+
+    std::vector<Result> results;
+    std::vector<QualityRow> quality;
+    std::vector<ImportRow> imports;
+    size_t pickAllocations = 0; // Heap allocations during timed pick_closest and pick_hover runs, should stay 0
+    bool importOverBudget = false;
+    bool weldMismatch = false; // A weld_stl run differed from the first
+
+    void runAll() {
+        for (size_t size : options.sizes) {
+            std::shared_ptr<MeshGeometry> geometry = makeSphere(size);
+            size_t triangles = geometry->faces.size();
+            std::vector<Ray> rays = makeRays(options.rays);
+            std::vector<Ray> cameraRays = makeCameraRays(options.rays);
+
+            if (enabled("stl_parse_binary")) parseSTL("stl_parse_binary", size, triangles, toBinarySTL(*geometry));
+            if (enabled("stl_parse_ascii")) parseSTL("stl_parse_ascii", size, triangles, toAsciiSTL(*geometry));
+
+            if (enabled("import_allocations")) importAllocations(size, toBinarySTL(*geometry));
+            if (enabled("weld_stl")) weldSTL(size, toBinarySTL(*geometry));
+
+            if (enabled("geometry_create")) {
+                Samples samples;
+                for (int r = 0; r < options.repeat; ++r) {
+                    std::vector<float> vertices = geometry->vertices;
+                    std::vector<float> colors = geometry->colors;
+                    std::vector<unsigned int> indices = geometry->indices;
+                    samples.start();
+                    std::shared_ptr<MeshGeometry> created = MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+                    samples.stop();
+                    sink += created->faces.size();
+                }
+                record("geometry_create", size, triangles, "triangles", samples);
+            }
+
+            if (enabled("mesh_update")) {
+                const size_t meshCount = 1000;
+                std::vector<Mesh> meshes(meshCount);
+                for (Mesh& mesh : meshes) mesh.setGeometry(geometry);
+                Samples samples;
+                for (int r = 0; r < options.repeat; ++r) {
+                    samples.start();
+                    for (size_t m = 0; m < meshCount; ++m) {
+                        meshes[m].rotationY = static_cast<float>(r * 7 + m);
+                        meshes[m].updateMesh();
+                    }
+                    samples.stop();
+                    sink += static_cast<size_t>(meshes.back().sizeX);
+                }
+                record("mesh_update", size, meshCount, "updates", samples);
+            }
+
+            buildAndTraverse<BVH>("bvh", size, *geometry, rays, cameraRays, true);
+            buildAndTraverse<KDTree>("kdtree", size, *geometry, rays, cameraRays, false);
+            buildAndTraverse<LBVH>("lbvh", size, *geometry, rays, cameraRays, true);
+
+            if (enabled("pick_closest") || enabled("pick_hover") || enabled("raycast_batch") || enabled("select_rectangle")) pickClosest(size, geometry);
+
+            if (enabled("kernel_aabb_ray") || enabled("kernel_triangle_ray")) {
+                std::vector<Ray> kernelRays = makeRays(16);
+                if (enabled("kernel_aabb_ray")) {
+                    Samples samples;
+                    for (int r = 0; r < options.repeat; ++r) {
+                        size_t hits = 0;
+                        samples.start();
+                        for (const Ray& ray : kernelRays) {
+                            for (const Face& face : geometry->faces) {
+                                hits += face.boundingBox.isIntersectingRay(ray.origin, ray.direction, ray.tMin, ray.tMax);
+                            }
+                        }
+                        samples.stop();
+                        sink += hits;
+                    }
+                    record("kernel_aabb_ray", size, triangles * kernelRays.size(), "tests", samples);
+                }
+                if (enabled("kernel_triangle_ray")) {
+                    Samples samples;
+                    for (int r = 0; r < options.repeat; ++r) {
+                        size_t hits = 0;
+                        samples.start();
+                        for (const Ray& ray : kernelRays) {
+                            for (const Face& face : geometry->faces) {
+                                hits += face.isIntersectingRay(ray.origin, ray.direction, ray.tMin, ray.tMax);
+                            }
+                        }
+                        samples.stop();
+                        sink += hits;
+                    }
+                    record("kernel_triangle_ray", size, triangles * kernelRays.size(), "tests", samples);
+                }
+            }
+        }
+    }
+
+private:
+    const Options& options;
+
+    bool enabled(const char* name) const {
+        return options.filter.empty() || std::string(name).find(options.filter) != std::string::npos;
+    }
+
+    void record(const std::string& name, size_t size, size_t items, const char* unit, Samples& samples) {
+        results.push_back(Result{ name, size, items, unit, samples.median(), samples.minimum() });
+    }
+
+    void parseSTL(const char* name, size_t size, size_t triangles, const std::vector<char>& bytes) {
+        Samples samples;
+        for (int r = 0; r < options.repeat; ++r) {
+            std::vector<float> vertices, colors;
+            std::vector<unsigned int> indices;
+            samples.start();
+            Mesh::parseSTL(bytes, glm::vec3(0.8f), vertices, colors, indices);
+            samples.stop();
+            sink += indices.size();
+        }
+        record(name, size, triangles, "triangles", samples);
+    }
+
+    void weldSTL(size_t size, const std::vector<char>& bytes) {
+        std::vector<float> parsedVertices, parsedColors;
+        std::vector<unsigned int> parsedIndices;
+        if (!Mesh::parseSTL(bytes, glm::vec3(0.8f), parsedVertices, parsedColors, parsedIndices)) return;
+
+        Samples samples;
+        std::vector<float> firstVertices;
+        std::vector<unsigned int> firstIndices;
+        for (int r = 0; r < options.repeat; ++r) {
+            std::vector<float> vertices = parsedVertices;
+            std::vector<float> colors = parsedColors;
+            std::vector<unsigned int> indices = parsedIndices;
+            samples.start();
+            MeshWeld::weld(vertices, colors, indices);
+            samples.stop();
+            if (r == 0) {
+                firstVertices.swap(vertices);
+                firstIndices.swap(indices);
+            }
+            else if (vertices != firstVertices || indices != firstIndices) {
+                weldMismatch = true;
+            }
+        }
+        record("weld_stl", size, parsedIndices.size() / 3, "triangles", samples);
+    }
+
+    template <typename Accelerator>
+    void buildAndTraverse(const std::string& prefix, size_t size, const MeshGeometry& geometry, const std::vector<Ray>& rays,
+                          const std::vector<Ray>& cameraRays, bool packets) {
+        std::string buildName = prefix + "_build";
+        std::string traverseName = prefix + "_traverse";
+        std::string staticName = prefix + "_traverse_static";
+        std::vector<std::pair<std::string, int>> closestNames{ { prefix + "_closest", 1 } };
+        if (packets) {
+            for (int packetSize : { 4, 8, 16 }) closestNames.push_back({ prefix + "_packet" + std::to_string(packetSize), packetSize });
+        }
+        bool anyClosest = false;
+        for (const std::pair<std::string, int>& closest : closestNames) anyClosest |= enabled(closest.first.c_str());
+        if (!enabled(buildName.c_str()) && !enabled(traverseName.c_str()) && !enabled(staticName.c_str()) && !anyClosest) return;
+
+        Samples buildSamples;
+        std::unique_ptr<Accelerator> accelerator;
+        for (int r = 0; r < options.repeat; ++r) {
+            accelerator.reset(new Accelerator()); // The previous tree is freed outside the timed part
+            buildSamples.start();
+            accelerator->build(geometry.faces);
+            buildSamples.stop();
+        }
+        if (enabled(buildName.c_str())) {
+            record(buildName, size, geometry.faces.size(), "triangles", buildSamples);
+        }
+
+        if (enabled(traverseName.c_str())) {
+            Samples samples;
+            std::vector<Face*> hitFaces;
+            for (int r = 0; r < options.repeat; ++r) {
+                size_t hits = 0;
+                samples.start();
+                for (const Ray& ray : rays) {
+                    hitFaces.clear();
+                    accelerator->traverse(ray, hitFaces);
+                    hits += hitFaces.size();
+                }
+                samples.stop();
+                sink += hits;
+            }
+            record(traverseName, size, rays.size(), "rays", samples);
+        }
+
+        if (enabled(staticName.c_str())) {
+            Samples samples;
+            for (int r = 0; r < options.repeat; ++r) {
+                size_t hits = 0;
+                samples.start();
+                for (const Ray& ray : rays) {
+                    accelerator->forEachHit(ray, FaceRayIntersector(), [&hits](Face*) { hits++; });
+                }
+                samples.stop();
+                sink += hits;
+            }
+            record(staticName, size, rays.size(), "rays", samples);
+        }
+
+        for (const std::pair<std::string, int>& closest : closestNames) {
+            if (!enabled(closest.first.c_str())) continue;
+            std::vector<RayHit> hits(cameraRays.size());
+            Samples samples;
+            for (int r = 0; r < options.repeat; ++r) {
+                samples.start();
+                findClosestHits(*accelerator, cameraRays.data(), cameraRays.size(), hits.data(), closest.second);
+                samples.stop();
+                for (const RayHit& hit : hits) sink += hit.face != nullptr;
+            }
+            record(closest.first, size, cameraRays.size(), "rays", samples);
+        }
+
+        if (options.stats) {
+            // Counting pass outside the timed runs
+            QualityRow row;
+            row.size = size;
+            row.stats = accelerator->getStats();
+            std::vector<Face*> hitFaces;
+            for (const Ray& ray : rays) {
+                hitFaces.clear();
+                accelerator->traverse(ray, hitFaces, &row.counters);
+            }
+            quality.push_back(row);
+        }
+    }
+
+    void importAllocations(size_t size, const std::vector<char>& bytes) {
+        Model model;
+        std::shared_ptr<MeshGeometry> imported;
+        auto importOnce = [&]() {
+            std::vector<float> vertices, colors;
+            std::vector<unsigned int> indices;
+            if (!Mesh::parseSTL(bytes, glm::vec3(1.0f), vertices, colors, indices)) return false;
+            imported = MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+            model.meshes.get(model.meshes.emplace())->setGeometry(imported);
+            return true;
+        };
+
+        // The first import creates the profiler entries and the scene storage, as in an editor that
+        // already holds a scene. The second one is counted; its slot reuses the freed one.
+        if (!importOnce()) return;
+        model.meshes.erase(model.meshes.handleAt(0));
+        imported.reset();
+        size_t allocationsBefore = allocationCount;
+        size_t bytesBefore = allocatedBytes;
+        importOnce();
+        ImportRow row;
+        row.size = size;
+        row.allocations = allocationCount - allocationsBefore;
+        row.bytes = allocatedBytes - bytesBefore;
+        row.keptBytes = imported->vertices.capacity() * sizeof(float) + imported->colors.capacity() * sizeof(float) +
+                        imported->indices.capacity() * sizeof(unsigned int) + imported->faces.capacity() * sizeof(Face);
+        imports.push_back(row);
+        if (row.allocations > IMPORT_ALLOCATION_LIMIT || row.bytes > row.keptBytes * IMPORT_BYTES_SLACK + 4096) {
+            importOverBudget = true;
+        }
+    }
+
+    void pickClosest(size_t size, const std::shared_ptr<MeshGeometry>& geometry) {
+        // Instances 3 units apart, rays aimed anywhere over the grid
+        Model model;
+        model.beginBatch(64);
+        for (int x = 0; x < 8; ++x) {
+            for (int z = 0; z < 8; ++z) {
+                model.createInstance(geometry, x * 3 - 12, 0, z * 3 - 12);
+            }
+        }
+        model.commitBatch();
+        std::vector<Ray> rays = makeRays(options.rays, 12.0f);
+
+        if (enabled("pick_closest")) {
+            // One untimed pass creates the profiler and trace entries picking uses
+            MeshHandle warmMesh;
+            int warmFace;
+            model.findRayIntersection(rays.front(), warmMesh, warmFace);
+
+            Samples samples;
+            for (int r = 0; r < options.repeat; ++r) {
+                size_t hits = 0;
+                size_t allocationsBefore = allocationCount;
+                samples.start();
+                for (const Ray& ray : rays) {
+                    MeshHandle mesh;
+                    int face;
+                    model.findRayIntersection(ray, mesh, face);
+                    hits += face >= 0;
+                }
+                pickAllocations += allocationCount - allocationsBefore;
+                samples.stop();
+                sink += hits;
+            }
+            record("pick_closest", size, rays.size(), "rays", samples);
+        }
+
+        if (enabled("pick_hover")) {
+            SceneSnapshot snapshot;
+            for (size_t m = 0; m < model.meshes.size(); ++m) {
+                snapshot.apply(SceneCommand(SceneCommand::UPSERT_MESH, model.meshes.handleAt(m),
+                                            std::make_shared<const Mesh>(model.meshes[m])));
+            }
+            snapshot.pickHover(rays.front());
+
+            Samples samples;
+            for (int r = 0; r < options.repeat; ++r) {
+                size_t hits = 0;
+                size_t allocationsBefore = allocationCount;
+                samples.start();
+                for (const Ray& ray : rays) {
+                    int face;
+                    snapshot.pickHover(ray);
+                    hits += snapshot.getHoveredMesh(face) != nullptr;
+                }
+                pickAllocations += allocationCount - allocationsBefore;
+                samples.stop();
+                sink += hits;
+            }
+            record("pick_hover", size, rays.size(), "rays", samples);
+        }
+
+        if (enabled("raycast_batch")) {
+            std::vector<RayIntersection> intersections(rays.size());
+            Samples samples;
+            for (int r = 0; r < options.repeat; ++r) {
+                samples.start();
+                model.findRayIntersections(rays.data(), rays.size(), intersections.data());
+                samples.stop();
+                for (const RayIntersection& intersection : intersections) sink += intersection.faceIndex >= 0;
+            }
+            record("raycast_batch", size, rays.size(), "rays", samples);
+        }
+
+        if (enabled("select_rectangle")) {
+            // Looking down at the grid from one side, rectangles of a quarter of the image width
+            glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 1.5f, 0.1f, 200.0f) *
+                glm::lookAt(glm::vec3(0.0f, 30.0f, 24.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            std::vector<RectangleHit> hits;
+            Samples samples;
+            size_t selected = 0;
+            for (int r = 0; r < options.repeat; ++r) {
+                selected = 0;
+                samples.start();
+                for (int i = 0; i < 16; ++i) {
+                    glm::vec2 center(-0.75f + 0.5f * (i % 4), -0.75f + 0.5f * (i / 4));
+                    model.findFacesInRectangle(viewProjection, center - glm::vec2(0.25f), center + glm::vec2(0.25f), true, hits);
+                    for (const RectangleHit& hit : hits) selected += hit.faces.size();
+                }
+                samples.stop();
+            }
+            sink += selected;
+            record("select_rectangle", size, selected, "faces", samples);
+        }
+    }
+};
+
+// *** Output ***
+
+double throughput(const Result& result) {
+    return result.medianSeconds > 0.0 ? result.items / result.medianSeconds : 0.0;
+}
+
+void printTable(const std::vector<Result>& results) {
+    std::printf("%-24s %10s %12s %12s %16s\n", "benchmark", "size", "median ms", "min ms", "throughput");
+    for (const Result& result : results) {
+        std::printf("%-24s %10zu %12.3f %12.3f %12.3g %s/s\n", result.name.c_str(), result.size,
+            result.medianSeconds * 1000.0, result.minSeconds * 1000.0, throughput(result), result.unit);
+    }
+}
+
+void printQuality(const std::vector<QualityRow>& rows) {
+    std::printf("\n%-8s %10s %8s %8s %7s %6s %6s %7s %8s %8s %10s %9s %9s\n", "type", "size", "nodes", "leaves",
+        "limited", "depth", "avg", "tri/lf", "dup", "SAH", "KB", "nodes/ray", "tris/ray");
+    for (const QualityRow& row : rows) {
+        const AcceleratorStats& stats = row.stats;
+        double queries = row.counters.queries ? static_cast<double>(row.counters.queries) : 1.0;
+        std::printf("%-8s %10zu %8zu %8zu %7zu %6d %6.1f %7.1f %8.2f %8.1f %10.1f %9.1f %9.1f\n", stats.type, row.size,
+            stats.nodes, stats.leaves, stats.depthLimitedLeaves, stats.maxDepth, stats.averageDepth,
+            stats.averageLeafTriangles, stats.duplication, stats.sahCost, stats.memoryBytes / 1024.0,
+            row.counters.nodesVisited / queries, row.counters.trianglesTested / queries);
+    }
+}
+
+void printImports(const std::vector<ImportRow>& rows) {
+    std::printf("\n%-24s %10s %12s %14s %14s\n", "import", "size", "allocations", "bytes", "kept bytes");
+    for (const ImportRow& row : rows) {
+        std::printf("%-24s %10zu %12zu %14zu %14zu\n", "import_allocations", row.size, row.allocations, row.bytes, row.keptBytes);
+    }
+}
+
+void printCSV(const std::vector<Result>& results) {
+    std::printf("benchmark,size,items,unit,median_s,min_s,items_per_s\n");
+    for (const Result& result : results) {
+        std::printf("%s,%zu,%zu,%s,%.9g,%.9g,%.9g\n", result.name.c_str(), result.size, result.items, result.unit,
+            result.medianSeconds, result.minSeconds, throughput(result));
+    }
+}
+
+void printJSON(const std::vector<Result>& results, const Options& options) {
+    std::printf("{\n  \"threads\": %zu,\n  \"repeat\": %d,\n  \"benchmarks\": [\n",
+        JobSystem::instance().workerCount() + 1, options.repeat);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        std::printf("    {\"name\": \"%s\", \"size\": %zu, \"items\": %zu, \"unit\": \"%s\", "
+                    "\"median_s\": %.9g, \"min_s\": %.9g, \"items_per_s\": %.9g}%s\n",
+            result.name.c_str(), result.size, result.items, result.unit,
+            result.medianSeconds, result.minSeconds, throughput(result), i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+}
+
+std::vector<size_t> parseSizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        size_t size = std::strtoull(item.c_str(), nullptr, 10);
+        if (size > 0) sizes.push_back(size);
+    }
+    return sizes;
+}
+
+bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--sizes" && hasValue) options.sizes = parseSizes(argv[++i]);
+        else if (arg == "--rays" && hasValue) options.rays = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--repeat" && hasValue) options.repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--filter" && hasValue) options.filter = argv[++i];
+        else if (arg == "--format" && hasValue) options.format = argv[++i];
+        else if (arg == "--stats") options.stats = true;
+        else return false;
+    }
+    return !options.sizes.empty() && options.rays > 0 &&
+           (options.format == "table" || options.format == "csv" || options.format == "json") &&
+           (!options.stats || options.format == "table");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::fprintf(stderr, "usage: geometrybench [--sizes 1000,10000,100000] [--rays 10000] [--repeat 5] "
+                             "[--filter text] [--format table|csv|json] [--stats]\n");
+        return 2;
+    }
+
+    Bench bench(options);
+    bench.runAll();
+
+    if (options.format == "csv") printCSV(bench.results);
+    else if (options.format == "json") printJSON(bench.results, options);
+    else printTable(bench.results);
+    if (options.stats) printQuality(bench.quality);
+    if (options.format == "table" && !bench.imports.empty()) printImports(bench.imports);
+    if (bench.pickAllocations > 0) {
+        std::fprintf(stderr, "pick_closest/pick_hover: %zu heap allocations while picking, expected none\n", bench.pickAllocations);
+        return 1;
+    }
+    if (bench.weldMismatch) {
+        std::fprintf(stderr, "weld_stl: welding the same buffers gave different output\n");
+        return 1;
+    }
+    if (bench.importOverBudget) {
+        std::fprintf(stderr, "import_allocations: over %d allocations or %.1fx the kept buffers per import, "
+                             "a buffer is copied again\n", IMPORT_ALLOCATION_LIMIT, IMPORT_BYTES_SLACK);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,336 @@
+/*
+* meshbake: headless batch preprocessing of STL files into the native mesh cache format.
+*
+*   meshbake [options] <file.stl | @list.txt>...
+*
+*   -o <dir>        Write the .cadmesh files to dir instead of next to the inputs. Inputs sharing a
+*                   file name would overwrite each other there, meshbake refuses them.
+*   --weld <eps>    Weld vertices closer than eps (default 0: exact duplicates only)
+*   --no-weld       Keep the triangle soup as imported
+*   --no-accel      Skip the accelerator build (it is not stored, the build only measures it)
+*   --accelerator <a>  auto, bvh, kdtree or lbvh (default auto)
+*   -v, --verbose   One line per file
+*   --stats         Accelerator quality per file: nodes, depth, leaf size, SAH cost, memory
+*   --trace <file>  Write a Chrome trace JSON timeline of the bake (chrome://tracing)
+*
+* A list file holds one path per line. Files are processed in parallel on the engine's job system.
+* Each file runs read, parse, weld, geometry (faces and bounds), accelerator and write; the time of
+* every stage is summed over all files and printed at the end with the peak memory of the process.
+* The exit code is 1 if any file failed.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "Mesh.h"
+#include "jobsystem.h"
+#include "log.h"
+#include "meshcache.h"
+#include "meshweld.h"
+#include "tracerecorder.h"
+#include "spacialaccelerator.h"
+
+namespace {
+
+enum Stage { STAGE_READ, STAGE_PARSE, STAGE_WELD, STAGE_GEOMETRY, STAGE_ACCELERATOR, STAGE_WRITE, STAGE_COUNT };
+const char* const STAGE_NAMES[STAGE_COUNT] = { "read", "parse", "weld", "geometry", "accelerator", "write" };
+
+struct Options {
+    std::string outputDir;
+    float weldTolerance = 0.0f;
+    bool weld = true;
+    bool buildAccelerator = true;
+    AcceleratorType accelerator = ACCELERATOR_AUTO;
+    bool verbose = false;
+    bool acceleratorStats = false;
+    std::string tracePath;
+    std::vector<std::string> inputs;
+};
+
+struct FileResult {
+    bool ok = false;
+    double stageSeconds[STAGE_COUNT] = {};
+    WeldStats weld;
+    size_t geometryBytes = 0; // Vertex, color and index buffers after welding
+    AcceleratorStats accelerator;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Peak resident set size of the process in bytes, 0 if unknown
+size_t peakMemoryBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);        // Bytes
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024; // Kilobytes
+#endif
+#endif
+}
+
+std::string outputPathFor(const std::string& input, const Options& options) {
+    std::string path = MeshCache::cachePathFor(input);
+    if (options.outputDir.empty()) return path;
+
+    size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    char last = options.outputDir.back();
+    return options.outputDir + (last == '/' || last == '\\' ? "" : "/") + name;
+}
+
+FileResult bakeFile(const std::string& input, const Options& options) {
+    TRACE_SCOPE("bake.file");
+    FileResult result;
+    Clock::time_point start = Clock::now();
+
+    std::vector<char> bytes;
+    if (!Mesh::readFile(input, bytes)) return result;
+    result.stageSeconds[STAGE_READ] = secondsSince(start);
+
+    start = Clock::now();
+    std::vector<float> vertices;
+    std::vector<float> colors; // Left empty, the editor colors baked meshes on import
+    std::vector<unsigned int> indices;
+    if (!Mesh::parseSTL(bytes, glm::vec3(1.0f), vertices, colors, indices)) {
+        logMessage(LOG_ERROR, "Failed to parse " + input);
+        return result;
+    }
+    colors.clear();
+    std::vector<char>().swap(bytes);
+    result.stageSeconds[STAGE_PARSE] = secondsSince(start);
+
+    start = Clock::now();
+    if (options.weld) {
+        TRACE_SCOPE("bake.weld");
+        result.weld = MeshWeld::weld(vertices, colors, indices, options.weldTolerance);
+    }
+    else {
+        result.weld.inputVertices = result.weld.outputVertices = vertices.size() / 3;
+        result.weld.inputTriangles = result.weld.outputTriangles = indices.size() / 3;
+    }
+    result.stageSeconds[STAGE_WELD] = secondsSince(start);
+
+    start = Clock::now();
+    std::shared_ptr<MeshGeometry> geometry = MeshGeometry::create(std::move(vertices), std::move(colors), std::move(indices));
+    result.geometryBytes = geometry->vertices.size() * sizeof(float) + geometry->colors.size() * sizeof(float) +
+                           geometry->indices.size() * sizeof(unsigned int);
+    result.stageSeconds[STAGE_GEOMETRY] = secondsSince(start);
+
+    start = Clock::now();
+    if (options.buildAccelerator && !geometry->faces.empty()) {
+        TRACE_SCOPE("bake.accelerator");
+        // One selector for the whole bake, so auto learns from the files built before
+        static AcceleratorSelector selector;
+        AcceleratorType type = options.accelerator == ACCELERATOR_AUTO ? selector.choose(geometry->faces.size()) : options.accelerator;
+        geometry->accelerator.reset(SpatialAcceleratorFactory::createAccelerator(type));
+        geometry->accelerator->build(geometry->faces);
+        AcceleratorStats stats = geometry->accelerator->getStats();
+        selector.recordBuild(type, stats);
+        if (options.acceleratorStats) result.accelerator = stats;
+    }
+    result.stageSeconds[STAGE_ACCELERATOR] = secondsSince(start);
+
+    start = Clock::now();
+    result.ok = MeshCache::write(outputPathFor(input, options), *geometry);
+    result.stageSeconds[STAGE_WRITE] = secondsSince(start);
+    return result;
+}
+
+bool readListFile(const std::string& listPath, std::vector<std::string>& inputs) {
+    std::ifstream list(listPath);
+    if (!list.is_open()) return false;
+    std::string line;
+    while (std::getline(list, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) inputs.push_back(line);
+    }
+    return true;
+}
+
+void printUsage() {
+    std::fprintf(stderr,
+        "usage: meshbake [options] <file.stl | @list.txt>...\n"
+        "  -o <dir>        output directory (default: next to each input), file names must be unique\n"
+        "  --weld <eps>    weld tolerance (default 0, exact duplicates)\n"
+        "  --no-weld       do not weld or clean\n"
+        "  --no-accel      skip the accelerator build\n"
+        "  --accelerator <auto|bvh|kdtree|lbvh>  accelerator type (default auto)\n"
+        "  -v, --verbose   print one line per file\n"
+        "  --stats         print accelerator quality per file\n"
+        "  --trace <file>  write a Chrome trace JSON timeline\n");
+}
+
+bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            options.outputDir = argv[++i];
+        }
+        else if (arg == "--weld" && i + 1 < argc) {
+            options.weldTolerance = std::strtof(argv[++i], nullptr);
+            options.weld = true;
+        }
+        else if (arg == "--no-weld") {
+            options.weld = false;
+        }
+        else if (arg == "--no-accel") {
+            options.buildAccelerator = false;
+        }
+        else if (arg == "--accelerator" && i + 1 < argc) {
+            if (!parseAcceleratorType(argv[++i], options.accelerator)) return false;
+        }
+        else if (arg == "-v" || arg == "--verbose") {
+            options.verbose = true;
+        }
+        else if (arg == "--stats") {
+            options.acceleratorStats = true;
+        }
+        else if (arg == "--trace" && i + 1 < argc) {
+            options.tracePath = argv[++i];
+        }
+        else if (arg[0] == '@') {
+            if (!readListFile(arg.substr(1), options.inputs)) {
+                std::fprintf(stderr, "meshbake: cannot read list file %s\n", arg.c_str() + 1);
+                return false;
+            }
+        }
+        else if (arg[0] == '-') {
+            return false;
+        }
+        else {
+            options.inputs.push_back(arg);
+        }
+    }
+    return !options.inputs.empty();
+}
+
+void logToStderr(LogLevel level, const std::string& message) {
+    std::fprintf(stderr, "[%s] %s\n", logLevelName(level), message.c_str());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+    setLogHandler(logToStderr);
+    TRACE_THREAD_NAME("Main");
+    if (!options.tracePath.empty()) {
+        TraceRecorder::instance().start();
+    }
+
+    // Files are written concurrently, two inputs must never share an output
+    std::map<std::string, size_t> outputs;
+    for (size_t i = 0; i < options.inputs.size(); ++i) {
+        std::pair<std::map<std::string, size_t>::iterator, bool> output =
+            outputs.insert(std::make_pair(outputPathFor(options.inputs[i], options), i));
+        if (!output.second) {
+            std::fprintf(stderr, "meshbake: %s and %s would both be written to %s\n",
+                options.inputs[output.first->second].c_str(), options.inputs[i].c_str(), output.first->first.c_str());
+            return 1;
+        }
+    }
+
+    Clock::time_point wallStart = Clock::now();
+    std::vector<FileResult> results(options.inputs.size());
+    std::mutex printMutex;
+
+    // One file per piece, large and small parts balance through the shared counter
+    JobSystem::instance().parallelFor(0, options.inputs.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            results[i] = bakeFile(options.inputs[i], options);
+            if (options.verbose) {
+                const FileResult& result = results[i];
+                double total = 0.0;
+                for (double seconds : result.stageSeconds) total += seconds;
+                std::lock_guard<std::mutex> lock(printMutex);
+                std::printf("%s %s: %zu -> %zu vertices, %zu triangles (%zu degenerate), %.1f ms\n",
+                    result.ok ? "ok  " : "FAIL", options.inputs[i].c_str(),
+                    result.weld.inputVertices, result.weld.outputVertices,
+                    result.weld.outputTriangles, result.weld.degenerateTriangles, total * 1000.0);
+            }
+            if (options.acceleratorStats && results[i].ok && options.buildAccelerator) {
+                const AcceleratorStats& stats = results[i].accelerator;
+                std::lock_guard<std::mutex> lock(printMutex);
+                std::printf("%s: %s %zu nodes, %zu leaves (%zu empty, %zu depth limited), depth %d max %.1f avg, "
+                            "%.1f triangles/leaf, duplication %.2f, SAH %.1f, %.1f KB, %.1f ms\n",
+                    options.inputs[i].c_str(), stats.type, stats.nodes, stats.leaves, stats.emptyLeaves,
+                    stats.depthLimitedLeaves, stats.maxDepth, stats.averageDepth, stats.averageLeafTriangles,
+                    stats.duplication, stats.sahCost, stats.memoryBytes / 1024.0, stats.buildMilliseconds);
+            }
+        }
+    });
+    double wallSeconds = secondsSince(wallStart);
+
+    size_t succeeded = 0;
+    double stageTotals[STAGE_COUNT] = {};
+    WeldStats totals;
+    size_t geometryBytes = 0;
+    for (const FileResult& result : results) {
+        for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+            stageTotals[stage] += result.stageSeconds[stage];
+        }
+        if (!result.ok) continue;
+        succeeded++;
+        totals.inputVertices += result.weld.inputVertices;
+        totals.outputVertices += result.weld.outputVertices;
+        totals.inputTriangles += result.weld.inputTriangles;
+        totals.outputTriangles += result.weld.outputTriangles;
+        totals.degenerateTriangles += result.weld.degenerateTriangles;
+        geometryBytes += result.geometryBytes;
+    }
+
+    // Stage times are summed over all workers, so they can add up to more than the wall time
+    std::printf("files       %zu baked, %zu failed\n", succeeded, results.size() - succeeded);
+    std::printf("vertices    %zu -> %zu\n", totals.inputVertices, totals.outputVertices);
+    std::printf("triangles   %zu -> %zu (%zu degenerate removed)\n",
+        totals.inputTriangles, totals.outputTriangles, totals.degenerateTriangles);
+    for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+        std::printf("%-11s %10.1f ms\n", STAGE_NAMES[stage], stageTotals[stage] * 1000.0);
+    }
+    std::printf("wall        %10.1f ms on %zu threads\n", wallSeconds * 1000.0, JobSystem::instance().workerCount() + 1);
+    std::printf("geometry    %10.1f MB\n", geometryBytes / (1024.0 * 1024.0));
+    std::printf("peak memory %10.1f MB\n", peakMemoryBytes() / (1024.0 * 1024.0));
+
+    if (!options.tracePath.empty()) {
+        TraceRecorder::instance().stop();
+        std::ofstream trace(options.tracePath);
+        TraceRecorder::instance().writeChromeJSON(trace);
+        if (!trace) {
+            std::fprintf(stderr, "meshbake: cannot write %s\n", options.tracePath.c_str());
+            return 1;
+        }
+    }
+    return succeeded == results.size() ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+/*
+* tracereplay: replay a recorded editor session headless and report per-operation latency.
+*
+*   tracereplay <session.cadtrace> [--repeat n] [--baseline file] [--save-baseline file]
+*               [--tolerance f] [--min-delta-us f] [--format table|csv] [--accelerator a]
+*
+* Record a session with "GameEngineOpenGL.exe --record session.cadtrace". Each operation is timed
+* together with the scene publish that follows it in the editor; handing the published commands to
+* a snapshot, which the render thread would do, is not timed.
+*
+* --repeat replays the whole trace n times, each time on a fresh model, and pools the samples.
+* --save-baseline writes the percentiles as CSV. --baseline compares against such a file: an
+* operation regresses when its p50 or p99 is more than tolerance (default 0.25, i.e. 25%) slower and
+* at least min-delta-us (default 5) microseconds slower. The exit code is 1 on any regression.
+*
+* --accelerator is auto, bvh, kdtree or lbvh (default bvh). Auto picks by timing and explores, so
+* two replays may build different accelerators; the default keeps baselines comparable. The CSV
+* records the accelerator and a baseline saved with another one is refused (exit code 2).
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "log.h"
+#include "model.h"
+#include "scenesnapshot.h"
+#include "sessionreplay.h"
+#include "sessiontrace.h"
+#include "spacialaccelerator.h"
+
+namespace {
+
+struct Options {
+    std::string tracePath;
+    int repeat = 1;
+    std::string baselinePath;
+    std::string saveBaselinePath;
+    double tolerance = 0.25;
+    double minDeltaMicroseconds = 5.0;
+    std::string format = "table";
+    AcceleratorType accelerator = ACCELERATOR_BVH;
+};
+
+struct OpStats {
+    size_t count = 0;
+    double p50 = 0.0, p90 = 0.0, p99 = 0.0, max = 0.0; // Microseconds
+};
+
+typedef std::chrono::steady_clock Clock;
+
+// Nearest rank percentile of sorted samples
+double percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(fraction * sorted.size() + 0.999999);
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+std::map<std::string, OpStats> summarize(std::map<std::string, std::vector<double>>& samples) {
+    std::map<std::string, OpStats> stats;
+    for (auto& entry : samples) {
+        std::vector<double>& values = entry.second;
+        std::sort(values.begin(), values.end());
+        OpStats& op = stats[entry.first];
+        op.count = values.size();
+        op.p50 = percentile(values, 0.50);
+        op.p90 = percentile(values, 0.90);
+        op.p99 = percentile(values, 0.99);
+        op.max = values.back();
+    }
+    return stats;
+}
+
+void writeCSV(std::ostream& out, const std::map<std::string, OpStats>& stats, AcceleratorType accelerator) {
+    out << "op,count,p50_us,p90_us,p99_us,max_us,accelerator\n";
+    for (const auto& entry : stats) {
+        const OpStats& op = entry.second;
+        out << entry.first << ',' << op.count << ',' << op.p50 << ',' << op.p90 << ',' << op.p99 << ',' << op.max << ','
+            << acceleratorTypeName(accelerator) << '\n';
+    }
+}
+
+// The accelerator is empty for a baseline that does not record one
+bool readBaseline(const std::string& path, std::map<std::string, OpStats>& stats, std::string& accelerator) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+    std::string line;
+    std::getline(file, line); // Header
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string name, value;
+        if (!std::getline(fields, name, ',')) continue;
+        OpStats op;
+        double* targets[] = { &op.p50, &op.p90, &op.p99, &op.max };
+        std::getline(fields, value, ',');
+        op.count = std::strtoull(value.c_str(), nullptr, 10);
+        for (double* target : targets) {
+            std::getline(fields, value, ',');
+            *target = std::strtod(value.c_str(), nullptr);
+        }
+        if (!std::getline(fields, value, ',')) value.clear();
+        if (stats.empty()) accelerator = value;
+        else if (value != accelerator) accelerator.clear(); // Mixed files match no replay
+        stats[name] = op;
+    }
+    return true;
+}
+
+bool regressed(double current, double baseline, const Options& options) {
+    return current > baseline * (1.0 + options.tolerance) && current - baseline >= options.minDeltaMicroseconds;
+}
+
+bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--repeat" && hasValue) options.repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--baseline" && hasValue) options.baselinePath = argv[++i];
+        else if (arg == "--save-baseline" && hasValue) options.saveBaselinePath = argv[++i];
+        else if (arg == "--tolerance" && hasValue) options.tolerance = std::strtod(argv[++i], nullptr);
+        else if (arg == "--min-delta-us" && hasValue) options.minDeltaMicroseconds = std::strtod(argv[++i], nullptr);
+        else if (arg == "--format" && hasValue) options.format = argv[++i];
+        else if (arg == "--accelerator" && hasValue) {
+            if (!parseAcceleratorType(argv[++i], options.accelerator)) return false;
+        }
+        else if (arg[0] != '-' && options.tracePath.empty()) options.tracePath = arg;
+        else return false;
+    }
+    return !options.tracePath.empty() && (options.format == "table" || options.format == "csv");
+}
+
+void logToStderr(LogLevel level, const std::string& message) {
+    std::fprintf(stderr, "[%s] %s\n", logLevelName(level), message.c_str());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::fprintf(stderr, "usage: tracereplay <session.cadtrace> [--repeat n] [--baseline file] [--save-baseline file]\n"
+                             "                   [--tolerance f] [--min-delta-us f] [--format table|csv]\n"
+                             "                   [--accelerator auto|bvh|kdtree|lbvh]  (default bvh)\n");
+        return 2;
+    }
+    setLogHandler(logToStderr);
+
+    std::vector<SessionOp> ops;
+    if (!loadSessionTrace(options.tracePath, ops)) return 2;
+
+    // Read the baseline first, a replay that cannot be compared with it is not worth running
+    std::map<std::string, OpStats> baseline;
+    if (!options.baselinePath.empty()) {
+        std::string baselineAccelerator;
+        if (!readBaseline(options.baselinePath, baseline, baselineAccelerator)) {
+            std::fprintf(stderr, "tracereplay: cannot read baseline %s\n", options.baselinePath.c_str());
+            return 2;
+        }
+        if (baselineAccelerator.empty()) {
+            std::fprintf(stderr, "tracereplay: baseline %s records no single accelerator, save it again\n",
+                options.baselinePath.c_str());
+            return 2;
+        }
+        if (baselineAccelerator != acceleratorTypeName(options.accelerator)) {
+            std::fprintf(stderr, "tracereplay: baseline %s was saved with accelerator '%s', this replay uses '%s'\n",
+                options.baselinePath.c_str(), baselineAccelerator.c_str(), acceleratorTypeName(options.accelerator));
+            return 2;
+        }
+    }
+
+    std::map<std::string, std::vector<double>> samples;
+    size_t failures = 0;
+    for (int run = 0; run < options.repeat; ++run) {
+        Model model;
+        model.setAcceleratorType(options.accelerator);
+        SessionReplayer replayer(model);
+        SceneSnapshot snapshot;
+        for (const SessionOp& op : ops) {
+            Clock::time_point start = Clock::now();
+            bool applied = replayer.apply(op);
+            model.publishChanges();
+            double microseconds = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+            model.renderCommands.applyTo(snapshot);
+            if (!applied) failures++;
+            samples[sessionOpName(op.type)].push_back(microseconds);
+        }
+    }
+    if (failures > 0) {
+        std::fprintf(stderr, "tracereplay: %zu operations failed to replay\n", failures);
+    }
+
+    std::map<std::string, OpStats> stats = summarize(samples);
+    if (options.format == "csv") {
+        std::ostringstream out;
+        writeCSV(out, stats, options.accelerator);
+        std::fputs(out.str().c_str(), stdout);
+    }
+    else {
+        std::printf("%-18s %8s %10s %10s %10s %10s\n", "op", "count", "p50 us", "p90 us", "p99 us", "max us");
+        for (const auto& entry : stats) {
+            const OpStats& op = entry.second;
+            std::printf("%-18s %8zu %10.1f %10.1f %10.1f %10.1f\n", entry.first.c_str(), op.count, op.p50, op.p90, op.p99, op.max);
+        }
+    }
+
+    if (!options.saveBaselinePath.empty()) {
+        std::ofstream file(options.saveBaselinePath);
+        writeCSV(file, stats, options.accelerator);
+        if (!file) {
+            std::fprintf(stderr, "tracereplay: cannot write %s\n", options.saveBaselinePath.c_str());
+            return 2;
+        }
+    }
+
+    int regressions = 0;
+    if (!options.baselinePath.empty()) {
+        for (const auto& entry : stats) {
+            std::map<std::string, OpStats>::const_iterator base = baseline.find(entry.first);
+            if (base == baseline.end()) continue;
+            const OpStats& now = entry.second;
+            const OpStats& before = base->second;
+            bool slower = regressed(now.p50, before.p50, options) || regressed(now.p99, before.p99, options);
+            std::fprintf(stderr, "%-18s p50 %10.1f -> %10.1f us   p99 %10.1f -> %10.1f us   %s\n", entry.first.c_str(),
+                before.p50, now.p50, before.p99, now.p99, slower ? "REGRESSED" : "ok");
+            regressions += slower;
+        }
+    }
+    return regressions > 0 || failures > 0 ? 1 : 0;
+}